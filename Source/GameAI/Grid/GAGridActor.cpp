@@ -6,6 +6,8 @@
 #include "NavigationSystem.h"
 #include "NavMesh/RecastNavMesh.h"
 #include "Engine/Texture2D.h"
+#include "Engine/World.h"
+#include "GAGridDiffusion.h"
 
 
 UE_DISABLE_OPTIMIZATION
@@ -21,6 +23,14 @@ AGAGridActor::AGAGridActor(const FObjectInitializer& ObjectInitializer)
 	XCount = 100;
 	YCount = 100;
 	CellScale = 100.0f;
+	CellLayout = GL_RowMajor;
+	DataLayout = GL_RowMajor;
+	CellDataVersion = 0;
+	OccluderProbeHeight = 100.0f;
+	bHasOccluderData = false;
+	PVSMaxDistance = 3000.0f;
+	bHasPVSData = false;
+	PVSBakedRadius = 0.0f;
 	RefreshDerivedValues();
 
 	SceneComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
@@ -90,15 +100,63 @@ void AGAGridActor::RefreshDerivedValues()
 	// Refresh HalfExtents
 	HalfExtents.X = 0.5f * CellScale * float(XCount);
 	HalfExtents.Y = 0.5f * CellScale * float(YCount);
+
+	RefreshCellLayout();
+	NotifyCellDataChanged();
+
+	// A PVS baked for different dimensions is useless
+	if (bHasPVSData && (PVSOffsets.Num() != XCount * YCount + 1))
+	{
+		ClearPVS();
+	}
+}
+
+void AGAGridActor::RefreshCellLayout()
+{
+	FGridLayoutIndexer NewIndexer(CellLayout, XCount, YCount);
+
+	if (DataLayout != CellLayout)
+	{
+		// Re-lay out the existing data. If the arrays don't match the current dimensions
+		// they are stale anyway (they'll be rebuilt by RefreshDataFromNav), so leave them alone.
+		FGridLayoutIndexer OldIndexer(DataLayout, XCount, YCount);
+		if ((Data.Num() == OldIndexer.GetStorageCount()) && (HeightData.Num() == OldIndexer.GetStorageCount()))
+		{
+			TArray<ECellData> NewData;
+			TArray<float> NewHeightData;
+			NewData.SetNumZeroed(NewIndexer.GetStorageCount());
+			NewHeightData.SetNumZeroed(NewIndexer.GetStorageCount());
+
+			for (int32 Y = 0; Y < YCount; Y++)
+			{
+				for (int32 X = 0; X < XCount; X++)
+				{
+					int32 OldIndex = OldIndexer.ToIndex(X, Y);
+					int32 NewIndex = NewIndexer.ToIndex(X, Y);
+					NewData[NewIndex] = Data[OldIndex];
+					NewHeightData[NewIndex] = HeightData[OldIndex];
+				}
+			}
+
+			Data = MoveTemp(NewData);
+			HeightData = MoveTemp(NewHeightData);
+		}
+
+		DataLayout = CellLayout;
+	}
+
+	CellIndexer = NewIndexer;
 }
 
 
 bool AGAGridActor::ResetData()
 {
 	bool Result = false;
-	int32 CellCount = GetCellCount();
-	Data.SetNumZeroed(GetCellCount());
+	int32 CellCount = GetCellIndexCount();
+	Data.SetNumZeroed(CellCount);
 	HeightData.SetNumZeroed(CellCount);
+	bHasOccluderData = false;
+	ClearPVS();
 
 	return Result;
 }
@@ -184,6 +242,17 @@ float AGAGridActor::GetCellHeightData(const FCellRef& CellRef) const
 	return HeightData[CellIndex];
 }
 
+void AGAGridActor::NotifyCellDataChanged()
+{
+	CellDataVersion++;
+
+	TraversabilityMask.SetNumUninitialized(Data.Num());
+	for (int32 Index = 0; Index < Data.Num(); Index++)
+	{
+		TraversabilityMask[Index] = EnumHasAllFlags(Data[Index], ECellData::CellDataTraversable) ? 1.0f : 0.0f;
+	}
+}
+
 
 bool AGAGridActor::GridSpaceBoundsToRect2D(const FBox2D& Box, FIntRect &RectOut) const
 {
@@ -376,12 +445,70 @@ bool AGAGridActor::RefreshDataFromNav()
 				}
 			}
 		}
+
+		// Occluders are derived from traversability, so they go stale along with it
+		// (RefreshOccluderData notifies about the change itself)
+		if (!RefreshOccluderData())
+		{
+			NotifyCellDataChanged();
+		}
 	}
 
 	return Result;
 }
 
 
+bool AGAGridActor::RefreshOccluderData()
+{
+	UWorld* World = GetWorld();
+	if (!World || (Data.Num() != GetCellIndexCount()))
+	{
+		return false;
+	}
+
+	FTransform ActorTransform = GetActorTransform();
+
+	// The PVS is baked from the occluders, so it needs re-baking after this
+	ClearPVS();
+
+	// Probe most of the cell's footprint, so that thin walls running through the middle of a cell still register
+	FCollisionShape ProbeShape = FCollisionShape::MakeBox(FVector(0.4f * CellScale, 0.4f * CellScale, 10.0f));
+	FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(GridOccluderProbe), false, this);
+
+	int32 OccluderCount = 0;
+	for (int32 Y = 0; Y < YCount; Y++)
+	{
+		for (int32 X = 0; X < XCount; X++)
+		{
+			FCellRef CellRef(X, Y);
+			ECellData& CellData = Data[CellRefToIndex(CellRef)];
+			EnumRemoveFlags(CellData, ECellData::CellDataOccluder);
+
+			// Anywhere we can walk is by definition not a wall
+			if (EnumHasAnyFlags(CellData, ECellData::CellDataTraversable))
+			{
+				continue;
+			}
+
+			FVector2D GridSpacePosition = GetCellGridSpacePosition(CellRef);
+			FVector ProbeCenter = ActorTransform.TransformPosition(FVector(GridSpacePosition.X - HalfExtents.X, GridSpacePosition.Y - HalfExtents.Y, OccluderProbeHeight));
+
+			if (World->OverlapBlockingTestByChannel(ProbeCenter, ActorTransform.GetRotation(), ECC_Visibility, ProbeShape, QueryParams))
+			{
+				EnumAddFlags(CellData, ECellData::CellDataOccluder);
+				OccluderCount++;
+			}
+		}
+	}
+
+	bHasOccluderData = true;
+	NotifyCellDataChanged();
+
+	UE_LOG(LogTemp, Log, TEXT("AGAGridActor::RefreshOccluderData - %d occluder cells"), OccluderCount);
+	return true;
+}
+
+
 // Debugging and Visualization --------------------------------
 
 
@@ -601,33 +728,35 @@ bool AGAGridActor::RefreshDebugTexture()
 			float MaxValue;
 			DebugGridMap.GetMaxValue(MaxValue, BIG_NUMBER);
 
+			// First pass: cells that aren't on the map
 			for (int32 Y = 0; Y < YCount; Y++)
 			{
 				for (int32 X = 0; X < XCount; X++)
 				{
-					FCellRef CellRef(X, Y);
-					ECellData CellData = GetCellData(CellRef);
+					ECellData CellData = GetCellData(FCellRef(X, Y));
 					bool Traversable = EnumHasAllFlags(CellData, ECellData::CellDataTraversable);
 
-					float MapValue;
-					bool IsOnMap = DebugGridMap.GetValue(CellRef, MapValue);
-					int32 IntVal = 0;
-					if (IsOnMap)
-					{
-						IntVal = FMath::RoundToInt(255.0f * (MapValue / MaxValue));
-					}
-
-					// Note: fade from blue to red as we approach the max value in the debug map
-
-					RawImageData[Index] = IsOnMap ? 255 - IntVal : 0;		// blue		Are we on the map or not?
+					RawImageData[Index] = 0;								// blue		Are we on the map or not?
 					RawImageData[Index + 1] = Traversable ? 50 : 0;			// green	Are we traversable or not?
-					RawImageData[Index + 2] = IntVal;						// red		The value
+					RawImageData[Index + 2] = 0;							// red		The value
 					RawImageData[Index + 3] = 255;							// alpha
 
 					Index += 4;
 				}
 			}
 
+			// Second pass: walk the map's own storage and fill in the value channels of the cells it covers
+			// Note: fade from blue to red as we approach the max value in the debug map
+			DebugGridMap.ForEachCell(DebugGridMap.GridBounds, [&](int32 X, int32 Y, float MapValue)
+			{
+				if (X >= 0 && X < XCount && Y >= 0 && Y < YCount)
+				{
+					int32 IntVal = FMath::RoundToInt(255.0f * (MapValue / MaxValue));
+					int32 PixelIndex = 4 * (Y * XCount + X);
+					RawImageData[PixelIndex] = 255 - IntVal;				// blue
+					RawImageData[PixelIndex + 2] = IntVal;					// red
+				}
+			});
 		}
 		else
 		{
@@ -666,3 +795,64 @@ bool AGAGridActor::RefreshDebugTexture()
 }
 
 UE_ENABLE_OPTIMIZATION
+
+
+// Note: deliberately outside of the UE_DISABLE_OPTIMIZATION block above -- timing unoptimized code tells us nothing
+
+void AGAGridActor::BenchmarkCellLayouts()
+{
+	const int32 Iterations = 20;
+	const EGridLayout Layouts[] = { GL_RowMajor, GL_Tiled8, GL_Tiled16 };
+	const float DiffusionRate = 0.2f;
+
+	for (EGridLayout TestLayout : Layouts)
+	{
+		FGAGridMap Source(XCount, YCount, 0.0f);
+		Source.SetLayout(TestLayout);
+		Source.ForEachCell([](int32 X, int32 Y, float& Value) { Value = FMath::FRand(); });
+
+		FGAGridMap Dest = Source;
+		const FGridLayoutIndexer Indexer = Source.GetIndexer();
+
+		// 3x3 blur (the SI_Blur spatial input), gathered in storage order
+		double BlurStart = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < Iterations; Iteration++)
+		{
+			Dest.ForEachCell([&](int32 X, int32 Y, float& Value)
+			{
+				float Total = 0.0f;
+				int32 Count = 0;
+				for (int32 DY = FMath::Max(Y - 1, 0); DY <= FMath::Min(Y + 1, YCount - 1); DY++)
+				{
+					for (int32 DX = FMath::Max(X - 1, 0); DX <= FMath::Min(X + 1, XCount - 1); DX++)
+					{
+						Total += Source.Data[Indexer.ToIndex(DX, DY)];
+						Count++;
+					}
+				}
+				Value = Total / float(Count);
+			});
+		}
+		double BlurTime = FPlatformTime::Seconds() - BlurStart;
+
+		// Occupancy diffusion, through the production diffuser. Its stencil runs over padded row major buffers
+		// whatever the map's layout, so this measures what the layout costs its load and store
+		FGAGridMap DiffuseMap(this, 0.0f);
+		DiffuseMap.SetLayout(TestLayout);
+		DiffuseMap.ForEachCell([](int32 X, int32 Y, float& Value) { Value = FMath::FRand(); });
+
+		FGAGridDiffuser Diffuser;
+		Diffuser.Prepare(this, DiffuseMap, DiffusionRate);
+
+		double DiffuseStart = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < Iterations; Iteration++)
+		{
+			Diffuser.Diffuse(this, DiffuseMap, DiffusionRate, 1);
+		}
+		double DiffuseTime = FPlatformTime::Seconds() - DiffuseStart;
+
+		UE_LOG(LogTemp, Log, TEXT("BenchmarkCellLayouts: %s (grid layout %s), %dx%d, %d iterations: blur %.3f ms/iter, diffuse %.3f ms/iter"),
+			*UEnum::GetValueAsString(TestLayout), *UEnum::GetValueAsString(CellLayout.GetValue()), XCount, YCount, Iterations,
+			1000.0 * BlurTime / Iterations, 1000.0 * DiffuseTime / Iterations);
+	}
+}
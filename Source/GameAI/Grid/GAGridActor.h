@@ -14,7 +14,8 @@ UENUM(BlueprintType, meta = (Bitflags, UseEnumValuesAsMaskValuesInEditor = "true
 enum class ECellData : uint8
 {
 	CellDataNone = 0,
-	CellDataTraversable = 1 << 0
+	CellDataTraversable = 1 << 0,
+	CellDataOccluder = 1 << 1		// blocks line of sight (see AGAGridActor::RefreshOccluderData)
 };
 ENUM_CLASS_FLAGS(ECellData);
 
@@ -96,6 +97,15 @@ public:
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
 	TObjectPtr<USceneComponent> SceneComponent;
 
+	// Memory layout of Data and HeightData (see EGridLayout)
+	// Changing this re-lays out any existing data
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+	TEnumAsByte<EGridLayout> CellLayout;
+
+	// The layout Data and HeightData are actually stored in. Normally the same as CellLayout
+	UPROPERTY()
+	TEnumAsByte<EGridLayout> DataLayout;
+
 	// Data
 	UPROPERTY(VisibleAnywhere, BlueprintReadWrite)
 	TArray<ECellData> Data;
@@ -104,6 +114,15 @@ public:
 	UPROPERTY(VisibleAnywhere, BlueprintReadWrite)
 	TArray<float> HeightData;
 
+	// Height above the grid at which RefreshOccluderData probes for geometry. Roughly eye level
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+	float OccluderProbeHeight;
+
+	// Whether the CellDataOccluder flags have been baked for the current Data
+	// Without them, grid line of sight can't tell walls from open ground
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	bool bHasOccluderData;
+
 	virtual void PostLoad() override;
 
 #if WITH_EDITORONLY_DATA
@@ -121,6 +140,36 @@ private:
 	int32 GetCellCount() { return XCount*YCount; }
 
 	void RefreshDerivedValues();
+	void RefreshCellLayout();
+
+	// Index math for Data and HeightData, rebuilt whenever the dimensions or layout change
+	FGridLayoutIndexer CellIndexer;
+
+	// Derived from Data: 1.0 for traversable cells and 0.0 otherwise, in the same layout as Data
+	TArray<float> TraversabilityMask;
+
+	// Bumped every time the cell data changes
+	int32 CellDataVersion;
+
+	// The baked PVS. Cell (X, Y)'s runs are PVSOffsets[Y * XCount + X] to PVSOffsets[Y * XCount + X + 1] - 1.
+	// Each run starts at row major cell index PVSRunStarts[Run] and is PVSRunLengths[Run] cells long
+	UPROPERTY()
+	TArray<int32> PVSOffsets;
+
+	UPROPERTY()
+	TArray<int32> PVSRunStarts;
+
+	UPROPERTY()
+	TArray<uint16> PVSRunLengths;
+
+	UPROPERTY(VisibleAnywhere, Category = "PVS")
+	bool bHasPVSData;
+
+	UPROPERTY()
+	float PVSBakedRadius;
+
+	// Index of the first of Origin's runs that ends at or after row major index RowMajorIndex
+	int32 FindFirstPVSRun(int32 Origin, int32 RowMajorIndex) const;
 
 public:
 	bool ResetData();
@@ -150,12 +199,19 @@ public:
 
 
 	// Return the flattened index of the cell
-	// The assumes a X-major ordering of the data array.
+	// With the default GL_RowMajor layout this assumes a X-major ordering of the data array.
 	// i.e. if we had a three by three grid, the flattened array would have the data in this order
 	//		(0, 0), (1, 0), (2, 0), (0, 1), (1, 1), (2, 1), (0, 2), (1, 2), (2, 2)
 	// Put another way, all the values in a given X-row are stored in consecutive spans of memory
+	// With one of the tiled layouts, it's the blocks of cells that are stored consecutively instead.
 	UFUNCTION(BlueprintCallable)
-	FORCEINLINE int32 CellRefToIndex(const FCellRef& CellRef) const { return CellRef.Y * XCount + CellRef.X; }
+	FORCEINLINE int32 CellRefToIndex(const FCellRef& CellRef) const { return CellIndexer.ToIndex(CellRef.X, CellRef.Y); }
+
+	// Number of entries in Data and HeightData. Can be more than XCount * YCount in the tiled layouts,
+	// which pad the arrays out to whole tiles
+	FORCEINLINE int32 GetCellIndexCount() const { return CellIndexer.GetStorageCount(); }
+
+	const FGridLayoutIndexer& GetCellIndexer() const { return CellIndexer; }
 
 	// Get the flags associated with the given cell reference
 	UFUNCTION(BlueprintCallable)
@@ -165,6 +221,19 @@ public:
 	UFUNCTION(BlueprintCallable)
 	float GetCellHeightData(const FCellRef &CellRef) const;
 
+	// Traversability as floats (1.0 traversable, 0.0 not), indexed by CellRefToIndex. Useful as a SIMD mask
+	const TArray<float>& GetTraversabilityMask() const { return TraversabilityMask; }
+
+	// Anything cached off the cell data should remember this and rebuild when it changes
+	int32 GetCellDataVersion() const { return CellDataVersion; }
+
+	// Call this after modifying Data directly, so that derived data gets rebuilt
+	UFUNCTION(BlueprintCallable)
+	void NotifyCellDataChanged();
+
+	// Does the cell block line of sight? Assumes the cell is in bounds
+	FORCEINLINE bool IsOccluder(int32 X, int32 Y) const { return EnumHasAnyFlags(Data[CellIndexer.ToIndex(X, Y)], ECellData::CellDataOccluder); }
+
 	// Returns the bounds of the given box in cell indices
 	// Note, assumes the Box is in grid-space already
 	// Returns an invalid rectangle if the Box and the grid are disjoint
@@ -176,6 +245,62 @@ public:
 	UFUNCTION(BlueprintCallable)
 	bool RefreshDataFromNav();
 
+	// Bake the CellDataOccluder flags: every non-traversable cell with blocking (visibility channel) geometry
+	// at OccluderProbeHeight is marked as an occluder. Called by RefreshDataFromNav
+	UFUNCTION(BlueprintCallable)
+	bool RefreshOccluderData();
+
+
+	// Potentially visible set --------------------------------
+	// Our levels are static, so cell-to-cell visibility can be baked once (from the occluders) and saved with the grid.
+	// For each cell we keep the cells visible from it (up to PVSMaxDistance away), as runs of consecutive cells
+	// along X. A run never crosses a row, and runs are sorted by (Y, X).
+
+	// How far the bake looks. Visibility queries further out than this can't be answered by the PVS
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "PVS")
+	float PVSMaxDistance;
+
+	// Bake the PVS from the current occluder data. Expensive (a full shadowcast from every cell, spread over all cores),
+	// so this is an editor-time operation. RefreshOccluderData throws the PVS away, since it goes stale
+	UFUNCTION(CallInEditor, BlueprintCallable, Category = "PVS")
+	bool BakePVS();
+
+	UFUNCTION(CallInEditor, BlueprintCallable, Category = "PVS")
+	void ClearPVS();
+
+	bool HasPVS() const { return bHasPVSData; }
+
+	// Radius (in cells) the PVS was baked with
+	float GetPVSRadius() const { return PVSBakedRadius; }
+
+	// Is To in the PVS of From? Only meaningful if To is within GetPVSRadius() of From
+	bool IsInPVS(const FCellRef& From, const FCellRef& To) const;
+
+	// Calls Func(int32 Y, int32 MinX, int32 MaxX) for each run of the PVS of From on rows MinY..MaxY, in order
+	template<typename FuncType>
+	void ForEachPVSRun(const FCellRef& From, int32 MinY, int32 MaxY, FuncType Func) const
+	{
+		if (!bHasPVSData || !IsCellRefInBounds(From))
+		{
+			return;
+		}
+
+		const int32 Origin = From.Y * XCount + From.X;
+		const int32 RunsEnd = PVSOffsets[Origin + 1];
+		int32 Run = FindFirstPVSRun(Origin, MinY * XCount);
+		for (; Run < RunsEnd; Run++)
+		{
+			const int32 Start = PVSRunStarts[Run];
+			const int32 Y = Start / XCount;
+			if (Y > MaxY)
+			{
+				break;
+			}
+			const int32 X = Start - Y * XCount;
+			Func(Y, X, X + int32(PVSRunLengths[Run]) - 1);
+		}
+	}
+
 	// Debugging and Visualization --------------------------------
 
 	UPROPERTY(EditAnywhere)
@@ -197,4 +322,9 @@ public:
 	UFUNCTION(BlueprintCallable)
 	bool RefreshDebugTexture();
 
+	// Times the 3x3 blur and FGAGridDiffuser::Diffuse over a full-grid FGAGridMap in each EGridLayout, and logs the
+	// results
+	UFUNCTION(CallInEditor, Category = "Debug")
+	void BenchmarkCellLayouts();
+
 };
\ No newline at end of file
@@ -0,0 +1,621 @@
+#include "GAGridDiffusion.h"
+#include "GAGridActor.h"
+#include "Math/VectorRegister.h"
+
+// Note: like GAGridMapKernels.cpp, deliberately not wrapped in UE_DISABLE_OPTIMIZATION
+
+
+FGAGridDiffuser::FGAGridDiffuser() : MaskGrid(nullptr), MaskCellDataVersion(INDEX_NONE), MaskBounds(), MaskRate(0.0f), Stride(0),
+	bHasLastMax(false), LastMaxX(INDEX_NONE), LastMaxY(INDEX_NONE), LastMaxValue(0.0f)
+{
+}
+
+void FGAGridDiffuser::Reset()
+{
+	MaskGrid = nullptr;
+	MaskCellDataVersion = INDEX_NONE;
+	MaskBounds = FGridBox();
+	Stride = 0;
+	bHasLastMax = false;
+	Traversable.Empty();
+	Keep.Empty();
+	BufferA.Empty();
+	BufferB.Empty();
+}
+
+bool FGAGridDiffuser::GetLastMax(FCellRef& CellOut, float& MaxValueOut) const
+{
+	if (!bHasLastMax)
+	{
+		return false;
+	}
+
+	CellOut = FCellRef(LastMaxX, LastMaxY);
+	MaxValueOut = LastMaxValue;
+	return true;
+}
+
+void FGAGridDiffuser::Prepare(const AGAGridActor* Grid, const FGAGridMap& Map, float Rate)
+{
+	if (Grid && Map.IsValid())
+	{
+		RefreshMasks(Grid, Map.GridBounds, Rate);
+	}
+}
+
+void FGAGridDiffuser::Prepare(const AGAGridActor* Grid, const FGridBox& Bounds, float Rate)
+{
+	if (Grid && Bounds.IsValid())
+	{
+		RefreshMasks(Grid, Bounds, Rate);
+	}
+}
+
+
+void FGAGridDiffuser::RefreshMasks(const AGAGridActor* Grid, const FGridBox& Bounds, float Rate)
+{
+	if ((MaskGrid == Grid) && (MaskCellDataVersion == Grid->GetCellDataVersion()) && (MaskBounds == Bounds) && (MaskRate == Rate))
+	{
+		return;
+	}
+
+	MaskGrid = Grid;
+	MaskCellDataVersion = Grid->GetCellDataVersion();
+	MaskBounds = Bounds;
+	MaskRate = Rate;
+
+	const int32 Width = Bounds.GetWidth();
+	const int32 Height = Bounds.GetHeight();
+	Stride = Width + 2;
+	const int32 PaddedCount = Stride * (Height + 2);
+
+	// Borders stay zero: nothing off the map is traversable
+	// (Reset first, so that a rebake at the same size still starts from zeros)
+	for (TArray<float>* Plane : { &Traversable, &Keep, &BufferA, &BufferB })
+	{
+		Plane->Reset();
+		Plane->SetNumZeroed(PaddedCount);
+	}
+
+	for (int32 Y = 0; Y < Height; Y++)
+	{
+		for (int32 X = 0; X < Width; X++)
+		{
+			FCellRef Cell(Bounds.MinX + X, Bounds.MinY + Y);
+			if (Grid->IsCellRefInBounds(Cell) && EnumHasAllFlags(Grid->GetCellData(Cell), ECellData::CellDataTraversable))
+			{
+				Traversable[(Y + 1) * Stride + (X + 1)] = 1.0f;
+			}
+		}
+	}
+
+	const float DiagonalRate = Rate / UE_SQRT_2;
+	for (int32 Y = 1; Y <= Height; Y++)
+	{
+		for (int32 X = 1; X <= Width; X++)
+		{
+			const int32 Index = Y * Stride + X;
+			if (Traversable[Index] == 0.0f)
+			{
+				continue;
+			}
+
+			// Mask of traversable neighbors, bit 0-3 orthogonal (E, W, S, N), 4-7 diagonal
+			uint8 NeighborMask = 0;
+			NeighborMask |= (Traversable[Index + 1] != 0.0f) ? 0x01 : 0;
+			NeighborMask |= (Traversable[Index - 1] != 0.0f) ? 0x02 : 0;
+			NeighborMask |= (Traversable[Index + Stride] != 0.0f) ? 0x04 : 0;
+			NeighborMask |= (Traversable[Index - Stride] != 0.0f) ? 0x08 : 0;
+			NeighborMask |= (Traversable[Index + Stride + 1] != 0.0f) ? 0x10 : 0;
+			NeighborMask |= (Traversable[Index + Stride - 1] != 0.0f) ? 0x20 : 0;
+			NeighborMask |= (Traversable[Index - Stride + 1] != 0.0f) ? 0x40 : 0;
+			NeighborMask |= (Traversable[Index - Stride - 1] != 0.0f) ? 0x80 : 0;
+
+			const int32 OrthogonalCount = FMath::CountBits(NeighborMask & 0x0F);
+			const int32 DiagonalCount = FMath::CountBits(NeighborMask & 0xF0);
+			Keep[Index] = 1.0f - (Rate * OrthogonalCount + DiagonalRate * DiagonalCount);
+		}
+	}
+}
+
+
+void FGAGridDiffuser::ClearPadded(const FGridBox& Box, float* Padded) const
+{
+	// Padded coordinates of the ring round Box
+	const int32 X0 = Box.MinX - MaskBounds.MinX;
+	const int32 X1 = Box.MaxX - MaskBounds.MinX + 2;
+	for (int32 Y = Box.MinY - MaskBounds.MinY; Y <= Box.MaxY - MaskBounds.MinY + 2; Y++)
+	{
+		FMemory::Memzero(Padded + Y * Stride + X0, (X1 - X0 + 1) * sizeof(float));
+	}
+}
+
+void FGAGridDiffuser::LoadPadded(const FGAGridMap& Map, const FGridBox& Box, float* Padded) const
+{
+	const int32 Width = MaskBounds.GetWidth();
+	Map.ForEachSpan(Box, [&](int32 Index, int32 Count, int32 CellX, int32 CellY)
+	{
+		// Full-width row major spans run on over several rows, but padded rows aren't contiguous
+		int32 X = CellX - MaskBounds.MinX;
+		int32 Y = CellY - MaskBounds.MinY;
+		while (Count > 0)
+		{
+			const int32 RunCount = FMath::Min(Count, Width - X);
+			const int32 PaddedIndex = (Y + 1) * Stride + (X + 1);
+			for (int32 I = 0; I < RunCount; I++)
+			{
+				Padded[PaddedIndex + I] = Map.Data[Index + I] * Traversable[PaddedIndex + I];
+			}
+
+			Index += RunCount;
+			Count -= RunCount;
+			X = 0;
+			Y++;
+		}
+	});
+}
+
+void FGAGridDiffuser::StorePadded(const float* Padded, const FGridBox& Box, FGAGridMap& Map) const
+{
+	const int32 Width = MaskBounds.GetWidth();
+	Map.ForEachSpan(Box, [&](int32 Index, int32 Count, int32 CellX, int32 CellY)
+	{
+		int32 X = CellX - MaskBounds.MinX;
+		int32 Y = CellY - MaskBounds.MinY;
+		while (Count > 0)
+		{
+			const int32 RunCount = FMath::Min(Count, Width - X);
+			FMemory::Memcpy(&Map.Data[Index], Padded + (Y + 1) * Stride + (X + 1), RunCount * sizeof(float));
+
+			Index += RunCount;
+			Count -= RunCount;
+			X = 0;
+			Y++;
+		}
+	});
+}
+
+
+void FGAGridDiffuser::Step(const float* Src, float* Dst, const FGridBox& Box, bool bTrackMax)
+{
+	const int32 Width = Box.GetWidth();
+	const float OrthogonalRate = MaskRate;
+	const float DiagonalRate = MaskRate / UE_SQRT_2;
+
+	const VectorRegister4Float OrthogonalRateVec = VectorSetFloat1(OrthogonalRate);
+	const VectorRegister4Float DiagonalRateVec = VectorSetFloat1(DiagonalRate);
+
+	for (int32 Y = Box.MinY - MaskBounds.MinY + 1; Y <= Box.MaxY - MaskBounds.MinY + 1; Y++)
+	{
+		const int32 RowStart = Y * Stride + (Box.MinX - MaskBounds.MinX + 1);
+		const float* Center = Src + RowStart;
+		const float* Up = Center - Stride;
+		const float* Down = Center + Stride;
+		const float* T = Traversable.GetData() + RowStart;
+		const float* K = Keep.GetData() + RowStart;
+		float* Out = Dst + RowStart;
+
+		VectorRegister4Float RowMaxVec = VectorSetFloat1(-UE_MAX_FLT);
+		int32 X = 0;
+		for (; X + 4 <= Width; X += 4)
+		{
+			VectorRegister4Float Orthogonal = VectorAdd(
+				VectorAdd(VectorLoad(Center + X - 1), VectorLoad(Center + X + 1)),
+				VectorAdd(VectorLoad(Up + X), VectorLoad(Down + X)));
+			VectorRegister4Float Diagonal = VectorAdd(
+				VectorAdd(VectorLoad(Up + X - 1), VectorLoad(Up + X + 1)),
+				VectorAdd(VectorLoad(Down + X - 1), VectorLoad(Down + X + 1)));
+
+			VectorRegister4Float Sum = VectorMultiply(VectorLoad(K + X), VectorLoad(Center + X));
+			Sum = VectorMultiplyAdd(Orthogonal, OrthogonalRateVec, Sum);
+			Sum = VectorMultiplyAdd(Diagonal, DiagonalRateVec, Sum);
+			const VectorRegister4Float Result = VectorMultiply(Sum, VectorLoad(T + X));
+			VectorStore(Result, Out + X);
+			RowMaxVec = VectorMax(RowMaxVec, Result);
+		}
+
+		float RowMax = -UE_MAX_FLT;
+		if (bTrackMax && (X > 0))
+		{
+			float Lanes[4];
+			VectorStore(RowMaxVec, Lanes);
+			RowMax = FMath::Max(FMath::Max(Lanes[0], Lanes[1]), FMath::Max(Lanes[2], Lanes[3]));
+		}
+
+		for (; X < Width; X++)
+		{
+			const float Orthogonal = (Center[X - 1] + Center[X + 1]) + (Up[X] + Down[X]);
+			const float Diagonal = (Up[X - 1] + Up[X + 1]) + (Down[X - 1] + Down[X + 1]);
+			Out[X] = T[X] * (K[X] * Center[X] + OrthogonalRate * Orthogonal + DiagonalRate * Diagonal);
+			RowMax = FMath::Max(RowMax, Out[X]);
+		}
+
+		// Only a row that beats the best so far (while it's still in cache) gets searched for its max cell
+		if (bTrackMax && (!bHasLastMax || (RowMax > LastMaxValue)))
+		{
+			for (int32 I = 0; I < Width; I++)
+			{
+				if (Out[I] == RowMax)
+				{
+					LastMaxX = Box.MinX + I;
+					LastMaxY = MaskBounds.MinY + Y - 1;
+					break;
+				}
+			}
+			LastMaxValue = RowMax;
+			bHasLastMax = true;
+		}
+	}
+}
+
+
+void FGAGridDiffuser::Diffuse(const AGAGridActor* Grid, FGAGridMap& Map, float Rate, int32 Steps)
+{
+	FGridBox Support = Map.GridBounds;
+	Diffuse(Grid, Map, Rate, Steps, Support);
+}
+
+void FGAGridDiffuser::Diffuse(const AGAGridActor* Grid, FGAGridMap& Map, float Rate, int32 Steps, FGridBox& SupportInOut)
+{
+	bHasLastMax = false;
+	if (!Grid || !Map.IsValid() || (Steps <= 0))
+	{
+		return;
+	}
+
+	RefreshMasks(Grid, Map.GridBounds, Rate);
+	DiffusePrepared(Map, Steps, SupportInOut);
+}
+
+void FGAGridDiffuser::DiffusePrepared(FGAGridMap& Map, int32 Steps, FGridBox& SupportInOut)
+{
+	bHasLastMax = false;
+	if (!MaskGrid || !Map.IsValid() || (Steps <= 0) || !(MaskBounds == Map.GridBounds))
+	{
+		return;
+	}
+
+	FGridBox Region = SupportInOut.GetExpanded(0, Map.GridBounds);
+	if (!Region.IsValid())
+	{
+		return;
+	}
+
+	// Step N reads the region of step N - 1 plus a ring of neighbors, all of which has to be zero outside the values
+	// actually carried over. The buffers hold whatever earlier calls left in them, so clear out as far as the last
+	// step will read first
+	const FGridBox FinalRegion = Region.GetExpanded(Steps, Map.GridBounds);
+	ClearPadded(FinalRegion, BufferA.GetData());
+	ClearPadded(FinalRegion, BufferB.GetData());
+
+	LoadPadded(Map, Region, BufferA.GetData());
+
+	float* Src = BufferA.GetData();
+	float* Dst = BufferB.GetData();
+	for (int32 StepIndex = 0; StepIndex < Steps; StepIndex++)
+	{
+		Region = Region.GetExpanded(1, Map.GridBounds);
+		Step(Src, Dst, Region, StepIndex == Steps - 1);
+		Swap(Src, Dst);
+	}
+
+	// After the last swap, Src holds the result
+	StorePadded(Src, Region, Map);
+	Map.MarkDirty(Region);
+
+	SupportInOut = Region;
+}
+
+
+FGASparseGridDiffuser::FGASparseGridDiffuser() : MaskGrid(nullptr), MaskCellDataVersion(INDEX_NONE), MaskBounds(), MaskRate(0.0f),
+	bHasLastMax(false), LastMaxValue(0.0f)
+{
+}
+
+void FGASparseGridDiffuser::Reset()
+{
+	MaskGrid = nullptr;
+	MaskCellDataVersion = INDEX_NONE;
+	MaskBounds = FGridBox();
+	bHasLastMax = false;
+	Traversable = FGASparseGridMap();
+	Keep = FGASparseGridMap();
+	BakedTiles.Empty();
+	Scratch = FGASparseGridMap();
+	ActiveTiles.Empty();
+	ActiveTileBits.Empty();
+}
+
+bool FGASparseGridDiffuser::GetLastMax(FCellRef& CellOut, float& MaxValueOut) const
+{
+	if (!bHasLastMax)
+	{
+		return false;
+	}
+
+	CellOut = LastMaxCell;
+	MaxValueOut = LastMaxValue;
+	return true;
+}
+
+
+void FGASparseGridDiffuser::Prepare(const AGAGridActor* Grid, const FGASparseGridMap& Map, float Rate, int32 Steps)
+{
+	if (!Grid || !Map.IsValid())
+	{
+		return;
+	}
+
+	if ((MaskGrid != Grid) || (MaskCellDataVersion != Grid->GetCellDataVersion()) || !(MaskBounds == Map.GridBounds) || (MaskRate != Rate))
+	{
+		MaskGrid = Grid;
+		MaskCellDataVersion = Grid->GetCellDataVersion();
+		MaskBounds = Map.GridBounds;
+		MaskRate = Rate;
+
+		Traversable = FGASparseGridMap(Grid, MaskBounds, 0.0f);
+		Keep = FGASparseGridMap(Grid, MaskBounds, 0.0f);
+		BakedTiles.Init(false, Traversable.GetTilesX() * Traversable.GetTilesY());
+	}
+
+	// Values move one cell a step at most, so this many rings of tiles round the allocated ones is as far as they get
+	const int32 Reach = FMath::DivideAndRoundUp(FMath::Max(Steps, 1), TileDim);
+	const int32 TilesX = Map.GetTilesX();
+	const int32 TilesY = Map.GetTilesY();
+	Map.ForEachAllocatedTile([&](int32 TileIndex, const float* Values)
+	{
+		const int32 TileX = TileIndex % TilesX;
+		const int32 TileY = TileIndex / TilesX;
+		for (int32 NY = FMath::Max(TileY - Reach, 0); NY <= FMath::Min(TileY + Reach, TilesY - 1); NY++)
+		{
+			for (int32 NX = FMath::Max(TileX - Reach, 0); NX <= FMath::Min(TileX + Reach, TilesX - 1); NX++)
+			{
+				if (!BakedTiles[NY * TilesX + NX])
+				{
+					BakeTile(Grid, NY * TilesX + NX);
+				}
+			}
+		}
+	});
+}
+
+void FGASparseGridDiffuser::BakeTile(const AGAGridActor* Grid, int32 TileIndex)
+{
+	BakedTiles[TileIndex] = true;
+
+	int32 TileMinX, TileMinY;
+	Traversable.GetTileOrigin(TileIndex, TileMinX, TileMinY);
+
+	// Traversability of the tile and the one cell ring round it. Nothing off the map is traversable
+	float Window[PaddedDim * PaddedDim];
+	bool bAnyTraversable = false;
+	for (int32 WY = 0; WY < PaddedDim; WY++)
+	{
+		for (int32 WX = 0; WX < PaddedDim; WX++)
+		{
+			const FCellRef Cell(TileMinX + WX - 1, TileMinY + WY - 1);
+			const bool bTraversable = MaskBounds.IsValidCell(Cell) && Grid->IsCellRefInBounds(Cell) &&
+				EnumHasAllFlags(Grid->GetCellData(Cell), ECellData::CellDataTraversable);
+			Window[WY * PaddedDim + WX] = bTraversable ? 1.0f : 0.0f;
+
+			const bool bInTile = (WX >= 1) && (WX <= TileDim) && (WY >= 1) && (WY <= TileDim);
+			bAnyTraversable |= bTraversable && bInTile;
+		}
+	}
+
+	if (!bAnyTraversable)
+	{
+		// Left unallocated, which reads as all zeros
+		return;
+	}
+
+	float* T = Traversable.FindOrAddTile(TileIndex);
+	float* K = Keep.FindOrAddTile(TileIndex);
+	const float DiagonalRate = MaskRate / UE_SQRT_2;
+	for (int32 Y = 0; Y < TileDim; Y++)
+	{
+		for (int32 X = 0; X < TileDim; X++)
+		{
+			const int32 Index = (Y + 1) * PaddedDim + (X + 1);
+			if (Window[Index] == 0.0f)
+			{
+				continue;
+			}
+
+			// Same neighbor count as FGAGridDiffuser::RefreshMasks
+			const int32 OrthogonalCount = int32(Window[Index + 1] + Window[Index - 1] + Window[Index + PaddedDim] + Window[Index - PaddedDim]);
+			const int32 DiagonalCount = int32(Window[Index + PaddedDim + 1] + Window[Index + PaddedDim - 1] +
+				Window[Index - PaddedDim + 1] + Window[Index - PaddedDim - 1]);
+
+			T[Y * TileDim + X] = 1.0f;
+			K[Y * TileDim + X] = 1.0f - (MaskRate * OrthogonalCount + DiagonalRate * DiagonalCount);
+		}
+	}
+}
+
+
+void FGASparseGridDiffuser::StepTile(const FGASparseGridMap& Src, FGASparseGridMap& Dst, int32 TileIndex, bool bTrackMax)
+{
+	const float* T = Traversable.FindTile(TileIndex);
+	if (!T)
+	{
+		// Nothing traversable here (or out of reach): the tile comes out empty
+		return;
+	}
+	const float* K = Keep.FindTile(TileIndex);
+
+	const int32 TilesX = Src.GetTilesX();
+	const int32 TilesY = Src.GetTilesY();
+	const int32 TileX = TileIndex % TilesX;
+	const int32 TileY = TileIndex / TilesX;
+
+	// The tile's values (times T) with the facing edges of its neighbors round them
+	float Padded[PaddedDim * PaddedDim];
+	FMemory::Memzero(Padded, sizeof(Padded));
+	for (int32 DY = -1; DY <= 1; DY++)
+	{
+		for (int32 DX = -1; DX <= 1; DX++)
+		{
+			const int32 NX = TileX + DX;
+			const int32 NY = TileY + DY;
+			if ((NX < 0) || (NX >= TilesX) || (NY < 0) || (NY >= TilesY))
+			{
+				continue;
+			}
+
+			const int32 Neighbor = NY * TilesX + NX;
+			const float* Values = Src.FindTile(Neighbor);
+			const float* NeighborT = Traversable.FindTile(Neighbor);
+			if (!Values || !NeighborT)
+			{
+				continue;
+			}
+
+			// Just the row / column / corner of the neighbor that borders this tile (all of it for the tile itself)
+			const int32 X0 = (DX < 0) ? TileDim - 1 : 0;
+			const int32 X1 = (DX > 0) ? 0 : TileDim - 1;
+			const int32 Y0 = (DY < 0) ? TileDim - 1 : 0;
+			const int32 Y1 = (DY > 0) ? 0 : TileDim - 1;
+			for (int32 Y = Y0; Y <= Y1; Y++)
+			{
+				float* PaddedRow = Padded + (Y + 1 + DY * TileDim) * PaddedDim + (1 + DX * TileDim);
+				for (int32 X = X0; X <= X1; X++)
+				{
+					PaddedRow[X] = Values[Y * TileDim + X] * NeighborT[Y * TileDim + X];
+				}
+			}
+		}
+	}
+
+	const float OrthogonalRate = MaskRate;
+	const float DiagonalRate = MaskRate / UE_SQRT_2;
+	const VectorRegister4Float OrthogonalRateVec = VectorSetFloat1(OrthogonalRate);
+	const VectorRegister4Float DiagonalRateVec = VectorSetFloat1(DiagonalRate);
+
+	float Out[FGASparseGridMap::TileCellCount];
+	VectorRegister4Float MaxVec = VectorSetFloat1(-UE_MAX_FLT);
+	VectorRegister4Float AbsMaxVec = VectorZero();
+	for (int32 Y = 0; Y < TileDim; Y++)
+	{
+		const float* Center = Padded + (Y + 1) * PaddedDim + 1;
+		const float* Up = Center - PaddedDim;
+		const float* Down = Center + PaddedDim;
+		const int32 RowStart = Y * TileDim;
+
+		// (TileDim is a multiple of 4, so there's no scalar tail)
+		for (int32 X = 0; X < TileDim; X += 4)
+		{
+			VectorRegister4Float Orthogonal = VectorAdd(
+				VectorAdd(VectorLoad(Center + X - 1), VectorLoad(Center + X + 1)),
+				VectorAdd(VectorLoad(Up + X), VectorLoad(Down + X)));
+			VectorRegister4Float Diagonal = VectorAdd(
+				VectorAdd(VectorLoad(Up + X - 1), VectorLoad(Up + X + 1)),
+				VectorAdd(VectorLoad(Down + X - 1), VectorLoad(Down + X + 1)));
+
+			VectorRegister4Float Sum = VectorMultiply(VectorLoad(K + RowStart + X), VectorLoad(Center + X));
+			Sum = VectorMultiplyAdd(Orthogonal, OrthogonalRateVec, Sum);
+			Sum = VectorMultiplyAdd(Diagonal, DiagonalRateVec, Sum);
+			const VectorRegister4Float Result = VectorMultiply(Sum, VectorLoad(T + RowStart + X));
+			VectorStore(Result, Out + RowStart + X);
+			MaxVec = VectorMax(MaxVec, Result);
+			AbsMaxVec = VectorMax(AbsMaxVec, VectorAbs(Result));
+		}
+	}
+
+	float Lanes[4];
+	VectorStore(AbsMaxVec, Lanes);
+	if (FMath::Max(FMath::Max(Lanes[0], Lanes[1]), FMath::Max(Lanes[2], Lanes[3])) == 0.0f)
+	{
+		// Nothing reached it: leave it unallocated
+		return;
+	}
+
+	FMemory::Memcpy(Dst.FindOrAddTile(TileIndex), Out, sizeof(Out));
+
+	VectorStore(MaxVec, Lanes);
+	const float TileMax = FMath::Max(FMath::Max(Lanes[0], Lanes[1]), FMath::Max(Lanes[2], Lanes[3]));
+	if (bTrackMax && (!bHasLastMax || (TileMax > LastMaxValue)))
+	{
+		for (int32 Index = 0; Index < FGASparseGridMap::TileCellCount; Index++)
+		{
+			if (Out[Index] == TileMax)
+			{
+				int32 TileMinX, TileMinY;
+				Dst.GetTileOrigin(TileIndex, TileMinX, TileMinY);
+				LastMaxCell = FCellRef(TileMinX + (Index & (TileDim - 1)), TileMinY + (Index >> FGASparseGridMap::TileShift));
+				break;
+			}
+		}
+		LastMaxValue = TileMax;
+		bHasLastMax = true;
+	}
+}
+
+
+void FGASparseGridDiffuser::Diffuse(const AGAGridActor* Grid, FGASparseGridMap& Map, float Rate, int32 Steps)
+{
+	bHasLastMax = false;
+	if (!Grid || !Map.IsValid() || (Steps <= 0))
+	{
+		return;
+	}
+
+	Prepare(Grid, Map, Rate, Steps);
+	DiffusePrepared(Map, Steps);
+}
+
+void FGASparseGridDiffuser::DiffusePrepared(FGASparseGridMap& Map, int32 Steps)
+{
+	bHasLastMax = false;
+	if (!MaskGrid || !Map.IsValid() || (Steps <= 0) || !(MaskBounds == Map.GridBounds))
+	{
+		return;
+	}
+
+	if (!Scratch.IsValid() || !Scratch.IsTileCompatible(Map))
+	{
+		Scratch = FGASparseGridMap();
+		Scratch.XCount = Map.XCount;
+		Scratch.YCount = Map.YCount;
+		Scratch.GridBounds = Map.GridBounds;
+	}
+
+	const int32 TilesX = Map.GetTilesX();
+	const int32 TilesY = Map.GetTilesY();
+	if (ActiveTileBits.Num() != TilesX * TilesY)
+	{
+		ActiveTileBits.Init(false, TilesX * TilesY);
+	}
+
+	for (int32 StepIndex = 0; StepIndex < Steps; StepIndex++)
+	{
+		// Every allocated tile, and every tile next to one, can come out of this step non-zero
+		ActiveTiles.Reset();
+		Map.ForEachAllocatedTile([&](int32 TileIndex, const float* Values)
+		{
+			const int32 TileX = TileIndex % TilesX;
+			const int32 TileY = TileIndex / TilesX;
+			for (int32 NY = FMath::Max(TileY - 1, 0); NY <= FMath::Min(TileY + 1, TilesY - 1); NY++)
+			{
+				for (int32 NX = FMath::Max(TileX - 1, 0); NX <= FMath::Min(TileX + 1, TilesX - 1); NX++)
+				{
+					const int32 Neighbor = NY * TilesX + NX;
+					if (!ActiveTileBits[Neighbor])
+					{
+						ActiveTileBits[Neighbor] = true;
+						ActiveTiles.Add(Neighbor);
+					}
+				}
+			}
+		});
+
+		Scratch.ResetData(0.0f);
+		for (int32 TileIndex : ActiveTiles)
+		{
+			ActiveTileBits[TileIndex] = false;
+			StepTile(Map, Scratch, TileIndex, StepIndex == Steps - 1);
+		}
+
+		Swap(Map, Scratch);
+	}
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GAGridMap.h"
+#include "GASparseGridMap.h"
+
+class AGAGridActor;
+
+
+// Diffuses the values of an FGAGridMap over the traversable cells of the grid (e.g. occupancy probability)
+// Each step, every traversable cell hands Rate of its value to each traversable orthogonal neighbor, and
+// Rate / sqrt(2) to each traversable diagonal neighbor, keeping the rest. Non-traversable cells end up empty.
+// The total over the traversable cells is conserved. Cells outside the map's bounds count as non-traversable.
+//
+// This is computed in gather form: each cell sums what its neighbors send it,
+//		New = T * (Keep * TV + Rate * (sum of orthogonal TV) + Rate / sqrt(2) * (sum of diagonal TV))
+// where T is 1 for traversable cells (0 otherwise), TV = T * Value, and Keep = 1 - what the cell gives away.
+// T and Keep only depend on the grid, so they're baked once per grid and rate (Keep folds in each cell's mask of
+// traversable neighbors). Rows are then plain SIMD arithmetic over padded, row-major buffers -- no branches, no
+// bounds checks. The two padded buffers are kept between calls and ping-ponged between steps, so nothing is allocated
+// once the diffuser is warm.
+//
+// Maps whose non-zero values only cover part of the grid (e.g. occupancy shortly after a sighting) can pass in the
+// box that holds them. Each step can only spread values one cell further, so the passes are restricted to that box
+// grown by one cell per step, and the cost follows the area of spread rather than the size of the map.
+
+struct FGAGridDiffuser
+{
+	FGAGridDiffuser();
+
+	// Run Steps diffusion steps on Map. Map must be built on Grid
+	void Diffuse(const AGAGridActor* Grid, FGAGridMap& Map, float Rate, int32 Steps = 1);
+
+	// Same, for a map that is zero outside SupportInOut. Only the support (grown by the steps) is touched, and
+	// SupportInOut comes back grown to cover the result. Does nothing if the support is invalid (i.e. empty)
+	void Diffuse(const AGAGridActor* Grid, FGAGridMap& Map, float Rate, int32 Steps, FGridBox& SupportInOut);
+
+	// The highest cell of the map as the last Diffuse() left it, and its value. It comes out of the last step as it
+	// writes each row, so callers after the argmax don't need a pass of their own. Ties go to the first cell in row
+	// major order. False if the last call didn't run any steps
+	bool GetLastMax(FCellRef& CellOut, float& MaxValueOut) const;
+
+	// Drop the cached masks and buffers
+	void Reset();
+
+	// Bake the masks for Map and Rate right away (Diffuse() does it lazily). Lets the owner do the part that reads
+	// the grid on the game thread, before handing the diffuser to a worker
+	void Prepare(const AGAGridActor* Grid, const FGAGridMap& Map, float Rate);
+
+	// Same, for a map with the given bounds
+	void Prepare(const AGAGridActor* Grid, const FGridBox& Bounds, float Rate);
+
+	// Diffuse with the masks and rate of the last Prepare, without looking at the grid at all (so even if its cells
+	// have changed since). Safe on a worker while the game thread edits the grid. Does nothing if Map's bounds aren't
+	// the ones the masks were baked for
+	void DiffusePrepared(FGAGridMap& Map, int32 Steps, FGridBox& SupportInOut);
+
+	// The baked T and Keep planes (padded, rows GetStride() apart, covering GetMaskBounds() plus the border), for
+	// kernels that run their own steps with the same masks. Valid after Prepare
+	const TArray<float>& GetTraversablePlane() const { return Traversable; }
+	const TArray<float>& GetKeepPlane() const { return Keep; }
+	int32 GetStride() const { return Stride; }
+	const FGridBox& GetMaskBounds() const { return MaskBounds; }
+
+protected:
+	// (Re)bake T and Keep if the grid, its cell data, the map's bounds or the rate changed
+	void RefreshMasks(const AGAGridActor* Grid, const FGridBox& Bounds, float Rate);
+
+	// Zero Box (in grid cells), plus the one cell ring round it, in a padded buffer
+	void ClearPadded(const FGridBox& Box, float* Padded) const;
+
+	// Map <-> padded buffer over Box (the read side also applies T)
+	void LoadPadded(const FGAGridMap& Map, const FGridBox& Box, float* Padded) const;
+	void StorePadded(const float* Padded, const FGridBox& Box, FGAGridMap& Map) const;
+
+	// One step over the cells of Box, Src -> Dst. With bTrackMax, also records the max of Dst over Box
+	void Step(const float* Src, float* Dst, const FGridBox& Box, bool bTrackMax);
+
+	// What the masks were baked for
+	const AGAGridActor* MaskGrid;
+	int32 MaskCellDataVersion;
+	FGridBox MaskBounds;
+	float MaskRate;
+
+	// Row stride of the padded buffers: a one cell border all the way round
+	int32 Stride;
+
+	// Padded planes
+	TArray<float> Traversable;
+	TArray<float> Keep;
+
+	// Ping-pong buffers
+	TArray<float> BufferA;
+	TArray<float> BufferB;
+
+	// See GetLastMax
+	bool bHasLastMax;
+	int32 LastMaxX;
+	int32 LastMaxY;
+	float LastMaxValue;
+};
+
+
+// The same diffusion over an FGASparseGridMap (whose default value must be 0), a tile at a time
+// Each step only visits the allocated tiles and the ring of tiles round them, and an output tile is only kept if
+// something reached it. T and Keep are baked per tile as well, for just the tiles the values can reach. So the work and
+// the memory both follow the region the values have spread over, not the size of the grid.
+// Within a tile the stencil is the same SIMD arithmetic as FGAGridDiffuser's, over a padded copy of the tile that
+// takes its one cell border from the neighboring tiles.
+
+struct FGASparseGridDiffuser
+{
+	FGASparseGridDiffuser();
+
+	// Run Steps diffusion steps on Map. Map must be built on Grid
+	void Diffuse(const AGAGridActor* Grid, FGASparseGridMap& Map, float Rate, int32 Steps = 1);
+
+	// Bake the masks of every tile that Map's values can reach within Steps steps (rebaking everything if the grid,
+	// its cell data, the map's bounds or the rate changed). This is the only part that reads the grid, so owners that
+	// step on a worker call it on the game thread first
+	void Prepare(const AGAGridActor* Grid, const FGASparseGridMap& Map, float Rate, int32 Steps);
+
+	// Diffuse with the masks and rate of the last Prepare, without looking at the grid at all. Tiles that haven't been
+	// baked count as non-traversable. Does nothing if Map's bounds aren't the ones the masks were baked for
+	void DiffusePrepared(FGASparseGridMap& Map, int32 Steps);
+
+	// See FGAGridDiffuser::GetLastMax. Ties go to the first cell found, in the order the tiles are stepped
+	bool GetLastMax(FCellRef& CellOut, float& MaxValueOut) const;
+
+	// Drop the baked masks and the scratch map
+	void Reset();
+
+protected:
+	static constexpr int32 TileDim = FGASparseGridMap::TileDim;
+	static constexpr int32 PaddedDim = TileDim + 2;
+
+	// Bake T and Keep for one tile, from the grid
+	void BakeTile(const AGAGridActor* Grid, int32 TileIndex);
+
+	// One step of one tile, Src -> Dst. The output tile is only allocated if any of it is non-zero
+	void StepTile(const FGASparseGridMap& Src, FGASparseGridMap& Dst, int32 TileIndex, bool bTrackMax);
+
+	// What the masks were baked for
+	const AGAGridActor* MaskGrid;
+	int32 MaskCellDataVersion;
+	FGridBox MaskBounds;
+	float MaskRate;
+
+	// Per tile masks, with a bit per tile for the ones that have been baked (a baked tile with nothing traversable in
+	// it is never allocated)
+	FGASparseGridMap Traversable;
+	FGASparseGridMap Keep;
+	TBitArray<> BakedTiles;
+
+	// The other half of each step
+	FGASparseGridMap Scratch;
+
+	// The tiles to step
+	TArray<int32> ActiveTiles;
+	TBitArray<> ActiveTileBits;
+
+	// See GetLastMax
+	bool bHasLastMax;
+	FCellRef LastMaxCell;
+	float LastMaxValue;
+};
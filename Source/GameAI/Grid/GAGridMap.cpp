@@ -11,9 +11,49 @@ bool FGridBox::IsValidCell(const FCellRef& Cell) const
 }
 
 
+// --------------------- FGridLayoutIndexer ---------------------
+
+FGridLayoutIndexer::FGridLayoutIndexer(EGridLayout Layout, int32 WidthIn, int32 HeightIn)
+{
+	Width = WidthIn;
+	Height = HeightIn;
+	TileShift = GetTileShift(Layout);
+	TilesX = (TileShift > 0) ? ((Width + (1 << TileShift) - 1) >> TileShift) : 0;
+}
+
+int32 FGridLayoutIndexer::GetTileShift(EGridLayout Layout)
+{
+	switch (Layout)
+	{
+		case GL_Tiled8:
+			return 3;
+		case GL_Tiled16:
+			return 4;
+		default:
+			return 0;
+	}
+}
+
+int32 FGridLayoutIndexer::GetStorageCount() const
+{
+	if (Width <= 0 || Height <= 0)
+	{
+		return 0;
+	}
+
+	if (TileShift == 0)
+	{
+		return Width * Height;
+	}
+
+	int32 TilesY = (Height + (1 << TileShift) - 1) >> TileShift;
+	return (TilesX * TilesY) << (2 * TileShift);
+}
+
+
 // --------------------- FGAGridMap ---------------------
 
-FGAGridMap::FGAGridMap() : XCount(INDEX_NONE), YCount(INDEX_NONE), GridBounds()
+FGAGridMap::FGAGridMap() : XCount(INDEX_NONE), YCount(INDEX_NONE), GridBounds(), Layout(GL_RowMajor)
 {
 	// we are empty
 }
@@ -24,6 +64,7 @@ FGAGridMap::FGAGridMap(int32 XCountIn, int32 YCountIn, float InitialValue)
 	XCount = XCountIn;
 	YCount = YCountIn;
 	GridBounds = FGridBox(0, XCount - 1, 0, YCount - 1);
+	Layout = GL_RowMajor;
 
 	ResetData(InitialValue);
 }
@@ -33,6 +74,7 @@ FGAGridMap::FGAGridMap(const AGAGridActor* Grid, float InitialValue)
 	XCount = Grid->XCount;
 	YCount = Grid->YCount;
 	GridBounds = FGridBox(0, XCount - 1, 0, YCount - 1);
+	Layout = Grid->CellLayout;
 
 	ResetData(InitialValue);
 }
@@ -42,6 +84,7 @@ FGAGridMap::FGAGridMap(const AGAGridActor* Grid, const FGridBox& GridBoxIn, floa
 	XCount = Grid->XCount;
 	YCount = Grid->YCount;
 	GridBounds = GridBoxIn;
+	Layout = Grid->CellLayout;
 
 	ResetData(InitialValue);
 }
@@ -56,18 +99,57 @@ void FGAGridMap::ResetData(float InitialValue)
 		check(BoxWidth > 0);
 		check(BoxHeight > 0);
 
-		int32 CellCount = BoxWidth * BoxHeight;
-		Data.SetNum(CellCount);
+		// Note: in the tiled layouts this includes the padding out to whole tiles
+		int32 StorageCount = GetIndexer().GetStorageCount();
+		Data.SetNum(StorageCount);
 
-		for (int32 Index = 0; Index < CellCount; Index++)
+		for (int32 Index = 0; Index < StorageCount; Index++)
 		{
 			Data[Index] = InitialValue;
 		}
+
+		if (HasMaxPyramid())
+		{
+			// (Re)build for the current bounds, with everything dirty
+			MaxPyramid.Init(BoxWidth, BoxHeight);
+		}
 	}
 	else
 	{
 		Data.Empty();
+		MaxPyramid.Reset();
+	}
+}
+
+void FGAGridMap::SetLayout(EGridLayout NewLayout)
+{
+	if (NewLayout == Layout)
+	{
+		return;
+	}
+
+	if (!IsValid())
+	{
+		Layout = NewLayout;
+		return;
 	}
+
+	FGridLayoutIndexer OldIndexer = GetIndexer();
+	FGridLayoutIndexer NewIndexer(NewLayout, GridBounds.GetWidth(), GridBounds.GetHeight());
+
+	TArray<float> NewData;
+	NewData.SetNumZeroed(NewIndexer.GetStorageCount());
+
+	for (int32 Y = 0; Y < OldIndexer.Height; Y++)
+	{
+		for (int32 X = 0; X < OldIndexer.Width; X++)
+		{
+			NewData[NewIndexer.ToIndex(X, Y)] = Data[OldIndexer.ToIndex(X, Y)];
+		}
+	}
+
+	Data = MoveTemp(NewData);
+	Layout = NewLayout;
 }
 
 
@@ -99,7 +181,7 @@ bool FGAGridMap::GetValue(const FCellRef& Cell, float &ValueOut) const
 	int32 X, Y;
 	if (CellRefToLocal(Cell, X, Y))
 	{
-		int32 Index = GridBounds.GetWidth()* Y + X;
+		int32 Index = GetIndexer().ToIndex(X, Y);
 		check(Data.IsValidIndex(Index));
 		ValueOut = Data[Index];
 		return true;
@@ -111,15 +193,32 @@ bool FGAGridMap::GetMaxValue(float& MaxValueOut, float IgnoreThreshold) const
 {
 	if (IsValid())
 	{
-		MaxValueOut = -UE_MAX_FLT;
-		for (int32 Index = 0; Index < Data.Num(); Index++)
+		if (HasMaxPyramid())
 		{
-			float Value = Data[Index];
-			if (Value <= IgnoreThreshold)
+			RefreshMaxPyramid();
+			const FGAGridMaxPyramid::FEntry& Top = MaxPyramid.Levels.Last()[0];
+			if (Top.Max <= IgnoreThreshold)
 			{
-				MaxValueOut = FMath::Max(MaxValueOut, Data[Index]);
+				MaxValueOut = Top.Max;
+				return true;
 			}
+			// Otherwise the max is one of the ignored values, and we have to go looking the slow way
 		}
+
+		MaxValueOut = -UE_MAX_FLT;
+
+		// Walk the spans rather than the raw array, so that tile padding is never considered
+		ForEachSpan([&](int32 Index, int32 Count, int32 CellX, int32 CellY)
+		{
+			for (int32 I = Index; I < Index + Count; I++)
+			{
+				float Value = Data[I];
+				if (Value <= IgnoreThreshold)
+				{
+					MaxValueOut = FMath::Max(MaxValueOut, Value);
+				}
+			}
+		});
 		return true;
 	}
 	return false;
@@ -131,13 +230,29 @@ bool FGAGridMap::SetValue(const FCellRef& Cell, float Value)
 	int32 X, Y;
 	if (CellRefToLocal(Cell, X, Y))
 	{
-		int32 Index = GridBounds.GetWidth()* Y + X;
+		int32 Index = GetIndexer().ToIndex(X, Y);
 		check(Data.IsValidIndex(Index));
 		Data[Index] = Value;
+		MaxPyramid.MarkDirty(X, Y);
 		return true;
 	}
 	return false;
 }
 
+bool FGAGridMap::IsIndexCompatible(const FGAGridMap& Other) const
+{
+	return (Layout == Other.Layout) &&
+		(GridBounds.MinX == Other.GridBounds.MinX) && (GridBounds.MaxX == Other.GridBounds.MaxX) &&
+		(GridBounds.MinY == Other.GridBounds.MinY) && (GridBounds.MaxY == Other.GridBounds.MaxY) &&
+		(Data.Num() == Other.Data.Num());
+}
 
-UE_DISABLE_OPTIMIZATION
+bool FGAGridMap::IsIndexCompatible(const AGAGridActor* Grid) const
+{
+	return Grid && IsValid() && (Layout == Grid->CellLayout) &&
+		(GridBounds.MinX == 0) && (GridBounds.MaxX == Grid->XCount - 1) &&
+		(GridBounds.MinY == 0) && (GridBounds.MaxY == Grid->YCount - 1);
+}
+
+
+UE_ENABLE_OPTIMIZATION
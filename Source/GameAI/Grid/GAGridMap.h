@@ -11,6 +11,118 @@
 class AGAGridActor;
 struct FCellRef;
 
+
+// How the cells of a grid map (or of the grid actor's cell arrays) are laid out in memory.
+// Row major is the classic layout: all the values in a given X-row are stored in consecutive spans of memory.
+// The tiled layouts instead store square blocks of cells consecutively (the blocks themselves are row major,
+// and so are the cells inside a block). An 8-neighbor stencil on a wide row-major grid touches three distant
+// cache lines per cell; with tiles it mostly stays within one block.
+UENUM(BlueprintType)
+enum EGridLayout
+{
+	GL_RowMajor			UMETA(DisplayName = "Row Major"),
+	GL_Tiled8			UMETA(DisplayName = "Tiled 8x8"),
+	GL_Tiled16			UMETA(DisplayName = "Tiled 16x16"),
+};
+
+
+// Index math for a Width x Height block of cells stored in the given layout.
+// This is cheap to build, so callers grab one before a hot loop rather than going through GetValue/SetValue.
+// Note: in the tiled layouts the storage is padded out to a whole number of tiles, so the
+// storage count can be larger than Width * Height. Padding cells are never handed out by the iterators.
+struct FGridLayoutIndexer
+{
+	FGridLayoutIndexer() : Width(0), Height(0), TileShift(0), TilesX(0) {}
+	FGridLayoutIndexer(EGridLayout Layout, int32 WidthIn, int32 HeightIn);
+
+	static int32 GetTileShift(EGridLayout Layout);
+
+	int32 Width;
+	int32 Height;
+
+	// log2 of the tile dimension, 0 for row major
+	int32 TileShift;
+
+	// Number of tiles per row of tiles (unused for row major)
+	int32 TilesX;
+
+	FORCEINLINE bool IsTiled() const { return TileShift > 0; }
+
+	FORCEINLINE int32 ToIndex(int32 X, int32 Y) const
+	{
+		if (TileShift == 0)
+		{
+			return Y * Width + X;
+		}
+
+		const int32 TileMask = (1 << TileShift) - 1;
+		const int32 TileIndex = (Y >> TileShift) * TilesX + (X >> TileShift);
+		return (TileIndex << (2 * TileShift)) + ((Y & TileMask) << TileShift) + (X & TileMask);
+	}
+
+	// Inverse of ToIndex. Indices of padding cells (tiled layouts) come out past Width/Height
+	FORCEINLINE void ToCoords(int32 Index, int32& XOut, int32& YOut) const
+	{
+		if (TileShift == 0)
+		{
+			YOut = Index / Width;
+			XOut = Index - YOut * Width;
+			return;
+		}
+
+		const int32 TileMask = (1 << TileShift) - 1;
+		const int32 TileIndex = Index >> (2 * TileShift);
+		const int32 TileY = TileIndex / TilesX;
+		XOut = ((TileIndex - TileY * TilesX) << TileShift) + (Index & TileMask);
+		YOut = (TileY << TileShift) + ((Index >> TileShift) & TileMask);
+	}
+
+	int32 GetStorageCount() const;
+
+	// Calls Func(int32 Index, int32 Count, int32 X, int32 Y) for every run of cells in the (local, inclusive) box
+	// that are both horizontally adjacent and consecutive in memory. (X, Y) is the local position of the first cell of the run.
+	// Runs are visited in storage order.
+	template<typename FuncType>
+	void ForEachSpan(int32 MinX, int32 MinY, int32 MaxX, int32 MaxY, FuncType Func) const
+	{
+		if (TileShift == 0)
+		{
+			if (MinX == 0 && MaxX == Width - 1)
+			{
+				// Full rows are contiguous with each other, so the whole box is a single run
+				Func(MinY * Width, Width * (MaxY - MinY + 1), 0, MinY);
+			}
+			else
+			{
+				for (int32 Y = MinY; Y <= MaxY; Y++)
+				{
+					Func(Y * Width + MinX, MaxX - MinX + 1, MinX, Y);
+				}
+			}
+			return;
+		}
+
+		const int32 TileDim = 1 << TileShift;
+		for (int32 TileY = MinY >> TileShift; TileY <= (MaxY >> TileShift); TileY++)
+		{
+			const int32 Y0 = FMath::Max(MinY, TileY << TileShift);
+			const int32 Y1 = FMath::Min(MaxY, (TileY << TileShift) + TileDim - 1);
+
+			for (int32 TileX = MinX >> TileShift; TileX <= (MaxX >> TileShift); TileX++)
+			{
+				const int32 X0 = FMath::Max(MinX, TileX << TileShift);
+				const int32 X1 = FMath::Min(MaxX, (TileX << TileShift) + TileDim - 1);
+
+				for (int32 Y = Y0; Y <= Y1; Y++)
+				{
+					Func(ToIndex(X0, Y), X1 - X0 + 1, X0, Y);
+				}
+			}
+		}
+	}
+};
+
+
 USTRUCT(BlueprintType)
 struct FGridBox
 {
@@ -48,6 +160,80 @@ struct FGridBox
 	int32 GetCellCount() const { return ((MaxX - MinX) + 1) * ((MaxY - MinY) + 1); }
 
 	bool IsValidCell(const FCellRef& Cell) const;
+
+	// Grown by Amount cells on every side, then clipped to Bounds (which can leave it invalid)
+	FGridBox GetExpanded(int32 Amount, const FGridBox& Bounds) const
+	{
+		if (!IsValid())
+		{
+			return *this;
+		}
+		return FGridBox(FMath::Max(MinX - Amount, Bounds.MinX), FMath::Min(MaxX + Amount, Bounds.MaxX),
+			FMath::Max(MinY - Amount, Bounds.MinY), FMath::Min(MaxY + Amount, Bounds.MaxY));
+	}
+
+	// Smallest box covering both. An invalid box counts as empty
+	FGridBox GetUnion(const FGridBox& Other) const
+	{
+		if (!IsValid())
+		{
+			return Other;
+		}
+		if (!Other.IsValid())
+		{
+			return *this;
+		}
+		return FGridBox(FMath::Min(MinX, Other.MinX), FMath::Max(MaxX, Other.MaxX), FMath::Min(MinY, Other.MinY), FMath::Max(MaxY, Other.MaxY));
+	}
+
+	bool operator==(const FGridBox& Other) const
+	{
+		return (MinX == Other.MinX) && (MaxX == Other.MaxX) && (MinY == Other.MinY) && (MaxY == Other.MaxY);
+	}
+};
+
+
+// A hierarchical max/argmax over the cells of an FGAGridMap (see FGAGridMap::EnableMaxPyramid)
+// Level 0 holds the max of each 8x8 tile of cells, and each level above holds the max of 2x2 entries of the level
+// below, up to a single entry for the whole map. Writes only flag their tile as dirty. The pyramid is brought up to date
+// lazily by the next query, which rescans just the dirty tiles and their ancestors.
+struct FGAGridMaxPyramid
+{
+	static constexpr int32 TileShift = 3;
+
+	struct FEntry
+	{
+		float Max;
+
+		// Local (i.e. relative to the map's GridBounds) coordinates of the max cell
+		int32 X;
+		int32 Y;
+	};
+
+	// Entries for each level (row major), and the dimensions of each level
+	TArray<TArray<FEntry>> Levels;
+	TArray<FIntPoint> LevelSizes;
+
+	// One dirty flag per entry, per level
+	TArray<TBitArray<>> Dirty;
+	bool bAnyDirty = false;
+
+	bool IsEnabled() const { return Levels.Num() > 0; }
+
+	void Init(int32 Width, int32 Height);
+	void Reset();
+
+	FORCEINLINE void MarkDirty(int32 LocalX, int32 LocalY)
+	{
+		if (IsEnabled())
+		{
+			Dirty[0][(LocalY >> TileShift) * LevelSizes[0].X + (LocalX >> TileShift)] = true;
+			bAnyDirty = true;
+		}
+	}
+
+	// Local, inclusive box
+	void MarkDirty(int32 MinX, int32 MinY, int32 MaxX, int32 MaxY);
 };
 
 
@@ -63,6 +249,9 @@ struct FGAGridMap
 
 	void ResetData(float InitialValue);
 
+	// Re-lay the existing values out in a different memory layout
+	void SetLayout(EGridLayout NewLayout);
+
 	// The XCount of the GridActor I'm built on
 	UPROPERTY(BlueprintReadOnly)
 	int32 XCount;
@@ -78,10 +267,117 @@ struct FGAGridMap
 	UPROPERTY(BlueprintReadOnly)
 	FGridBox GridBounds;
 
+	// How Data is laid out. Maps built over the whole grid inherit the grid actor's layout, so that
+	// their indices line up with AGAGridActor::CellRefToIndex
+	UPROPERTY(BlueprintReadOnly)
+	TEnumAsByte<EGridLayout> Layout;
+
+	// The raw values. Don't index this directly unless you know the layout -- use GetIndexer(),
+	// ForEachSpan() or ForEachCell() instead
 	UPROPERTY(BlueprintReadOnly)
 	TArray<float> Data;
 
 
+	FORCEINLINE FGridLayoutIndexer GetIndexer() const
+	{
+		return FGridLayoutIndexer(Layout, GridBounds.GetWidth(), GridBounds.GetHeight());
+	}
+
+	// Index into Data of the given cell. Assumes the cell is inside GridBounds
+	FORCEINLINE int32 CellRefToIndexUnchecked(int32 CellX, int32 CellY) const
+	{
+		return GetIndexer().ToIndex(CellX - GridBounds.MinX, CellY - GridBounds.MinY);
+	}
+
+	// Calls Func(int32 Index, int32 Count, int32 CellX, int32 CellY) for each run of memory-consecutive cells
+	// inside Box (in grid cell coordinates, clipped to my bounds). The run starts at cell (CellX, CellY) and covers
+	// Count cells along X -- or, for full-width row major boxes, several whole rows one after the other.
+	template<typename FuncType>
+	void ForEachSpan(const FGridBox& Box, FuncType Func) const
+	{
+		if (!IsValid() || !Box.IsValid())
+		{
+			return;
+		}
+
+		const int32 MinX = FMath::Max(Box.MinX, GridBounds.MinX) - GridBounds.MinX;
+		const int32 MaxX = FMath::Min(Box.MaxX, GridBounds.MaxX) - GridBounds.MinX;
+		const int32 MinY = FMath::Max(Box.MinY, GridBounds.MinY) - GridBounds.MinY;
+		const int32 MaxY = FMath::Min(Box.MaxY, GridBounds.MaxY) - GridBounds.MinY;
+
+		if (MinX <= MaxX && MinY <= MaxY)
+		{
+			GetIndexer().ForEachSpan(MinX, MinY, MaxX, MaxY, [&](int32 Index, int32 Count, int32 X, int32 Y)
+			{
+				Func(Index, Count, X + GridBounds.MinX, Y + GridBounds.MinY);
+			});
+		}
+	}
+
+	template<typename FuncType>
+	void ForEachSpan(FuncType Func) const
+	{
+		ForEachSpan(GridBounds, Func);
+	}
+
+	// Calls Func(int32 CellX, int32 CellY, float Value) for every cell in Box, in storage order
+	template<typename FuncType>
+	void ForEachCell(const FGridBox& Box, FuncType Func) const
+	{
+		const int32 Width = GridBounds.GetWidth();
+		ForEachSpan(Box, [&](int32 Index, int32 Count, int32 CellX, int32 CellY)
+		{
+			// A run can wrap onto following rows only in the row major layout
+			int32 X = CellX - GridBounds.MinX;
+			int32 Y = CellY;
+			for (int32 I = 0; I < Count; I++)
+			{
+				Func(X + GridBounds.MinX, Y, Data[Index + I]);
+				if (++X == Width)
+				{
+					X = 0;
+					Y++;
+				}
+			}
+		});
+	}
+
+	// Mutable version: Func(int32 CellX, int32 CellY, float& Value)
+	template<typename FuncType>
+	void ForEachCell(const FGridBox& Box, FuncType Func)
+	{
+		MarkDirty(Box);
+
+		const int32 Width = GridBounds.GetWidth();
+		ForEachSpan(Box, [&](int32 Index, int32 Count, int32 CellX, int32 CellY)
+		{
+			int32 X = CellX - GridBounds.MinX;
+			int32 Y = CellY;
+			for (int32 I = 0; I < Count; I++)
+			{
+				Func(X + GridBounds.MinX, Y, Data[Index + I]);
+				if (++X == Width)
+				{
+					X = 0;
+					Y++;
+				}
+			}
+		});
+	}
+
+	template<typename FuncType>
+	void ForEachCell(FuncType Func) const
+	{
+		ForEachCell(GridBounds, Func);
+	}
+
+	template<typename FuncType>
+	void ForEachCell(FuncType Func)
+	{
+		ForEachCell(GridBounds, Func);
+	}
+
+
 	bool CellRefToLocal(const FCellRef& Cell, int32& X, int32& Y) const;
 
 	bool LocalToCellRef(int32 X, int32 Y, FCellRef& Cell) const;
@@ -92,9 +388,99 @@ struct FGAGridMap
 
 	bool SetValue(const FCellRef& Cell, float Value);
 
+	// True if Other has the same bounds and layout as me, i.e. the same index refers to the same cell in both
+	bool IsIndexCompatible(const FGAGridMap& Other) const;
+
+	// True if I cover the whole grid in the grid's own layout, i.e. my indices line up with AGAGridActor::CellRefToIndex
+	bool IsIndexCompatible(const AGAGridActor* Grid) const;
+
+
+	// Bulk operations ------------------------
+	// These run over contiguous spans of Data with SIMD (UE's portable VectorRegister4Float, i.e. SSE or NEON)
+	// plus a scalar tail, so prefer them to loops of GetValue/SetValue.
+	// The versions taking a Box are restricted to it (clipped to my bounds); the others cover the whole map.
+	// Binary operations only touch cells that Other covers too. They are fastest when Other is index compatible.
+	// Implemented in GAGridMapKernels.cpp
+
+	void Fill(float Value);
+	void Fill(const FGridBox& Box, float Value);
+
+	// Me = Me + Other
+	void Add(const FGAGridMap& Other);
+	void Add(const FGridBox& Box, const FGAGridMap& Other);
+
+	// Me = Me * Other
+	void Multiply(const FGAGridMap& Other);
+	void Multiply(const FGridBox& Box, const FGAGridMap& Other);
+
+	// Me = Me * Factor
+	void Scale(float Factor);
+	void Scale(const FGridBox& Box, float Factor);
+
+	void Clamp(float MinValue, float MaxValue);
+	void Clamp(const FGridBox& Box, float MinValue, float MaxValue);
+
+	// Me = Me + (Other - Me) * Alpha
+	void Lerp(const FGAGridMap& Other, float Alpha);
+	void Lerp(const FGridBox& Box, const FGAGridMap& Other, float Alpha);
+
+	// Masked select against the grid's traversability: non-traversable cells are set to NonTraversableValue,
+	// traversable ones keep their value
+	void SelectTraversable(const AGAGridActor* Grid, float NonTraversableValue);
+	void SelectTraversable(const FGridBox& Box, const AGAGridActor* Grid, float NonTraversableValue);
+
+	float Sum() const;
+	float Sum(const FGridBox& Box) const;
+
+	// Scale so that the values sum to 1. Returns false (and leaves the map alone) if they sum to 0
+	bool Normalize();
+	bool Normalize(const FGridBox& Box);
+
+	bool GetMinMax(float& MinValueOut, float& MaxValueOut) const;
+	bool GetMinMax(const FGridBox& Box, float& MinValueOut, float& MaxValueOut) const;
+
+	// The cell with the highest value. Ties go to the first such cell in storage order
+	// (or, with the max pyramid enabled, to whichever the pyramid finds first)
+	bool ArgMax(FCellRef& CellOut, float& MaxValueOut) const;
+	bool ArgMax(const FGridBox& Box, FCellRef& CellOut, float& MaxValueOut) const;
+
+
+	// Max pyramid ------------------------
+	// Optionally, a map can maintain a FGAGridMaxPyramid. It is refreshed lazily (only the tiles written since the last
+	// query get rescanned), and lets ArgMax, GetMaxValue, GetTopK and GetCellsAbove run in roughly logarithmic time
+	// instead of scanning the map. Worth it for maps that are queried more often than they are rewritten wholesale.
+	// Implemented in GAGridMapPyramid.cpp
+
+	void EnableMaxPyramid(bool bEnable);
+
+	bool HasMaxPyramid() const { return MaxPyramid.IsEnabled(); }
+
+	// Flag cells as modified, so the pyramid rescans them. Only needed after writing to Data directly:
+	// SetValue, ResetData, the bulk operations and the mutable ForEachCell all do it for you
+	FORCEINLINE void MarkDirty(int32 CellX, int32 CellY)
+	{
+		MaxPyramid.MarkDirty(CellX - GridBounds.MinX, CellY - GridBounds.MinY);
+	}
+	void MarkDirty(const FGridBox& Box);
+
+	// The (up to) K highest cells in Box, in descending order of value
+	void GetTopK(const FGridBox& Box, int32 K, TArray<FCellRef>& CellsOut, TArray<float>& ValuesOut) const;
+
+	// All cells in Box whose value is >= Threshold
+	void GetCellsAbove(const FGridBox& Box, float Threshold, TArray<FCellRef>& CellsOut) const;
+
+protected:
+	void RefreshMaxPyramid() const;
+	bool PyramidArgMax(const FGridBox& Box, FCellRef& CellOut, float& MaxValueOut) const;
+
+	// Not a UPROPERTY -- it's derived data, rebuilt on demand
+	mutable FGAGridMaxPyramid MaxPyramid;
+
+public:
+
 
 	FORCEINLINE bool IsValid() const
 	{
-		return GridBounds.IsValid() && (GridBounds.GetCellCount() == Data.Num());
+		return GridBounds.IsValid() && (GetIndexer().GetStorageCount() == Data.Num());
 	}
 };
\ No newline at end of file
@@ -0,0 +1,144 @@
+#include "GAGridMapIntegral.h"
+
+
+FGAGridMapIntegral::FGAGridMapIntegral() : GridBounds()
+{
+	// we are empty
+}
+
+FGAGridMapIntegral::FGAGridMapIntegral(const FGAGridMap& Map)
+{
+	Build(Map);
+}
+
+void FGAGridMapIntegral::Reset()
+{
+	GridBounds = FGridBox();
+	Sums.Reset();
+}
+
+void FGAGridMapIntegral::Build(const FGAGridMap& Map)
+{
+	if (!Map.IsValid())
+	{
+		Reset();
+		return;
+	}
+
+	GridBounds = Map.GridBounds;
+	InitSums();
+
+	// Scatter the cell values into place first, walking the map in its own storage order (whatever the layout)...
+	const int32 Stride = GridBounds.GetWidth() + 1;
+	Map.ForEachCell(GridBounds, [&](int32 CellX, int32 CellY, float Value)
+	{
+		Sums[(CellY - GridBounds.MinY + 1) * Stride + (CellX - GridBounds.MinX + 1)] = Value;
+	});
+
+	// ... then accumulate in place
+	Accumulate();
+}
+
+void FGAGridMapIntegral::Build(const FGASparseGridMap& Map)
+{
+	GridBounds = Map.IsValid() ? Map.GetAllocatedBounds() : FGridBox();
+	if (!GridBounds.IsValid())
+	{
+		Reset();
+		return;
+	}
+
+	InitSums();
+
+	// The box can have holes (unallocated tiles between allocated ones), so start from zeros
+	const int32 Stride = GridBounds.GetWidth() + 1;
+	FMemory::Memzero(Sums.GetData() + Stride, Stride * GridBounds.GetHeight() * sizeof(double));
+	Map.ForEachAllocatedCell([&](int32 CellX, int32 CellY, float Value)
+	{
+		Sums[(CellY - GridBounds.MinY + 1) * Stride + (CellX - GridBounds.MinX + 1)] = Value;
+	});
+
+	Accumulate();
+}
+
+void FGAGridMapIntegral::InitSums()
+{
+	const int32 Stride = GridBounds.GetWidth() + 1;
+	Sums.SetNumUninitialized(Stride * (GridBounds.GetHeight() + 1));
+
+	// Leading row of zeros
+	for (int32 X = 0; X < Stride; X++)
+	{
+		Sums[X] = 0.0;
+	}
+}
+
+void FGAGridMapIntegral::Accumulate()
+{
+	const int32 Stride = GridBounds.GetWidth() + 1;
+	const int32 Height = GridBounds.GetHeight();
+
+	// Each entry only depends on the row above, which is already done
+	double* Above = Sums.GetData();
+	for (int32 Y = 0; Y < Height; Y++)
+	{
+		double* Row = Above + Stride;
+		Row[0] = 0.0;
+
+		double RowSum = 0.0;
+		for (int32 X = 1; X < Stride; X++)
+		{
+			RowSum += Row[X];
+			Row[X] = Above[X] + RowSum;
+		}
+
+		Above = Row;
+	}
+}
+
+
+bool FGAGridMapIntegral::ClipBox(const FGridBox& Box, FGridBox& ClippedOut) const
+{
+	if (IsValid() && Box.IsValid())
+	{
+		ClippedOut = FGridBox(
+			FMath::Max(Box.MinX, GridBounds.MinX), FMath::Min(Box.MaxX, GridBounds.MaxX),
+			FMath::Max(Box.MinY, GridBounds.MinY), FMath::Min(Box.MaxY, GridBounds.MaxY));
+		return (ClippedOut.MinX <= ClippedOut.MaxX) && (ClippedOut.MinY <= ClippedOut.MaxY);
+	}
+	return false;
+}
+
+double FGAGridMapIntegral::GetBoxSum(const FGridBox& Box) const
+{
+	FGridBox Clipped;
+	if (!ClipBox(Box, Clipped))
+	{
+		return 0.0;
+	}
+
+	const int32 Stride = GridBounds.GetWidth() + 1;
+	const int32 X0 = Clipped.MinX - GridBounds.MinX;
+	const int32 X1 = Clipped.MaxX - GridBounds.MinX + 1;
+	const int32 Y0 = Clipped.MinY - GridBounds.MinY;
+	const int32 Y1 = Clipped.MaxY - GridBounds.MinY + 1;
+
+	return Sums[Y1 * Stride + X1] - Sums[Y0 * Stride + X1] - Sums[Y1 * Stride + X0] + Sums[Y0 * Stride + X0];
+}
+
+int32 FGAGridMapIntegral::GetBoxCount(const FGridBox& Box) const
+{
+	FGridBox Clipped;
+	return ClipBox(Box, Clipped) ? Clipped.GetCellCount() : 0;
+}
+
+bool FGAGridMapIntegral::GetBoxMean(const FGridBox& Box, float& MeanOut) const
+{
+	const int32 Count = GetBoxCount(Box);
+	if (Count > 0)
+	{
+		MeanOut = float(GetBoxSum(Box) / double(Count));
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GAGridMap.h"
+#include "GASparseGridMap.h"
+
+
+// A summed-area table (integral image) built from an FGAGridMap
+// Entry (X, Y) holds the sum of every cell of the source map above and to the left of cell (X, Y), so the sum over
+// any rectangle comes out of four lookups, whatever its size. Handy for box blurs of any radius and for density
+// queries ("how much probability is within R cells of here?").
+//
+// The table is a snapshot: it doesn't follow later writes to the source map. Call Build() again after changing it.
+// Sums are kept in double precision, since large maps would otherwise lose the small values to rounding.
+
+struct FGAGridMapIntegral
+{
+	FGAGridMapIntegral();
+	explicit FGAGridMapIntegral(const FGAGridMap& Map);
+
+	// (Re)build from the given map. Allocation is kept around when the size doesn't change
+	void Build(const FGAGridMap& Map);
+
+	// Same, from a sparse map whose default value is 0. The table then only covers its allocated tiles, so it costs
+	// what the map does rather than the size of the grid (the cells left out are all 0 anyway)
+	void Build(const FGASparseGridMap& Map);
+
+	void Reset();
+
+	// The bounds of the map I was built from
+	FGridBox GridBounds;
+
+
+	bool IsValid() const { return GridBounds.IsValid() && (Sums.Num() == (GridBounds.GetWidth() + 1) * (GridBounds.GetHeight() + 1)); }
+
+	// Sum of the cells in Box (in grid cell coordinates). The box is clipped to my bounds; zero if nothing is left
+	double GetBoxSum(const FGridBox& Box) const;
+
+	// Number of cells of Box inside my bounds
+	int32 GetBoxCount(const FGridBox& Box) const;
+
+	// Average over the cells of Box inside my bounds. Returns false if the box doesn't overlap the map at all
+	bool GetBoxMean(const FGridBox& Box, float& MeanOut) const;
+
+	// Square neighborhood of the given radius around a cell
+	static FGridBox GetRadiusBox(int32 CellX, int32 CellY, int32 Radius)
+	{
+		return FGridBox(CellX - Radius, CellX + Radius, CellY - Radius, CellY + Radius);
+	}
+
+protected:
+	// Size Sums for GridBounds, zeroing the leading row (the rest is for the caller to fill in with cell values)
+	void InitSums();
+
+	// Turn the cell values scattered into Sums into the running sums
+	void Accumulate();
+
+	bool ClipBox(const FGridBox& Box, FGridBox& ClippedOut) const;
+
+	// (Width + 1) x (Height + 1), row major, with a leading row and column of zeros so that no lookup needs a branch
+	TArray<double> Sums;
+};
@@ -0,0 +1,385 @@
+#include "GAGridMap.h"
+#include "GAGridActor.h"
+#include "Math/VectorRegister.h"
+
+// Bulk operations on FGAGridMap
+// Everything here works on spans of Data (see FGAGridMap::ForEachSpan), four floats at a time
+// using UE's VectorRegister4Float (SSE on x64, NEON on ARM), followed by a scalar tail.
+// Note: unlike the rest of the grid code this file is NOT wrapped in UE_DISABLE_OPTIMIZATION, on purpose.
+
+
+namespace
+{
+	// Dst[i] = Op(Dst[i])
+	template<typename VectorOpType, typename ScalarOpType>
+	FORCEINLINE void UnarySpan(float* Dst, int32 Count, VectorOpType VectorOp, ScalarOpType ScalarOp)
+	{
+		int32 I = 0;
+		for (; I + 4 <= Count; I += 4)
+		{
+			VectorStore(VectorOp(VectorLoad(Dst + I)), Dst + I);
+		}
+		for (; I < Count; I++)
+		{
+			Dst[I] = ScalarOp(Dst[I]);
+		}
+	}
+
+	// Dst[i] = Op(Dst[i], Src[i])
+	template<typename VectorOpType, typename ScalarOpType>
+	FORCEINLINE void BinarySpan(float* Dst, const float* Src, int32 Count, VectorOpType VectorOp, ScalarOpType ScalarOp)
+	{
+		int32 I = 0;
+		for (; I + 4 <= Count; I += 4)
+		{
+			VectorStore(VectorOp(VectorLoad(Dst + I), VectorLoad(Src + I)), Dst + I);
+		}
+		for (; I < Count; I++)
+		{
+			Dst[I] = ScalarOp(Dst[I], Src[I]);
+		}
+	}
+
+	float HorizontalSum(const VectorRegister4Float& Vec)
+	{
+		float Lanes[4];
+		VectorStore(Vec, Lanes);
+		return (Lanes[0] + Lanes[1]) + (Lanes[2] + Lanes[3]);
+	}
+
+	float HorizontalMin(const VectorRegister4Float& Vec)
+	{
+		float Lanes[4];
+		VectorStore(Vec, Lanes);
+		return FMath::Min(FMath::Min(Lanes[0], Lanes[1]), FMath::Min(Lanes[2], Lanes[3]));
+	}
+
+	float HorizontalMax(const VectorRegister4Float& Vec)
+	{
+		float Lanes[4];
+		VectorStore(Vec, Lanes);
+		return FMath::Max(FMath::Max(Lanes[0], Lanes[1]), FMath::Max(Lanes[2], Lanes[3]));
+	}
+
+	float SpanSum(const float* Src, int32 Count)
+	{
+		VectorRegister4Float Acc = VectorZeroFloat();
+		int32 I = 0;
+		for (; I + 4 <= Count; I += 4)
+		{
+			Acc = VectorAdd(Acc, VectorLoad(Src + I));
+		}
+		float Result = HorizontalSum(Acc);
+		for (; I < Count; I++)
+		{
+			Result += Src[I];
+		}
+		return Result;
+	}
+
+	float SpanMax(const float* Src, int32 Count)
+	{
+		float Result = -UE_MAX_FLT;
+		int32 I = 0;
+		if (Count >= 4)
+		{
+			VectorRegister4Float Acc = VectorLoad(Src);
+			for (I = 4; I + 4 <= Count; I += 4)
+			{
+				Acc = VectorMax(Acc, VectorLoad(Src + I));
+			}
+			Result = HorizontalMax(Acc);
+		}
+		for (; I < Count; I++)
+		{
+			Result = FMath::Max(Result, Src[I]);
+		}
+		return Result;
+	}
+
+	// Applies a binary op between Map and Other over Box. Takes the SIMD path when the two maps share indices,
+	// otherwise falls back to a per-cell lookup into Other
+	template<typename VectorOpType, typename ScalarOpType>
+	void ApplyBinary(FGAGridMap& Map, const FGridBox& Box, const FGAGridMap& Other, VectorOpType VectorOp, ScalarOpType ScalarOp)
+	{
+		if (Map.IsIndexCompatible(Other))
+		{
+			Map.MarkDirty(Box);
+
+			float* Dst = Map.Data.GetData();
+			const float* Src = Other.Data.GetData();
+			Map.ForEachSpan(Box, [&](int32 Index, int32 Count, int32 CellX, int32 CellY)
+			{
+				BinarySpan(Dst + Index, Src + Index, Count, VectorOp, ScalarOp);
+			});
+		}
+		else if (Other.IsValid())
+		{
+			Map.ForEachCell(Box, [&](int32 X, int32 Y, float& Value)
+			{
+				float OtherValue;
+				if (Other.GetValue(FCellRef(X, Y), OtherValue))
+				{
+					Value = ScalarOp(Value, OtherValue);
+				}
+			});
+		}
+	}
+
+	template<typename VectorOpType, typename ScalarOpType>
+	void ApplyUnary(FGAGridMap& Map, const FGridBox& Box, VectorOpType VectorOp, ScalarOpType ScalarOp)
+	{
+		Map.MarkDirty(Box);
+
+		float* Dst = Map.Data.GetData();
+		Map.ForEachSpan(Box, [&](int32 Index, int32 Count, int32 CellX, int32 CellY)
+		{
+			UnarySpan(Dst + Index, Count, VectorOp, ScalarOp);
+		});
+	}
+}
+
+
+void FGAGridMap::Fill(float Value)
+{
+	Fill(GridBounds, Value);
+}
+
+void FGAGridMap::Fill(const FGridBox& Box, float Value)
+{
+	const VectorRegister4Float ValueVec = VectorSetFloat1(Value);
+	ApplyUnary(*this, Box,
+		[&](VectorRegister4Float A) { return ValueVec; },
+		[&](float A) { return Value; });
+}
+
+
+void FGAGridMap::Add(const FGAGridMap& Other)
+{
+	Add(GridBounds, Other);
+}
+
+void FGAGridMap::Add(const FGridBox& Box, const FGAGridMap& Other)
+{
+	ApplyBinary(*this, Box, Other,
+		[](VectorRegister4Float A, VectorRegister4Float B) { return VectorAdd(A, B); },
+		[](float A, float B) { return A + B; });
+}
+
+
+void FGAGridMap::Multiply(const FGAGridMap& Other)
+{
+	Multiply(GridBounds, Other);
+}
+
+void FGAGridMap::Multiply(const FGridBox& Box, const FGAGridMap& Other)
+{
+	ApplyBinary(*this, Box, Other,
+		[](VectorRegister4Float A, VectorRegister4Float B) { return VectorMultiply(A, B); },
+		[](float A, float B) { return A * B; });
+}
+
+
+void FGAGridMap::Scale(float Factor)
+{
+	Scale(GridBounds, Factor);
+}
+
+void FGAGridMap::Scale(const FGridBox& Box, float Factor)
+{
+	const VectorRegister4Float FactorVec = VectorSetFloat1(Factor);
+	ApplyUnary(*this, Box,
+		[&](VectorRegister4Float A) { return VectorMultiply(A, FactorVec); },
+		[&](float A) { return A * Factor; });
+}
+
+
+void FGAGridMap::Clamp(float MinValue, float MaxValue)
+{
+	Clamp(GridBounds, MinValue, MaxValue);
+}
+
+void FGAGridMap::Clamp(const FGridBox& Box, float MinValue, float MaxValue)
+{
+	const VectorRegister4Float MinVec = VectorSetFloat1(MinValue);
+	const VectorRegister4Float MaxVec = VectorSetFloat1(MaxValue);
+	ApplyUnary(*this, Box,
+		[&](VectorRegister4Float A) { return VectorMin(VectorMax(A, MinVec), MaxVec); },
+		[&](float A) { return FMath::Clamp(A, MinValue, MaxValue); });
+}
+
+
+void FGAGridMap::Lerp(const FGAGridMap& Other, float Alpha)
+{
+	Lerp(GridBounds, Other, Alpha);
+}
+
+void FGAGridMap::Lerp(const FGridBox& Box, const FGAGridMap& Other, float Alpha)
+{
+	const VectorRegister4Float AlphaVec = VectorSetFloat1(Alpha);
+	ApplyBinary(*this, Box, Other,
+		[&](VectorRegister4Float A, VectorRegister4Float B) { return VectorMultiplyAdd(VectorSubtract(B, A), AlphaVec, A); },
+		[&](float A, float B) { return A + (B - A) * Alpha; });
+}
+
+
+void FGAGridMap::SelectTraversable(const AGAGridActor* Grid, float NonTraversableValue)
+{
+	SelectTraversable(GridBounds, Grid, NonTraversableValue);
+}
+
+void FGAGridMap::SelectTraversable(const FGridBox& Box, const AGAGridActor* Grid, float NonTraversableValue)
+{
+	if (!Grid)
+	{
+		return;
+	}
+
+	if (IsIndexCompatible(Grid) && (Grid->GetTraversabilityMask().Num() == Data.Num()))
+	{
+		// The grid's float mask lines up with my data, so this is a straight vector select
+		MarkDirty(Box);
+
+		float* Dst = Data.GetData();
+		const float* Mask = Grid->GetTraversabilityMask().GetData();
+		const VectorRegister4Float ReplacementVec = VectorSetFloat1(NonTraversableValue);
+		const VectorRegister4Float ZeroVec = VectorZeroFloat();
+
+		ForEachSpan(Box, [&](int32 Index, int32 Count, int32 CellX, int32 CellY)
+		{
+			BinarySpan(Dst + Index, Mask + Index, Count,
+				[&](VectorRegister4Float A, VectorRegister4Float M) { return VectorSelect(VectorCompareGT(M, ZeroVec), A, ReplacementVec); },
+				[&](float A, float M) { return (M > 0.0f) ? A : NonTraversableValue; });
+		});
+	}
+	else
+	{
+		ForEachCell(Box, [&](int32 X, int32 Y, float& Value)
+		{
+			FCellRef Cell(X, Y);
+			if (!Grid->IsCellRefInBounds(Cell) || !EnumHasAllFlags(Grid->GetCellData(Cell), ECellData::CellDataTraversable))
+			{
+				Value = NonTraversableValue;
+			}
+		});
+	}
+}
+
+
+float FGAGridMap::Sum() const
+{
+	return Sum(GridBounds);
+}
+
+float FGAGridMap::Sum(const FGridBox& Box) const
+{
+	// Accumulate the per-span partial sums in double -- occupancy maps are sums of many tiny probabilities
+	double Total = 0.0;
+	const float* Src = Data.GetData();
+	ForEachSpan(Box, [&](int32 Index, int32 Count, int32 CellX, int32 CellY)
+	{
+		Total += SpanSum(Src + Index, Count);
+	});
+	return float(Total);
+}
+
+
+bool FGAGridMap::Normalize()
+{
+	return Normalize(GridBounds);
+}
+
+bool FGAGridMap::Normalize(const FGridBox& Box)
+{
+	float Total = Sum(Box);
+	if (Total != 0.0f)
+	{
+		Scale(Box, 1.0f / Total);
+		return true;
+	}
+	return false;
+}
+
+
+bool FGAGridMap::GetMinMax(float& MinValueOut, float& MaxValueOut) const
+{
+	return GetMinMax(GridBounds, MinValueOut, MaxValueOut);
+}
+
+bool FGAGridMap::GetMinMax(const FGridBox& Box, float& MinValueOut, float& MaxValueOut) const
+{
+	bool bAny = false;
+	MinValueOut = UE_MAX_FLT;
+	MaxValueOut = -UE_MAX_FLT;
+
+	const float* Src = Data.GetData();
+	ForEachSpan(Box, [&](int32 Index, int32 Count, int32 CellX, int32 CellY)
+	{
+		const float* Span = Src + Index;
+		int32 I = 0;
+		if (Count >= 4)
+		{
+			VectorRegister4Float MinVec = VectorLoad(Span);
+			VectorRegister4Float MaxVec = MinVec;
+			for (I = 4; I + 4 <= Count; I += 4)
+			{
+				VectorRegister4Float Values = VectorLoad(Span + I);
+				MinVec = VectorMin(MinVec, Values);
+				MaxVec = VectorMax(MaxVec, Values);
+			}
+			MinValueOut = FMath::Min(MinValueOut, HorizontalMin(MinVec));
+			MaxValueOut = FMath::Max(MaxValueOut, HorizontalMax(MaxVec));
+		}
+		for (; I < Count; I++)
+		{
+			MinValueOut = FMath::Min(MinValueOut, Span[I]);
+			MaxValueOut = FMath::Max(MaxValueOut, Span[I]);
+		}
+		bAny = true;
+	});
+
+	return bAny;
+}
+
+
+bool FGAGridMap::ArgMax(FCellRef& CellOut, float& MaxValueOut) const
+{
+	return ArgMax(GridBounds, CellOut, MaxValueOut);
+}
+
+bool FGAGridMap::ArgMax(const FGridBox& Box, FCellRef& CellOut, float& MaxValueOut) const
+{
+	if (HasMaxPyramid())
+	{
+		return PyramidArgMax(Box, CellOut, MaxValueOut);
+	}
+
+	bool bAny = false;
+	MaxValueOut = -UE_MAX_FLT;
+
+	const int32 Width = GridBounds.GetWidth();
+	const float* Src = Data.GetData();
+	ForEachSpan(Box, [&](int32 Index, int32 Count, int32 CellX, int32 CellY)
+	{
+		// Vector max over the span first; only go looking for the position when the span actually wins
+		const float* Span = Src + Index;
+		float SpanBest = SpanMax(Span, Count);
+		if (!bAny || (SpanBest > MaxValueOut))
+		{
+			for (int32 I = 0; I < Count; I++)
+			{
+				if (Span[I] == SpanBest)
+				{
+					// Full-width row major spans wrap onto the following rows
+					int32 LocalX = (CellX - GridBounds.MinX) + I;
+					CellOut = FCellRef(GridBounds.MinX + (LocalX % Width), CellY + (LocalX / Width));
+					break;
+				}
+			}
+			MaxValueOut = SpanBest;
+			bAny = true;
+		}
+	});
+
+	return bAny;
+}
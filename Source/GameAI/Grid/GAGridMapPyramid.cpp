@@ -0,0 +1,482 @@
+#include "GAGridMap.h"
+#include "GAGridActor.h"
+#include "Algo/Sort.h"
+
+// The optional max/argmax pyramid on FGAGridMap (see FGAGridMaxPyramid in GAGridMap.h)
+
+
+// --------------------- FGAGridMaxPyramid ---------------------
+
+void FGAGridMaxPyramid::Init(int32 Width, int32 Height)
+{
+	Reset();
+
+	FIntPoint Size((Width + (1 << TileShift) - 1) >> TileShift, (Height + (1 << TileShift) - 1) >> TileShift);
+	while (true)
+	{
+		LevelSizes.Add(Size);
+
+		TArray<FEntry>& Level = Levels.AddDefaulted_GetRef();
+		Level.SetNumZeroed(Size.X * Size.Y);
+
+		TBitArray<>& LevelDirty = Dirty.AddDefaulted_GetRef();
+		LevelDirty.Init(Levels.Num() == 1, Size.X * Size.Y);		// only the leaf level needs marking, the rest follows
+
+		if (Size.X == 1 && Size.Y == 1)
+		{
+			break;
+		}
+		Size = FIntPoint((Size.X + 1) / 2, (Size.Y + 1) / 2);
+	}
+
+	bAnyDirty = true;
+}
+
+void FGAGridMaxPyramid::Reset()
+{
+	Levels.Empty();
+	LevelSizes.Empty();
+	Dirty.Empty();
+	bAnyDirty = false;
+}
+
+void FGAGridMaxPyramid::MarkDirty(int32 MinX, int32 MinY, int32 MaxX, int32 MaxY)
+{
+	if (IsEnabled() && MinX <= MaxX && MinY <= MaxY)
+	{
+		for (int32 TileY = MinY >> TileShift; TileY <= (MaxY >> TileShift); TileY++)
+		{
+			for (int32 TileX = MinX >> TileShift; TileX <= (MaxX >> TileShift); TileX++)
+			{
+				Dirty[0][TileY * LevelSizes[0].X + TileX] = true;
+			}
+		}
+		bAnyDirty = true;
+	}
+}
+
+
+// --------------------- FGAGridMap ---------------------
+
+namespace
+{
+	// Larger value wins. On ties, the earlier cell in row major order wins, so results don't depend on update order
+	FORCEINLINE bool IsBetterEntry(const FGAGridMaxPyramid::FEntry& A, const FGAGridMaxPyramid::FEntry& B)
+	{
+		return (A.Max > B.Max) || ((A.Max == B.Max) && ((A.Y < B.Y) || ((A.Y == B.Y) && (A.X < B.X))));
+	}
+
+	// The local cells covered by pyramid entry (NX, NY) of the given level
+	FORCEINLINE FIntRect GetEntryRect(int32 Level, int32 NX, int32 NY, int32 Width, int32 Height)
+	{
+		const int32 Shift = FGAGridMaxPyramid::TileShift + Level;
+		return FIntRect(NX << Shift, NY << Shift,
+			FMath::Min(((NX + 1) << Shift) - 1, Width - 1),
+			FMath::Min(((NY + 1) << Shift) - 1, Height - 1));
+	}
+
+	// Note: FIntRect is used with INCLUSIVE max corners throughout this file
+	FORCEINLINE bool ClipRect(const FIntRect& A, const FIntRect& B, FIntRect& Out)
+	{
+		Out = FIntRect(FMath::Max(A.Min.X, B.Min.X), FMath::Max(A.Min.Y, B.Min.Y), FMath::Min(A.Max.X, B.Max.X), FMath::Min(A.Max.Y, B.Max.Y));
+		return (Out.Min.X <= Out.Max.X) && (Out.Min.Y <= Out.Max.Y);
+	}
+
+	struct FPyramidNode
+	{
+		float Max;
+		int32 Level;		// INDEX_NONE for an individual cell
+		int32 X;			// entry coordinates within the level, or local cell coordinates for a cell
+		int32 Y;
+
+		// For the max-heap in GetTopK
+		bool operator<(const FPyramidNode& Other) const { return Max > Other.Max; }
+	};
+}
+
+
+void FGAGridMap::EnableMaxPyramid(bool bEnable)
+{
+	if (bEnable && IsValid())
+	{
+		if (!HasMaxPyramid())
+		{
+			MaxPyramid.Init(GridBounds.GetWidth(), GridBounds.GetHeight());
+		}
+	}
+	else
+	{
+		MaxPyramid.Reset();
+	}
+}
+
+void FGAGridMap::MarkDirty(const FGridBox& Box)
+{
+	if (HasMaxPyramid() && Box.IsValid())
+	{
+		MaxPyramid.MarkDirty(
+			FMath::Max(Box.MinX, GridBounds.MinX) - GridBounds.MinX,
+			FMath::Max(Box.MinY, GridBounds.MinY) - GridBounds.MinY,
+			FMath::Min(Box.MaxX, GridBounds.MaxX) - GridBounds.MinX,
+			FMath::Min(Box.MaxY, GridBounds.MaxY) - GridBounds.MinY);
+	}
+}
+
+
+void FGAGridMap::RefreshMaxPyramid() const
+{
+	if (!MaxPyramid.bAnyDirty || !IsValid())
+	{
+		return;
+	}
+
+	const FGridLayoutIndexer Indexer = GetIndexer();
+	const int32 Width = GridBounds.GetWidth();
+	const int32 Height = GridBounds.GetHeight();
+
+	for (int32 Level = 0; Level < MaxPyramid.Levels.Num(); Level++)
+	{
+		TArray<FGAGridMaxPyramid::FEntry>& Entries = MaxPyramid.Levels[Level];
+		TBitArray<>& LevelDirty = MaxPyramid.Dirty[Level];
+		const FIntPoint LevelSize = MaxPyramid.LevelSizes[Level];
+		const bool bHasParent = (Level + 1) < MaxPyramid.Levels.Num();
+
+		for (TConstSetBitIterator<> It(LevelDirty); It; ++It)
+		{
+			const int32 EntryIndex = It.GetIndex();
+			const int32 NX = EntryIndex % LevelSize.X;
+			const int32 NY = EntryIndex / LevelSize.X;
+			FGAGridMaxPyramid::FEntry Best = { -UE_MAX_FLT, INDEX_NONE, INDEX_NONE };
+
+			if (Level == 0)
+			{
+				// Rescan the tile
+				const FIntRect Rect = GetEntryRect(0, NX, NY, Width, Height);
+				for (int32 Y = Rect.Min.Y; Y <= Rect.Max.Y; Y++)
+				{
+					for (int32 X = Rect.Min.X; X <= Rect.Max.X; X++)
+					{
+						const float Value = Data[Indexer.ToIndex(X, Y)];
+						if (Best.X == INDEX_NONE || Value > Best.Max)
+						{
+							Best = { Value, X, Y };
+						}
+					}
+				}
+			}
+			else
+			{
+				// Combine the (up to) four children
+				const TArray<FGAGridMaxPyramid::FEntry>& Children = MaxPyramid.Levels[Level - 1];
+				const FIntPoint ChildSize = MaxPyramid.LevelSizes[Level - 1];
+				for (int32 CY = 2 * NY; CY <= FMath::Min(2 * NY + 1, ChildSize.Y - 1); CY++)
+				{
+					for (int32 CX = 2 * NX; CX <= FMath::Min(2 * NX + 1, ChildSize.X - 1); CX++)
+					{
+						const FGAGridMaxPyramid::FEntry& Child = Children[CY * ChildSize.X + CX];
+						if (Best.X == INDEX_NONE || IsBetterEntry(Child, Best))
+						{
+							Best = Child;
+						}
+					}
+				}
+			}
+
+			Entries[EntryIndex] = Best;
+
+			if (bHasParent)
+			{
+				MaxPyramid.Dirty[Level + 1][(NY / 2) * MaxPyramid.LevelSizes[Level + 1].X + (NX / 2)] = true;
+			}
+		}
+
+		LevelDirty.SetRange(0, LevelDirty.Num(), false);
+	}
+
+	MaxPyramid.bAnyDirty = false;
+}
+
+
+bool FGAGridMap::PyramidArgMax(const FGridBox& Box, FCellRef& CellOut, float& MaxValueOut) const
+{
+	if (!IsValid() || !Box.IsValid())
+	{
+		return false;
+	}
+
+	RefreshMaxPyramid();
+
+	const int32 Width = GridBounds.GetWidth();
+	const int32 Height = GridBounds.GetHeight();
+	const FIntRect Query(
+		FMath::Max(Box.MinX, GridBounds.MinX) - GridBounds.MinX,
+		FMath::Max(Box.MinY, GridBounds.MinY) - GridBounds.MinY,
+		FMath::Min(Box.MaxX, GridBounds.MaxX) - GridBounds.MinX,
+		FMath::Min(Box.MaxY, GridBounds.MaxY) - GridBounds.MinY);
+	if (Query.Min.X > Query.Max.X || Query.Min.Y > Query.Max.Y)
+	{
+		return false;
+	}
+
+	const FGridLayoutIndexer Indexer = GetIndexer();
+	FGAGridMaxPyramid::FEntry Best = { -UE_MAX_FLT, INDEX_NONE, INDEX_NONE };
+
+	// Depth first, from the top. Entries entirely inside the query answer for their whole subtree;
+	// entries that can't beat the best so far are pruned.
+	TArray<FPyramidNode, TInlineAllocator<64>> Stack;
+	const int32 TopLevel = MaxPyramid.Levels.Num() - 1;
+	Stack.Add({ MaxPyramid.Levels[TopLevel][0].Max, TopLevel, 0, 0 });
+
+	while (Stack.Num() > 0)
+	{
+		const FPyramidNode Node = Stack.Pop(EAllowShrinking::No);
+		if (Best.X != INDEX_NONE && Node.Max < Best.Max)
+		{
+			continue;
+		}
+
+		const FIntRect EntryRect = GetEntryRect(Node.Level, Node.X, Node.Y, Width, Height);
+		FIntRect Clipped;
+		if (!ClipRect(EntryRect, Query, Clipped))
+		{
+			continue;
+		}
+
+		const FIntPoint LevelSize = MaxPyramid.LevelSizes[Node.Level];
+		const FGAGridMaxPyramid::FEntry& Entry = MaxPyramid.Levels[Node.Level][Node.Y * LevelSize.X + Node.X];
+
+		if (Clipped == EntryRect)
+		{
+			if (Best.X == INDEX_NONE || IsBetterEntry(Entry, Best))
+			{
+				Best = Entry;
+			}
+		}
+		else if (Node.Level == 0)
+		{
+			for (int32 Y = Clipped.Min.Y; Y <= Clipped.Max.Y; Y++)
+			{
+				for (int32 X = Clipped.Min.X; X <= Clipped.Max.X; X++)
+				{
+					const FGAGridMaxPyramid::FEntry Cell = { Data[Indexer.ToIndex(X, Y)], X, Y };
+					if (Best.X == INDEX_NONE || IsBetterEntry(Cell, Best))
+					{
+						Best = Cell;
+					}
+				}
+			}
+		}
+		else
+		{
+			// Push the children so that the most promising one is popped first
+			const FIntPoint ChildSize = MaxPyramid.LevelSizes[Node.Level - 1];
+			const TArray<FGAGridMaxPyramid::FEntry>& Children = MaxPyramid.Levels[Node.Level - 1];
+			const int32 FirstChild = Stack.Num();
+			for (int32 CY = 2 * Node.Y; CY <= FMath::Min(2 * Node.Y + 1, ChildSize.Y - 1); CY++)
+			{
+				for (int32 CX = 2 * Node.X; CX <= FMath::Min(2 * Node.X + 1, ChildSize.X - 1); CX++)
+				{
+					Stack.Add({ Children[CY * ChildSize.X + CX].Max, Node.Level - 1, CX, CY });
+				}
+			}
+			Algo::Sort(MakeArrayView(Stack.GetData() + FirstChild, Stack.Num() - FirstChild),
+				[](const FPyramidNode& A, const FPyramidNode& B) { return A.Max < B.Max; });
+		}
+	}
+
+	if (Best.X == INDEX_NONE)
+	{
+		return false;
+	}
+
+	CellOut = FCellRef(Best.X + GridBounds.MinX, Best.Y + GridBounds.MinY);
+	MaxValueOut = Best.Max;
+	return true;
+}
+
+
+void FGAGridMap::GetTopK(const FGridBox& Box, int32 K, TArray<FCellRef>& CellsOut, TArray<float>& ValuesOut) const
+{
+	CellsOut.Reset();
+	ValuesOut.Reset();
+
+	if (K <= 0 || !IsValid() || !Box.IsValid())
+	{
+		return;
+	}
+
+	if (!HasMaxPyramid())
+	{
+		// No pyramid: one pass with a bounded min-heap
+		struct FCandidate
+		{
+			float Value;
+			int32 X;
+			int32 Y;
+			bool operator<(const FCandidate& Other) const { return Value < Other.Value; }
+		};
+
+		TArray<FCandidate> Heap;
+		Heap.Reserve(K + 1);
+		ForEachCell(Box, [&](int32 X, int32 Y, float Value)
+		{
+			if (Heap.Num() < K)
+			{
+				Heap.HeapPush({ Value, X, Y });
+			}
+			else if (Value > Heap.HeapTop().Value)
+			{
+				FCandidate Discarded;
+				Heap.HeapPop(Discarded, EAllowShrinking::No);
+				Heap.HeapPush({ Value, X, Y });
+			}
+		});
+
+		Heap.Sort([](const FCandidate& A, const FCandidate& B) { return A.Value > B.Value; });
+		for (const FCandidate& Candidate : Heap)
+		{
+			CellsOut.Add(FCellRef(Candidate.X, Candidate.Y));
+			ValuesOut.Add(Candidate.Value);
+		}
+		return;
+	}
+
+	RefreshMaxPyramid();
+
+	const int32 Width = GridBounds.GetWidth();
+	const int32 Height = GridBounds.GetHeight();
+	const FIntRect Query(
+		FMath::Max(Box.MinX, GridBounds.MinX) - GridBounds.MinX,
+		FMath::Max(Box.MinY, GridBounds.MinY) - GridBounds.MinY,
+		FMath::Min(Box.MaxX, GridBounds.MaxX) - GridBounds.MinX,
+		FMath::Min(Box.MaxY, GridBounds.MaxY) - GridBounds.MinY);
+	const FGridLayoutIndexer Indexer = GetIndexer();
+
+	// Best first. An entry's max is an upper bound on every cell below it (even when it only partly
+	// overlaps the query), so cells come off the heap in descending order.
+	TArray<FPyramidNode> Heap;
+	const int32 TopLevel = MaxPyramid.Levels.Num() - 1;
+	Heap.HeapPush({ MaxPyramid.Levels[TopLevel][0].Max, TopLevel, 0, 0 });
+
+	while (Heap.Num() > 0 && CellsOut.Num() < K)
+	{
+		FPyramidNode Node;
+		Heap.HeapPop(Node, EAllowShrinking::No);
+
+		if (Node.Level == INDEX_NONE)
+		{
+			CellsOut.Add(FCellRef(Node.X + GridBounds.MinX, Node.Y + GridBounds.MinY));
+			ValuesOut.Add(Node.Max);
+			continue;
+		}
+
+		FIntRect Clipped;
+		if (!ClipRect(GetEntryRect(Node.Level, Node.X, Node.Y, Width, Height), Query, Clipped))
+		{
+			continue;
+		}
+
+		if (Node.Level == 0)
+		{
+			for (int32 Y = Clipped.Min.Y; Y <= Clipped.Max.Y; Y++)
+			{
+				for (int32 X = Clipped.Min.X; X <= Clipped.Max.X; X++)
+				{
+					Heap.HeapPush({ Data[Indexer.ToIndex(X, Y)], INDEX_NONE, X, Y });
+				}
+			}
+		}
+		else
+		{
+			const FIntPoint ChildSize = MaxPyramid.LevelSizes[Node.Level - 1];
+			const TArray<FGAGridMaxPyramid::FEntry>& Children = MaxPyramid.Levels[Node.Level - 1];
+			for (int32 CY = 2 * Node.Y; CY <= FMath::Min(2 * Node.Y + 1, ChildSize.Y - 1); CY++)
+			{
+				for (int32 CX = 2 * Node.X; CX <= FMath::Min(2 * Node.X + 1, ChildSize.X - 1); CX++)
+				{
+					Heap.HeapPush({ Children[CY * ChildSize.X + CX].Max, Node.Level - 1, CX, CY });
+				}
+			}
+		}
+	}
+}
+
+
+void FGAGridMap::GetCellsAbove(const FGridBox& Box, float Threshold, TArray<FCellRef>& CellsOut) const
+{
+	CellsOut.Reset();
+
+	if (!IsValid() || !Box.IsValid())
+	{
+		return;
+	}
+
+	if (!HasMaxPyramid())
+	{
+		ForEachCell(Box, [&](int32 X, int32 Y, float Value)
+		{
+			if (Value >= Threshold)
+			{
+				CellsOut.Add(FCellRef(X, Y));
+			}
+		});
+		return;
+	}
+
+	RefreshMaxPyramid();
+
+	const int32 Width = GridBounds.GetWidth();
+	const int32 Height = GridBounds.GetHeight();
+	const FIntRect Query(
+		FMath::Max(Box.MinX, GridBounds.MinX) - GridBounds.MinX,
+		FMath::Max(Box.MinY, GridBounds.MinY) - GridBounds.MinY,
+		FMath::Min(Box.MaxX, GridBounds.MaxX) - GridBounds.MinX,
+		FMath::Min(Box.MaxY, GridBounds.MaxY) - GridBounds.MinY);
+	const FGridLayoutIndexer Indexer = GetIndexer();
+
+	// Only descend into entries whose max reaches the threshold
+	TArray<FPyramidNode, TInlineAllocator<64>> Stack;
+	const int32 TopLevel = MaxPyramid.Levels.Num() - 1;
+	Stack.Add({ MaxPyramid.Levels[TopLevel][0].Max, TopLevel, 0, 0 });
+
+	while (Stack.Num() > 0)
+	{
+		const FPyramidNode Node = Stack.Pop(EAllowShrinking::No);
+		if (Node.Max < Threshold)
+		{
+			continue;
+		}
+
+		FIntRect Clipped;
+		if (!ClipRect(GetEntryRect(Node.Level, Node.X, Node.Y, Width, Height), Query, Clipped))
+		{
+			continue;
+		}
+
+		if (Node.Level == 0)
+		{
+			for (int32 Y = Clipped.Min.Y; Y <= Clipped.Max.Y; Y++)
+			{
+				for (int32 X = Clipped.Min.X; X <= Clipped.Max.X; X++)
+				{
+					if (Data[Indexer.ToIndex(X, Y)] >= Threshold)
+					{
+						CellsOut.Add(FCellRef(X + GridBounds.MinX, Y + GridBounds.MinY));
+					}
+				}
+			}
+		}
+		else
+		{
+			const FIntPoint ChildSize = MaxPyramid.LevelSizes[Node.Level - 1];
+			const TArray<FGAGridMaxPyramid::FEntry>& Children = MaxPyramid.Levels[Node.Level - 1];
+			for (int32 CY = 2 * Node.Y; CY <= FMath::Min(2 * Node.Y + 1, ChildSize.Y - 1); CY++)
+			{
+				for (int32 CX = 2 * Node.X; CX <= FMath::Min(2 * Node.X + 1, ChildSize.X - 1); CX++)
+				{
+					Stack.Add({ Children[CY * ChildSize.X + CX].Max, Node.Level - 1, CX, CY });
+				}
+			}
+		}
+	}
+}
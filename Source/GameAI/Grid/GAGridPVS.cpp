@@ -0,0 +1,155 @@
+#include "GAGridActor.h"
+#include "GAGridVisibility.h"
+#include "Async/ParallelFor.h"
+
+// The potentially visible set of AGAGridActor (see GAGridActor.h)
+
+
+bool AGAGridActor::BakePVS()
+{
+	ClearPVS();
+
+	if (!bHasOccluderData || (Data.Num() != GetCellIndexCount()) || (XCount > MAX_uint16))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("AGAGridActor::BakePVS - no occluder data to bake from (run RefreshDataFromNav first)"));
+		return false;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+	const float Radius = PVSMaxDistance / CellScale;
+
+	// Every origin is independent, so bake one row of origins per task, each into its own buffers,
+	// then stitch them together in order
+	struct FRowResult
+	{
+		TArray<int32> RunCounts;		// per origin in the row
+		TArray<int32> RunStarts;
+		TArray<uint16> RunLengths;
+	};
+	TArray<FRowResult> RowResults;
+	RowResults.SetNum(YCount);
+
+	ParallelFor(YCount, [&](int32 OriginY)
+	{
+		FRowResult& Result = RowResults[OriginY];
+		Result.RunCounts.SetNumZeroed(XCount);
+
+		TBitArray<> Visible;
+
+		for (int32 OriginX = 0; OriginX < XCount; OriginX++)
+		{
+			FGAVisionCone Cone;
+			Cone.Init(OriginX, OriginY, FVector2f(1.0f, 0.0f), 360.0f, Radius, XCount, YCount);
+
+			// Row major, just over the cone's bounding box
+			const int32 BoxWidth = Cone.MaxX - Cone.MinX + 1;
+			Visible.Init(false, BoxWidth * (Cone.MaxY - Cone.MinY + 1));
+			FGAGridVisibility::ComputeFieldOfView(this, Cone, [&](int32 X, int32 Y)
+			{
+				Visible[(Y - Cone.MinY) * BoxWidth + (X - Cone.MinX)] = true;
+			});
+
+			// Run length encode
+			int32& RunCount = Result.RunCounts[OriginX];
+			for (int32 Y = Cone.MinY; Y <= Cone.MaxY; Y++)
+			{
+				const int32 RowOffset = (Y - Cone.MinY) * BoxWidth;
+				int32 X = Cone.MinX;
+				while (X <= Cone.MaxX)
+				{
+					if (!Visible[RowOffset + (X - Cone.MinX)])
+					{
+						X++;
+						continue;
+					}
+
+					const int32 RunStart = X;
+					while ((X <= Cone.MaxX) && Visible[RowOffset + (X - Cone.MinX)])
+					{
+						X++;
+					}
+
+					Result.RunStarts.Add(Y * XCount + RunStart);
+					Result.RunLengths.Add(uint16(X - RunStart));
+					RunCount++;
+				}
+			}
+		}
+	});
+
+	int32 TotalRuns = 0;
+	for (const FRowResult& Result : RowResults)
+	{
+		TotalRuns += Result.RunStarts.Num();
+	}
+
+	PVSOffsets.Reset(XCount * YCount + 1);
+	PVSRunStarts.Reset(TotalRuns);
+	PVSRunLengths.Reset(TotalRuns);
+
+	int32 RunOffset = 0;
+	for (const FRowResult& Result : RowResults)
+	{
+		for (int32 RunCount : Result.RunCounts)
+		{
+			PVSOffsets.Add(RunOffset);
+			RunOffset += RunCount;
+		}
+		PVSRunStarts.Append(Result.RunStarts);
+		PVSRunLengths.Append(Result.RunLengths);
+	}
+	PVSOffsets.Add(RunOffset);
+
+	PVSBakedRadius = Radius;
+	bHasPVSData = true;
+
+	UE_LOG(LogTemp, Log, TEXT("AGAGridActor::BakePVS - %d cells, %d runs (%.1f KB) in %.2fs"),
+		XCount * YCount, TotalRuns,
+		float(PVSOffsets.GetAllocatedSize() + PVSRunStarts.GetAllocatedSize() + PVSRunLengths.GetAllocatedSize()) / 1024.0f,
+		float(FPlatformTime::Seconds() - StartTime));
+
+	return true;
+}
+
+void AGAGridActor::ClearPVS()
+{
+	PVSOffsets.Empty();
+	PVSRunStarts.Empty();
+	PVSRunLengths.Empty();
+	PVSBakedRadius = 0.0f;
+	bHasPVSData = false;
+}
+
+
+int32 AGAGridActor::FindFirstPVSRun(int32 Origin, int32 RowMajorIndex) const
+{
+	// Runs don't overlap and are sorted, so their last cells are sorted too
+	int32 Lo = PVSOffsets[Origin];
+	int32 Hi = PVSOffsets[Origin + 1];
+	while (Lo < Hi)
+	{
+		const int32 Mid = (Lo + Hi) / 2;
+		if (PVSRunStarts[Mid] + int32(PVSRunLengths[Mid]) - 1 < RowMajorIndex)
+		{
+			Lo = Mid + 1;
+		}
+		else
+		{
+			Hi = Mid;
+		}
+	}
+	return Lo;
+}
+
+bool AGAGridActor::IsInPVS(const FCellRef& From, const FCellRef& To) const
+{
+	if (!bHasPVSData || !IsCellRefInBounds(From) || !IsCellRefInBounds(To))
+	{
+		return false;
+	}
+
+	const int32 Origin = From.Y * XCount + From.X;
+	const int32 Target = To.Y * XCount + To.X;
+	const int32 Run = FindFirstPVSRun(Origin, Target);
+	return (Run < PVSOffsets[Origin + 1]) && (PVSRunStarts[Run] <= Target);
+}
@@ -0,0 +1,345 @@
+#include "GAGridVisibility.h"
+#include "GAGridActor.h"
+
+
+bool FGAGridVisibility::HasLineOfSight(const AGAGridActor* Grid, const FCellRef& From, const FCellRef& To)
+{
+	const int32 DX = FMath::Abs(To.X - From.X);
+	const int32 DY = FMath::Abs(To.Y - From.Y);
+	const int32 StepX = (To.X > From.X) ? 1 : -1;
+	const int32 StepY = (To.Y > From.Y) ? 1 : -1;
+
+	// Error tracks which cell boundary the line crosses next, scaled by 2 so everything stays integer:
+	// positive -> the next vertical boundary (step in X), negative -> the next horizontal one (step in Y),
+	// zero -> both at once, i.e. the line goes through a corner
+	int32 Error = DX - DY;
+	int32 Remaining = DX + DY;
+	int32 X = From.X;
+	int32 Y = From.Y;
+
+	while (Remaining > 0)
+	{
+		if (Error > 0)
+		{
+			X += StepX;
+			Error -= 2 * DY;
+			Remaining--;
+		}
+		else if (Error < 0)
+		{
+			Y += StepY;
+			Error += 2 * DX;
+			Remaining--;
+		}
+		else
+		{
+			if (Grid->IsOccluder(X + StepX, Y) && Grid->IsOccluder(X, Y + StepY))
+			{
+				return false;
+			}
+
+			X += StepX;
+			Y += StepY;
+			Error += 2 * (DX - DY);
+			Remaining -= 2;
+		}
+
+		// Remaining == 0 means we've arrived at the destination cell
+		if ((Remaining > 0) && Grid->IsOccluder(X, Y))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+namespace
+{
+	// Floor and ceiling of A / B for B > 0, rounding correctly for negative A too
+	FORCEINLINE int32 FloorDiv(int32 A, int32 B)
+	{
+		return (A >= 0) ? (A / B) : -((-A + B - 1) / B);
+	}
+
+	FORCEINLINE int32 CeilDiv(int32 A, int32 B)
+	{
+		return -FloorDiv(-A, B);
+	}
+
+	// A slope as an exact fraction. The denominator is always positive
+	struct FSlope
+	{
+		int32 Num;
+		int32 Den;
+	};
+
+	// One row of a shadowcasting sweep: the cells at distance Depth from the origin (along the quadrant's axis),
+	// between the two bounding slopes
+	struct FShadowRow
+	{
+		int32 Depth;
+		FSlope Start;
+		FSlope End;
+
+		// First and last column in the row, rounding ties towards the middle of the row
+		int32 GetMinCol() const { return FloorDiv(2 * Depth * Start.Num + Start.Den, 2 * Start.Den); }
+		int32 GetMaxCol() const { return CeilDiv(2 * Depth * End.Num - End.Den, 2 * End.Den); }
+
+		// Is the center of the cell at Col inside the slopes? (for symmetry, cells on the edge only count if their center is)
+		bool IsSymmetric(int32 Col) const
+		{
+			return (Col * Start.Den >= Depth * Start.Num) && (Col * End.Den <= Depth * End.Num);
+		}
+	};
+
+	// Slope of the leading edge of a cell
+	FORCEINLINE FSlope GetCellSlope(int32 Depth, int32 Col)
+	{
+		return { 2 * Col - 1, 2 * Depth };
+	}
+
+	// The four shadowcasting quadrants, as the (X, Y) offset of one step along the row (Depth) and one step across it (Col)
+	struct FShadowQuadrant
+	{
+		FIntPoint DepthAxis;
+		FIntPoint ColAxis;
+
+		// Direction of DepthAxis, in degrees
+		float AxisAngle;
+
+		// +1 if increasing Col turns counterclockwise (increasing angle) from the axis, -1 if clockwise
+		float ColSign;
+	};
+
+	static const FShadowQuadrant ShadowQuadrants[4] = {
+		{ FIntPoint(0, -1), FIntPoint(1, 0), -90.0f, 1.0f },		// north
+		{ FIntPoint(1, 0), FIntPoint(0, 1), 0.0f, 1.0f },			// east
+		{ FIntPoint(0, 1), FIntPoint(1, 0), 90.0f, -1.0f },			// south
+		{ FIntPoint(-1, 0), FIntPoint(0, 1), 180.0f, -1.0f }		// west
+	};
+}
+
+
+// --------------------- FGAVisionCone ---------------------
+
+void FGAVisionCone::Init(int32 OriginXIn, int32 OriginYIn, const FVector2f& ForwardIn, float VisionAngle, float RadiusIn, int32 XCount, int32 YCount)
+{
+	OriginX = OriginXIn;
+	OriginY = OriginYIn;
+	Forward = ForwardIn;
+	Radius = FMath::Max(RadiusIn, 0.0f);
+
+	const float HalfAngle = FMath::Clamp(0.5f * VisionAngle, 0.0f, 180.0f);
+	const float ForwardAngle = FMath::RadiansToDegrees(FMath::Atan2(Forward.Y, Forward.X));
+	CosHalfAngle = FMath::Cos(FMath::DegreesToRadians(HalfAngle));
+
+	// Slice of each quadrant's +-45 degree wedge covered by the cone
+	// Cones wider than 180 degrees can overlap a wedge in two separate pieces, so those just get whole quadrants
+	// (the per-cell cone test still clips them exactly)
+	for (int32 Quadrant = 0; Quadrant < 4; Quadrant++)
+	{
+		if (HalfAngle > 90.0f)
+		{
+			QuadrantMinSlope[Quadrant] = -1.0f;
+			QuadrantMaxSlope[Quadrant] = 1.0f;
+			continue;
+		}
+
+		const FShadowQuadrant& Q = ShadowQuadrants[Quadrant];
+		const float Center = Q.ColSign * FMath::UnwindDegrees(ForwardAngle - Q.AxisAngle);
+		const float Lo = FMath::Max(Center - HalfAngle, -45.0f);
+		const float Hi = FMath::Min(Center + HalfAngle, 45.0f);
+		if (Lo <= Hi)
+		{
+			QuadrantMinSlope[Quadrant] = FMath::Tan(FMath::DegreesToRadians(Lo));
+			QuadrantMaxSlope[Quadrant] = FMath::Tan(FMath::DegreesToRadians(Hi));
+		}
+		else
+		{
+			QuadrantMinSlope[Quadrant] = 1.0f;
+			QuadrantMaxSlope[Quadrant] = -1.0f;
+		}
+	}
+
+	// Bounding box: the origin, the two ends of the arc, and wherever the arc crosses an axis
+	FVector2f BoxMin(0.0f, 0.0f);
+	FVector2f BoxMax(0.0f, 0.0f);
+	auto AddDirection = [&](float AngleDegrees)
+	{
+		FVector2f Point = Radius * FVector2f(FMath::Cos(FMath::DegreesToRadians(AngleDegrees)), FMath::Sin(FMath::DegreesToRadians(AngleDegrees)));
+		BoxMin = FVector2f::Min(BoxMin, Point);
+		BoxMax = FVector2f::Max(BoxMax, Point);
+	};
+
+	AddDirection(ForwardAngle - HalfAngle);
+	AddDirection(ForwardAngle + HalfAngle);
+	for (float AxisAngle : { 0.0f, 90.0f, 180.0f, -90.0f })
+	{
+		if (FMath::Abs(FMath::UnwindDegrees(AxisAngle - ForwardAngle)) <= HalfAngle)
+		{
+			AddDirection(AxisAngle);
+		}
+	}
+
+	MinX = FMath::Clamp(OriginX + FMath::FloorToInt32(BoxMin.X), 0, XCount - 1);
+	MinY = FMath::Clamp(OriginY + FMath::FloorToInt32(BoxMin.Y), 0, YCount - 1);
+	MaxX = FMath::Clamp(OriginX + FMath::CeilToInt32(BoxMax.X), 0, XCount - 1);
+	MaxY = FMath::Clamp(OriginY + FMath::CeilToInt32(BoxMax.Y), 0, YCount - 1);
+}
+
+
+// --------------------- FGAGridVisibility ---------------------
+
+namespace
+{
+	// The shadowcasting sweep itself. Calls RevealCell(int32 X, int32 Y) for every visible cell inside the cone
+	// (possibly more than once for cells on the boundary between quadrants)
+	template<typename FuncType>
+	void Shadowcast(const AGAGridActor* Grid, const FGAVisionCone& Cone, FuncType RevealCell)
+	{
+		if (!Cone.IsValid() || !Grid->IsCellRefInBounds(FCellRef(Cone.OriginX, Cone.OriginY)))
+		{
+			return;
+		}
+
+		const int32 MaxDepth = FMath::CeilToInt32(Cone.Radius);
+
+		auto Reveal = [&](int32 DX, int32 DY)
+		{
+			if (Cone.ContainsOffset(DX, DY))
+			{
+				RevealCell(Cone.OriginX + DX, Cone.OriginY + DY);
+			}
+		};
+
+		// You can always see where you're standing
+		RevealCell(Cone.OriginX, Cone.OriginY);
+
+		// Off the grid blocks sight, but isn't visible itself
+		auto IsBlocked = [&](int32 DX, int32 DY, bool& bInBoundsOut)
+		{
+			const int32 X = Cone.OriginX + DX;
+			const int32 Y = Cone.OriginY + DY;
+			bInBoundsOut = (X >= 0) && (X < Grid->XCount) && (Y >= 0) && (Y < Grid->YCount);
+			return !bInBoundsOut || Grid->IsOccluder(X, Y);
+		};
+
+		TArray<FShadowRow, TInlineAllocator<32>> Rows;
+
+		for (int32 Quadrant = 0; Quadrant < 4; Quadrant++)
+		{
+			if (!Cone.IsQuadrantInCone(Quadrant))
+			{
+				continue;
+			}
+
+			const FIntPoint DepthAxis = ShadowQuadrants[Quadrant].DepthAxis;
+			const FIntPoint ColAxis = ShadowQuadrants[Quadrant].ColAxis;
+			const float ConeMinSlope = Cone.QuadrantMinSlope[Quadrant];
+			const float ConeMaxSlope = Cone.QuadrantMaxSlope[Quadrant];
+
+			Rows.Reset();
+			Rows.Add({ 1, { -1, 1 }, { 1, 1 } });
+
+			while (Rows.Num() > 0)
+			{
+				FShadowRow Row = Rows.Pop(EAllowShrinking::No);
+				if (Row.Depth > MaxDepth)
+				{
+					continue;
+				}
+
+				// Only walk the part of the row inside the cone's sector, plus one cell either side.
+				// Occluders further out than that only ever shadow cells whose centers are outside the cone, so skipping
+				// them doesn't change what's visible inside it.
+				const int32 MinCol = FMath::Max(Row.GetMinCol(), FMath::FloorToInt32(Row.Depth * ConeMinSlope) - 1);
+				const int32 MaxCol = FMath::Min(Row.GetMaxCol(), FMath::CeilToInt32(Row.Depth * ConeMaxSlope) + 1);
+				if (MinCol > MaxCol)
+				{
+					// Slopes only ever narrow with depth, so nothing further down this branch is in the cone either
+					continue;
+				}
+
+				// 0 = no cell yet, 1 = open, 2 = blocked
+				int32 PrevState = 0;
+
+				for (int32 Col = MinCol; Col <= MaxCol; Col++)
+				{
+					const int32 DX = DepthAxis.X * Row.Depth + ColAxis.X * Col;
+					const int32 DY = DepthAxis.Y * Row.Depth + ColAxis.Y * Col;
+
+					bool bInBounds;
+					const bool bBlocked = IsBlocked(DX, DY, bInBounds);
+
+					if (bInBounds && (bBlocked || Row.IsSymmetric(Col)))
+					{
+						Reveal(DX, DY);
+					}
+
+					if (PrevState == 2 && !bBlocked)
+					{
+						// Coming out of a shadow: the rest of this row (and the next) starts here
+						Row.Start = GetCellSlope(Row.Depth, Col);
+					}
+					else if (PrevState == 1 && bBlocked)
+					{
+						// Going into a shadow: what we've seen so far in this row continues in the next one
+						FShadowRow Next = { Row.Depth + 1, Row.Start, GetCellSlope(Row.Depth, Col) };
+						Rows.Add(Next);
+					}
+
+					PrevState = bBlocked ? 2 : 1;
+				}
+
+				if (PrevState == 1)
+				{
+					Rows.Add({ Row.Depth + 1, Row.Start, Row.End });
+				}
+			}
+		}
+	}
+}
+
+
+void FGAGridVisibility::ComputeFieldOfView(const AGAGridActor* Grid, const FGAVisionCone& Cone, TBitArray<>& VisibleInOut)
+{
+	Shadowcast(Grid, Cone, [&](int32 X, int32 Y)
+	{
+		VisibleInOut[Grid->CellRefToIndex(FCellRef(X, Y))] = true;
+	});
+}
+
+void FGAGridVisibility::ComputeFieldOfView(const AGAGridActor* Grid, const FGAVisionCone& Cone, TFunctionRef<void(int32 X, int32 Y)> RevealCell)
+{
+	Shadowcast(Grid, Cone, RevealCell);
+}
+
+void FGAGridVisibility::ComputeConeVisibility(const AGAGridActor* Grid, const FGAVisionCone& Cone, TBitArray<>& VisibleInOut)
+{
+	if (!Cone.IsValid())
+	{
+		return;
+	}
+
+	if (Grid->HasPVS() && (Cone.Radius <= Grid->GetPVSRadius()))
+	{
+		// Everything visible from here has been baked already: just clip it to the cone
+		FCellRef Origin(Cone.OriginX, Cone.OriginY);
+		Grid->ForEachPVSRun(Origin, Cone.MinY, Cone.MaxY, [&](int32 Y, int32 MinX, int32 MaxX)
+		{
+			for (int32 X = FMath::Max(MinX, Cone.MinX); X <= FMath::Min(MaxX, Cone.MaxX); X++)
+			{
+				if (Cone.ContainsOffset(X - Cone.OriginX, Y - Cone.OriginY))
+				{
+					VisibleInOut[Grid->CellRefToIndex(FCellRef(X, Y))] = true;
+				}
+			}
+		});
+	}
+	else
+	{
+		ComputeFieldOfView(Grid, Cone, VisibleInOut);
+	}
+}
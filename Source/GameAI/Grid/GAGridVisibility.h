@@ -0,0 +1,100 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+class AGAGridActor;
+struct FCellRef;
+
+
+// A perceiver's view cone, in the grid's cell space
+// The perceiver is taken to stand at the center of OriginX, OriginY. Distances are in cells.
+// Init() precomputes the cone's cell-space bounding box and the slice of each shadowcasting quadrant it covers,
+// so that visibility passes only ever walk the cells of the cone's sector.
+struct FGAVisionCone
+{
+	FGAVisionCone() : OriginX(INDEX_NONE), OriginY(INDEX_NONE), Forward(1.0f, 0.0f), CosHalfAngle(-1.0f), Radius(0.0f),
+		MinX(INDEX_NONE), MinY(INDEX_NONE), MaxX(INDEX_NONE), MaxY(INDEX_NONE)
+	{
+		for (int32 Quadrant = 0; Quadrant < 4; Quadrant++)
+		{
+			QuadrantMinSlope[Quadrant] = -1.0f;
+			QuadrantMaxSlope[Quadrant] = 1.0f;
+		}
+	}
+
+	// VisionAngle is the full angle of the cone, in degrees. XCount, YCount are the grid's dimensions (for clipping)
+	void Init(int32 OriginXIn, int32 OriginYIn, const FVector2f& ForwardIn, float VisionAngle, float RadiusIn, int32 XCount, int32 YCount);
+
+	int32 OriginX;
+	int32 OriginY;
+
+	// Facing direction (unit length)
+	FVector2f Forward;
+
+	// Cosine of half the vision angle
+	float CosHalfAngle;
+
+	float Radius;
+
+	// Bounding box of the cone (inclusive, in cells), clipped to the grid
+	int32 MinX;
+	int32 MinY;
+	int32 MaxX;
+	int32 MaxY;
+
+	// For each shadowcasting quadrant (see FGAGridVisibility::ComputeFieldOfView), the range of Col / Depth slopes
+	// inside the cone. A quadrant the cone misses entirely has MinSlope > MaxSlope
+	float QuadrantMinSlope[4];
+	float QuadrantMaxSlope[4];
+
+	bool IsValid() const { return (OriginX >= 0) && (OriginY >= 0); }
+
+	bool IsQuadrantInCone(int32 Quadrant) const { return QuadrantMinSlope[Quadrant] <= QuadrantMaxSlope[Quadrant]; }
+
+	// Is the center of the cell at offset (DX, DY) from the origin inside the cone?
+	FORCEINLINE bool ContainsOffset(int32 DX, int32 DY) const
+	{
+		const float DistSquared = float(DX * DX + DY * DY);
+		if (DistSquared > Radius * Radius)
+		{
+			return false;
+		}
+
+		// Dot(Forward, D / |D|) >= CosHalfAngle, without the square root
+		const float Dot = Forward.X * float(DX) + Forward.Y * float(DY);
+		return (Dot * FMath::Abs(Dot)) >= (CosHalfAngle * FMath::Abs(CosHalfAngle) * DistSquared);
+	}
+};
+
+
+// Cell-to-cell visibility over the grid's baked occluders (ECellData::CellDataOccluder)
+// These never touch the physics scene, so they're cheap enough to run for thousands of cells per frame.
+// The grid is 2D: anything flagged as an occluder blocks sight completely, anything else doesn't block it at all.
+
+struct FGAGridVisibility
+{
+	// Is there an unobstructed line between the centers of the two cells?
+	// Walks every cell the line passes through with an integer DDA. The end cells themselves never block (you can see
+	// the face of a wall). Where the line passes exactly through a cell corner, it's only blocked if both cells on
+	// either side of the corner are occluders.
+	// Both cells must be in bounds.
+	static bool HasLineOfSight(const AGAGridActor* Grid, const FCellRef& From, const FCellRef& To);
+
+	// Field of view of a whole cone in one pass, using symmetric shadowcasting: each quadrant around the origin is
+	// swept row by row, and occluders narrow the range of slopes that later rows can see through.
+	// Visible cells (occluders included -- you see their faces) get their bit set in VisibleInOut, which is indexed
+	// by AGAGridActor::CellRefToIndex and must be GetCellIndexCount() long. Bits are only ever set, never cleared,
+	// so several cones can be accumulated into the same array.
+	// Only the rows and columns of the cone's sector are swept (quadrants it misses are skipped outright), so the
+	// cost is proportional to the visible part of the cone rather than to the map.
+	// Symmetric: if cell B comes out visible from A, then A comes out visible from B (cones aside).
+	static void ComputeFieldOfView(const AGAGridActor* Grid, const FGAVisionCone& Cone, TBitArray<>& VisibleInOut);
+
+	// Same, but calls RevealCell(X, Y) for each visible cell instead (cells can be reported more than once)
+	static void ComputeFieldOfView(const AGAGridActor* Grid, const FGAVisionCone& Cone, TFunctionRef<void(int32 X, int32 Y)> RevealCell);
+
+	// Everything visible in the cone, by the cheapest means available: the grid's baked PVS if it reaches as far as
+	// the cone does, else ComputeFieldOfView. Same output convention as ComputeFieldOfView.
+	// Only reads the grid, so it's safe to run for several cones at once on worker threads
+	static void ComputeConeVisibility(const AGAGridActor* Grid, const FGAVisionCone& Cone, TBitArray<>& VisibleInOut);
+};
@@ -0,0 +1,209 @@
+#include "GASparseGridMap.h"
+#include "GAGridActor.h"
+
+
+FGASparseGridMap::FGASparseGridMap() : XCount(INDEX_NONE), YCount(INDEX_NONE), GridBounds(), DefaultValue(0.0f), TilesX(0), TilesY(0)
+{
+	// we are empty
+}
+
+FGASparseGridMap::FGASparseGridMap(const AGAGridActor* Grid, float DefaultValueIn) : TilesX(0), TilesY(0)
+{
+	XCount = Grid->XCount;
+	YCount = Grid->YCount;
+	GridBounds = FGridBox(0, XCount - 1, 0, YCount - 1);
+
+	ResetData(DefaultValueIn);
+}
+
+FGASparseGridMap::FGASparseGridMap(const AGAGridActor* Grid, const FGridBox& GridBoxIn, float DefaultValueIn) : TilesX(0), TilesY(0)
+{
+	XCount = Grid->XCount;
+	YCount = Grid->YCount;
+	GridBounds = GridBoxIn;
+
+	ResetData(DefaultValueIn);
+}
+
+void FGASparseGridMap::ResetData(float DefaultValueIn)
+{
+	DefaultValue = DefaultValueIn;
+
+	const int32 NewTilesX = GridBounds.IsValid() ? (GridBounds.GetWidth() + TileDim - 1) >> TileShift : 0;
+	const int32 NewTilesY = GridBounds.IsValid() ? (GridBounds.GetHeight() + TileDim - 1) >> TileShift : 0;
+
+	if ((NewTilesX == TilesX) && (NewTilesY == TilesY) && (TileSlots.Num() == TilesX * TilesY))
+	{
+		// Same tiling: only the allocated tiles need unhooking, so a reset costs what the map held rather than the
+		// size of the world
+		for (int32 TileIndex : AllocatedTiles)
+		{
+			TileSlots[TileIndex] = INDEX_NONE;
+		}
+	}
+	else
+	{
+		TilesX = NewTilesX;
+		TilesY = NewTilesY;
+		TileSlots.Init(INDEX_NONE, TilesX * TilesY);
+	}
+
+	// Reset (rather than Empty) so that re-using a map from tick to tick doesn't hit the allocator
+	AllocatedTiles.Reset();
+	TileData.Reset();
+}
+
+
+bool FGASparseGridMap::CellRefToTile(const FCellRef& Cell, int32& TileIndexOut, int32& OffsetOut) const
+{
+	if (IsValid() && GridBounds.IsValidCell(Cell))
+	{
+		int32 X = Cell.X - GridBounds.MinX;
+		int32 Y = Cell.Y - GridBounds.MinY;
+		TileIndexOut = (Y >> TileShift) * TilesX + (X >> TileShift);
+		OffsetOut = ((Y & (TileDim - 1)) << TileShift) + (X & (TileDim - 1));
+		return true;
+	}
+	return false;
+}
+
+bool FGASparseGridMap::GetValue(const FCellRef& Cell, float& ValueOut) const
+{
+	int32 TileIndex, Offset;
+	if (CellRefToTile(Cell, TileIndex, Offset))
+	{
+		const float* Values = FindTile(TileIndex);
+		ValueOut = Values ? Values[Offset] : DefaultValue;
+		return true;
+	}
+	return false;
+}
+
+bool FGASparseGridMap::SetValue(const FCellRef& Cell, float Value)
+{
+	int32 TileIndex, Offset;
+	if (CellRefToTile(Cell, TileIndex, Offset))
+	{
+		float* Values = FindTile(TileIndex);
+		if (!Values)
+		{
+			if (Value == DefaultValue)
+			{
+				// Nothing to do, the cell already reads as the default
+				return true;
+			}
+
+			// Allocate on write
+			Values = FindOrAddTile(TileIndex);
+		}
+
+		Values[Offset] = Value;
+		return true;
+	}
+	return false;
+}
+
+float* FGASparseGridMap::FindOrAddTile(int32 TileIndex)
+{
+	int32 Slot = TileSlots[TileIndex];
+	if (Slot == INDEX_NONE)
+	{
+		Slot = AllocatedTiles.Add(TileIndex);
+		TileSlots[TileIndex] = Slot;
+		TileData.AddUninitialized(TileCellCount);
+		float* Values = &TileData[Slot * TileCellCount];
+		for (int32 Index = 0; Index < TileCellCount; Index++)
+		{
+			Values[Index] = DefaultValue;
+		}
+	}
+	return &TileData[Slot * TileCellCount];
+}
+
+
+bool FGASparseGridMap::GetMaxValue(float& MaxValueOut, float IgnoreThreshold) const
+{
+	if (IsValid())
+	{
+		MaxValueOut = -UE_MAX_FLT;
+
+		// Any unallocated tile means at least one cell holds the default
+		if ((AllocatedTiles.Num() < TileSlots.Num()) && (DefaultValue <= IgnoreThreshold))
+		{
+			MaxValueOut = DefaultValue;
+		}
+
+		ForEachAllocatedCell([&](int32 X, int32 Y, float Value)
+		{
+			if (Value <= IgnoreThreshold)
+			{
+				MaxValueOut = FMath::Max(MaxValueOut, Value);
+			}
+		});
+		return true;
+	}
+	return false;
+}
+
+bool FGASparseGridMap::ArgMax(FCellRef& CellOut, float& MaxValueOut) const
+{
+	bool bFound = false;
+	ForEachAllocatedCell([&](int32 X, int32 Y, float Value)
+	{
+		if (!bFound || (Value > MaxValueOut))
+		{
+			CellOut = FCellRef(X, Y);
+			MaxValueOut = Value;
+			bFound = true;
+		}
+	});
+	return bFound;
+}
+
+float FGASparseGridMap::Sum() const
+{
+	// (Cells outside GridBounds hold the default, and are left out along with the rest of the padding)
+	float Total = 0.0f;
+	ForEachAllocatedCell([&](int32 X, int32 Y, float Value)
+	{
+		Total += Value;
+	});
+	return Total;
+}
+
+void FGASparseGridMap::Scale(float Factor)
+{
+	for (float& Value : TileData)
+	{
+		Value *= Factor;
+	}
+}
+
+FGridBox FGASparseGridMap::GetAllocatedBounds() const
+{
+	FGridBox Bounds;
+	ForEachAllocatedTile([&](int32 TileIndex, const float* Values)
+	{
+		int32 TileMinX, TileMinY;
+		GetTileOrigin(TileIndex, TileMinX, TileMinY);
+		Bounds = Bounds.GetUnion(FGridBox(TileMinX, FMath::Min(TileMinX + TileDim - 1, GridBounds.MaxX),
+			TileMinY, FMath::Min(TileMinY + TileDim - 1, GridBounds.MaxY)));
+	});
+	return Bounds;
+}
+
+void FGASparseGridMap::Densify(FGAGridMap& MapOut) const
+{
+	MapOut.XCount = XCount;
+	MapOut.YCount = YCount;
+	MapOut.GridBounds = GridBounds;
+	MapOut.ResetData(DefaultValue);
+
+	if (MapOut.IsValid())
+	{
+		ForEachAllocatedCell([&](int32 X, int32 Y, float Value)
+		{
+			MapOut.Data[MapOut.CellRefToIndexUnchecked(X, Y)] = Value;
+		});
+	}
+}
@@ -0,0 +1,190 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GAGridMap.h"
+
+
+// A sparse counterpart to FGAGridMap, for maps where almost every cell holds the same default value
+// (probability maps right after a sighting, scratch maps...)
+// The map is cut into fixed-size square tiles. A tile is only allocated the first time a non-default value
+// is written into it; reads from unallocated tiles return the default value.
+// Memory and iteration therefore scale with the number of touched tiles rather than with the size of the world.
+// Use Densify() if you need an FGAGridMap (e.g. for debug rendering)
+
+class AGAGridActor;
+struct FCellRef;
+
+struct FGASparseGridMap
+{
+	// 16x16 tiles
+	static constexpr int32 TileShift = 4;
+	static constexpr int32 TileDim = 1 << TileShift;
+	static constexpr int32 TileCellCount = TileDim * TileDim;
+
+	FGASparseGridMap();
+	FGASparseGridMap(const AGAGridActor* Grid, float DefaultValueIn);
+	FGASparseGridMap(const AGAGridActor* Grid, const FGridBox& GridBoxIn, float DefaultValueIn);
+
+	// Sets every cell back to the default value. Tile memory is kept around for reuse
+	void ResetData(float DefaultValueIn);
+
+	// The XCount of the GridActor I'm built on
+	int32 XCount;
+
+	// The YCount of the GridActor I'm built on
+	int32 YCount;
+
+	// The bounds over which I am defined
+	FGridBox GridBounds;
+
+	// The value of every cell that has never been written to
+	float DefaultValue;
+
+
+	bool IsValid() const { return GridBounds.IsValid() && (TileSlots.Num() == TilesX * TilesY); }
+
+	// Same bounds, so the same tile index refers to the same cells in both
+	bool IsTileCompatible(const FGASparseGridMap& Other) const { return GridBounds == Other.GridBounds; }
+
+	bool GetValue(const FCellRef& Cell, float& ValueOut) const;
+
+	// Writing the default value into an unallocated tile is a no-op; anything else allocates the tile
+	bool SetValue(const FCellRef& Cell, float Value);
+
+	// Max over the whole map, i.e. including the default value if any part of the map is unallocated
+	bool GetMaxValue(float& MaxValueOut, float IgnoreThreshold = FLT_MAX) const;
+
+	// The allocated cell with the highest value. Ties go to the first such cell in allocation order
+	bool ArgMax(FCellRef& CellOut, float& MaxValueOut) const;
+
+	// Sum over the allocated cells
+	float Sum() const;
+
+	// Multiply every allocated cell by Factor
+	void Scale(float Factor);
+
+	// Smallest box (clipped to my bounds) covering every allocated tile. Invalid if nothing is allocated
+	FGridBox GetAllocatedBounds() const;
+
+	// Copy into a dense map with the same bounds
+	void Densify(FGAGridMap& MapOut) const;
+
+	int32 GetAllocatedTileCount() const { return AllocatedTiles.Num(); }
+
+	// Bytes currently in use for cell values
+	SIZE_T GetAllocatedSize() const { return TileData.GetAllocatedSize() + TileSlots.GetAllocatedSize(); }
+
+
+	// Tiles ------------------------
+	// Tiles are numbered row major, TilesX to a row. Within a tile, values are row major too (TileDim floats a row).
+	// Cells of the last row / column of tiles that lie outside GridBounds are never handed out by the cell iterators,
+	// and should be left at the default value.
+
+	int32 GetTilesX() const { return TilesX; }
+	int32 GetTilesY() const { return TilesY; }
+
+	// The tile's values, or nullptr if it's unallocated
+	FORCEINLINE const float* FindTile(int32 TileIndex) const
+	{
+		const int32 Slot = TileSlots[TileIndex];
+		return (Slot == INDEX_NONE) ? nullptr : &TileData[Slot * TileCellCount];
+	}
+
+	FORCEINLINE float* FindTile(int32 TileIndex)
+	{
+		const int32 Slot = TileSlots[TileIndex];
+		return (Slot == INDEX_NONE) ? nullptr : &TileData[Slot * TileCellCount];
+	}
+
+	// The tile's values, allocating it (filled with the default value) if need be
+	float* FindOrAddTile(int32 TileIndex);
+
+	// Grid coordinates of the tile's first cell
+	FORCEINLINE void GetTileOrigin(int32 TileIndex, int32& CellXOut, int32& CellYOut) const
+	{
+		CellXOut = GridBounds.MinX + ((TileIndex % TilesX) << TileShift);
+		CellYOut = GridBounds.MinY + ((TileIndex / TilesX) << TileShift);
+	}
+
+	// Calls Func(int32 TileIndex, const float* Values) for every allocated tile, in allocation order
+	template<typename FuncType>
+	void ForEachAllocatedTile(FuncType Func) const
+	{
+		for (int32 Slot = 0; Slot < AllocatedTiles.Num(); Slot++)
+		{
+			Func(AllocatedTiles[Slot], &TileData[Slot * TileCellCount]);
+		}
+	}
+
+	// Mutable version: Func(int32 TileIndex, float* Values)
+	template<typename FuncType>
+	void ForEachAllocatedTile(FuncType Func)
+	{
+		for (int32 Slot = 0; Slot < AllocatedTiles.Num(); Slot++)
+		{
+			Func(AllocatedTiles[Slot], &TileData[Slot * TileCellCount]);
+		}
+	}
+
+	// Calls Func(int32 CellX, int32 CellY, float Value) for every cell of every allocated tile
+	// (including cells in those tiles that still hold the default value), in allocation order.
+	// Cells in unallocated tiles are skipped -- they all hold DefaultValue.
+	template<typename FuncType>
+	void ForEachAllocatedCell(FuncType Func) const
+	{
+		ForEachAllocatedTile([&](int32 TileIndex, const float* Values)
+		{
+			int32 TileMinX, TileMinY;
+			GetTileOrigin(TileIndex, TileMinX, TileMinY);
+			const int32 TileMaxX = FMath::Min(TileMinX + TileDim - 1, GridBounds.MaxX);
+			const int32 TileMaxY = FMath::Min(TileMinY + TileDim - 1, GridBounds.MaxY);
+
+			for (int32 Y = TileMinY; Y <= TileMaxY; Y++)
+			{
+				const float* Row = Values + ((Y - TileMinY) << TileShift);
+				for (int32 X = TileMinX; X <= TileMaxX; X++)
+				{
+					Func(X, Y, Row[X - TileMinX]);
+				}
+			}
+		});
+	}
+
+	// Mutable version: Func(int32 CellX, int32 CellY, float& Value)
+	template<typename FuncType>
+	void ForEachAllocatedCell(FuncType Func)
+	{
+		ForEachAllocatedTile([&](int32 TileIndex, float* Values)
+		{
+			int32 TileMinX, TileMinY;
+			GetTileOrigin(TileIndex, TileMinX, TileMinY);
+			const int32 TileMaxX = FMath::Min(TileMinX + TileDim - 1, GridBounds.MaxX);
+			const int32 TileMaxY = FMath::Min(TileMinY + TileDim - 1, GridBounds.MaxY);
+
+			for (int32 Y = TileMinY; Y <= TileMaxY; Y++)
+			{
+				float* Row = Values + ((Y - TileMinY) << TileShift);
+				for (int32 X = TileMinX; X <= TileMaxX; X++)
+				{
+					Func(X, Y, Row[X - TileMinX]);
+				}
+			}
+		});
+	}
+
+protected:
+	bool CellRefToTile(const FCellRef& Cell, int32& TileIndexOut, int32& OffsetOut) const;
+
+	// Number of tiles along X and Y
+	int32 TilesX;
+	int32 TilesY;
+
+	// For each tile, the slot of its values in TileData, or INDEX_NONE if the tile is unallocated
+	TArray<int32> TileSlots;
+
+	// Tile index of each allocated slot
+	TArray<int32> AllocatedTiles;
+
+	// TileCellCount values per allocated slot
+	TArray<float> TileData;
+};
@@ -0,0 +1,139 @@
+#include "GAAwarenessTable.h"
+#include "Math/VectorRegister.h"
+
+
+void FGAAwarenessTable::Reserve(int32 PerceiverSlots, int32 TargetSlots)
+{
+	if ((PerceiverSlots <= PerceiverCapacity) && (TargetSlots <= TargetCapacity))
+	{
+		return;
+	}
+
+	// Grow geometrically, so registering one at a time doesn't re-lay the table out every time
+	const int32 NewPerceiverCapacity = (PerceiverSlots > PerceiverCapacity) ?
+		Align(FMath::Max(PerceiverSlots, PerceiverCapacity * 2), 4) : PerceiverCapacity;
+	const int32 NewTargetCapacity = (TargetSlots > TargetCapacity) ? FMath::Max(TargetSlots, TargetCapacity * 2) : TargetCapacity;
+
+	// Columns keep their contents, they just get longer
+	auto Relay = [&](auto& Column, auto EmptyValue)
+	{
+		using FElement = typename TRemoveReference<decltype(Column)>::Type::ElementType;
+		TArray<FElement> NewColumn;
+		NewColumn.Init(EmptyValue, NewPerceiverCapacity * NewTargetCapacity);
+		const int32 OldColumns = (PerceiverCapacity > 0) ? TargetCapacity : 0;
+		for (int32 TargetSlot = 0; TargetSlot < OldColumns; TargetSlot++)
+		{
+			FMemory::Memcpy(&NewColumn[TargetSlot * NewPerceiverCapacity], &Column[TargetSlot * PerceiverCapacity], PerceiverCapacity * sizeof(FElement));
+		}
+		Column = MoveTemp(NewColumn);
+	};
+
+	Relay(Awareness, 0.0f);
+	Relay(LastUpdateTime, -1.0f);
+	Relay(ClearLos, uint8(0));
+	Relay(TraceInFlight, uint8(0));
+	Relay(LosTraceStart, FVector3f::ZeroVector);
+	Relay(LosTraceEnd, FVector3f::ZeroVector);
+	Relay(LosTraceTime, -1.0f);
+	Relay(LosTraceClear, uint8(0));
+
+	PerceiverCapacity = NewPerceiverCapacity;
+	TargetCapacity = NewTargetCapacity;
+}
+
+
+void FGAAwarenessTable::ClearEntry(int32 Index)
+{
+	Awareness[Index] = 0.0f;
+	LastUpdateTime[Index] = -1.0f;
+	ClearLos[Index] = 0;
+	TraceInFlight[Index] = 0;
+	LosTraceTime[Index] = -1.0f;
+	LosTraceClear[Index] = 0;
+}
+
+void FGAAwarenessTable::ClearPerceiver(int32 PerceiverSlot)
+{
+	for (int32 TargetSlot = 0; TargetSlot < TargetCapacity; TargetSlot++)
+	{
+		ClearEntry(GetIndex(PerceiverSlot, TargetSlot));
+	}
+}
+
+void FGAAwarenessTable::ClearTarget(int32 TargetSlot)
+{
+	const int32 Start = GetIndex(0, TargetSlot);
+	for (int32 Index = Start; Index < Start + PerceiverCapacity; Index++)
+	{
+		ClearEntry(Index);
+	}
+}
+
+
+void FGAAwarenessTable::Integrate(int32 Index, bool bHasLos, float Now, float FirstDeltaTime, float IncreaseRate, float DecayRate)
+{
+	const float DeltaTime = HasEntry(Index) ? FMath::Max(Now - LastUpdateTime[Index], 0.0f) : FirstDeltaTime;
+	LastUpdateTime[Index] = Now;
+	ClearLos[Index] = bHasLos ? 1 : 0;
+
+	const float Rate = bHasLos ? IncreaseRate : -DecayRate;
+	Awareness[Index] = FMath::Clamp(Awareness[Index] + Rate * DeltaTime, 0.0f, 1.0f);
+}
+
+
+float FGAAwarenessTable::GetMaxAwareness(int32 TargetSlot) const
+{
+	if ((TargetSlot < 0) || (TargetSlot >= TargetCapacity) || (PerceiverCapacity == 0))
+	{
+		return 0.0f;
+	}
+
+	// Empty slots hold 0, so the whole (4-aligned) column can be reduced without any masking
+	const float* Column = Awareness.GetData() + GetIndex(0, TargetSlot);
+	VectorRegister4Float Max = VectorLoad(Column);
+	for (int32 Index = 4; Index < PerceiverCapacity; Index += 4)
+	{
+		Max = VectorMax(Max, VectorLoad(Column + Index));
+	}
+
+	float Lanes[4];
+	VectorStore(Max, Lanes);
+	return FMath::Max(FMath::Max(Lanes[0], Lanes[1]), FMath::Max(Lanes[2], Lanes[3]));
+}
+
+
+bool FGAAwarenessTable::FindCachedLos(int32 Index, const FVector& TraceStart, const FVector& TraceEnd, float Now, float MoveThreshold, float MaxAge, bool& bClearOut) const
+{
+	const float Time = LosTraceTime[Index];
+	if ((Time < 0.0f) || (Now - Time > MaxAge))
+	{
+		return false;
+	}
+
+	const float ThresholdSquared = MoveThreshold * MoveThreshold;
+	if ((FVector3f::DistSquared(LosTraceStart[Index], FVector3f(TraceStart)) > ThresholdSquared) ||
+		(FVector3f::DistSquared(LosTraceEnd[Index], FVector3f(TraceEnd)) > ThresholdSquared))
+	{
+		return false;
+	}
+
+	bClearOut = LosTraceClear[Index] != 0;
+	return true;
+}
+
+void FGAAwarenessTable::AddAwareness(int32 Index, float Amount, float Cap, float Now)
+{
+	if (!HasEntry(Index))
+	{
+		LastUpdateTime[Index] = Now;
+	}
+	Awareness[Index] = FMath::Max(Awareness[Index], FMath::Min(Awareness[Index] + Amount, Cap));
+}
+
+void FGAAwarenessTable::StoreLos(int32 Index, const FVector& TraceStart, const FVector& TraceEnd, float Time, bool bClear)
+{
+	LosTraceStart[Index] = FVector3f(TraceStart);
+	LosTraceEnd[Index] = FVector3f(TraceEnd);
+	LosTraceTime[Index] = Time;
+	LosTraceClear[Index] = bClear ? 1 : 0;
+}
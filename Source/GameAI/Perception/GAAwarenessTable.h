@@ -0,0 +1,72 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+
+// Every perceiver's awareness of every target, as a dense matrix (owned by UGAPerceptionSystem)
+// Perceivers and targets are given small slot indices when they register with the perception system, and each
+// (perceiver, target) pair lives at GetIndex(PerceiverSlot, TargetSlot) in a set of parallel arrays.
+// The arrays are target-major: all the perceivers' entries for one target are consecutive, so "how aware is anyone of
+// this target?" (asked by every target every frame) is a SIMD max down one contiguous column.
+// Slots are recycled, so clear a slot's entries when it's given out again.
+
+struct FGAAwarenessTable
+{
+	FGAAwarenessTable() : PerceiverCapacity(0), TargetCapacity(0) {}
+
+	// Make room for at least this many slots of each. Existing entries keep their slots
+	void Reserve(int32 PerceiverSlots, int32 TargetSlots);
+
+	// Reset every entry in the perceiver's row / the target's column
+	void ClearPerceiver(int32 PerceiverSlot);
+	void ClearTarget(int32 TargetSlot);
+
+	FORCEINLINE bool IsValidPair(int32 PerceiverSlot, int32 TargetSlot) const
+	{
+		return (PerceiverSlot >= 0) && (PerceiverSlot < PerceiverCapacity) && (TargetSlot >= 0) && (TargetSlot < TargetCapacity);
+	}
+
+	FORCEINLINE int32 GetIndex(int32 PerceiverSlot, int32 TargetSlot) const
+	{
+		return TargetSlot * PerceiverCapacity + PerceiverSlot;
+	}
+
+	// Has the pair at Index been updated at all?
+	FORCEINLINE bool HasEntry(int32 Index) const { return LastUpdateTime[Index] >= 0.0f; }
+
+	// Record a LOS result for the pair at Index, and integrate its awareness over the time since its last update
+	// (or over FirstDeltaTime, if it's never been updated). Awareness stays within [0, 1]
+	void Integrate(int32 Index, bool bHasLos, float Now, float FirstDeltaTime, float IncreaseRate, float DecayRate);
+
+	// Highest awareness any perceiver has of the target
+	float GetMaxAwareness(int32 TargetSlot) const;
+
+	// The pair's last LOS trace, if it was made no more than MaxAge ago between endpoints each within MoveThreshold of
+	// TraceStart / TraceEnd. bClearOut gets its result
+	bool FindCachedLos(int32 Index, const FVector& TraceStart, const FVector& TraceEnd, float Now, float MoveThreshold, float MaxAge, bool& bClearOut) const;
+
+	void StoreLos(int32 Index, const FVector& TraceStart, const FVector& TraceEnd, float Time, bool bClear);
+
+	// Raise the pair's awareness by Amount, but not past Cap (and never lower it). A pair that's never been updated is
+	// treated as updated at Now
+	void AddAwareness(int32 Index, float Amount, float Cap, float Now);
+
+	// Slots allocated in each dimension. PerceiverCapacity is kept a multiple of 4, for the column reductions
+	int32 PerceiverCapacity;
+	int32 TargetCapacity;
+
+	// Per pair
+	TArray<float> Awareness;
+	TArray<float> LastUpdateTime;		// world time, negative if never updated
+	TArray<uint8> ClearLos;
+	TArray<uint8> TraceInFlight;		// an async trace is queued for the pair (or it's sharing a squadmate's)
+
+	// Per pair LOS cache: the endpoints, time and result of the last trace
+	TArray<FVector3f> LosTraceStart;
+	TArray<FVector3f> LosTraceEnd;
+	TArray<float> LosTraceTime;			// world time, negative if nothing's cached
+	TArray<uint8> LosTraceClear;
+
+protected:
+	void ClearEntry(int32 Index);
+};
@@ -0,0 +1,65 @@
+#include "GAConeTestBatch.h"
+#include "Math/VectorRegister.h"
+
+
+void FGAConeTestBatch::Reset(const FVector& OriginIn)
+{
+	Origin = OriginIn;
+	X.Reset();
+	Y.Reset();
+	Z.Reset();
+	Count = 0;
+}
+
+void FGAConeTestBatch::Add(const FVector& Point)
+{
+	// Start a new group of four, padded out with zeros (their results get thrown away)
+	if ((Count & 3) == 0)
+	{
+		X.AddZeroed(4);
+		Y.AddZeroed(4);
+		Z.AddZeroed(4);
+	}
+
+	X[Count] = float(Point.X - Origin.X);
+	Y[Count] = float(Point.Y - Origin.Y);
+	Z[Count] = float(Point.Z - Origin.Z);
+	Count++;
+}
+
+
+void FGAConeTestBatch::Test(const FVector& Forward, float ConeCos, float Range, TBitArray<>& InConeOut) const
+{
+	InConeOut.Init(false, Count);
+	const VectorRegister4Float ForwardX = VectorSetFloat1(float(Forward.X));
+	const VectorRegister4Float ForwardY = VectorSetFloat1(float(Forward.Y));
+	const VectorRegister4Float ForwardZ = VectorSetFloat1(float(Forward.Z));
+	const VectorRegister4Float RangeSquared = VectorSetFloat1(Range * Range);
+	const VectorRegister4Float ConeCosSquared = VectorSetFloat1(ConeCos * FMath::Abs(ConeCos));
+
+	for (int32 Index = 0; Index < Count; Index += 4)
+	{
+		const VectorRegister4Float DX = VectorLoad(&X[Index]);
+		const VectorRegister4Float DY = VectorLoad(&Y[Index]);
+		const VectorRegister4Float DZ = VectorLoad(&Z[Index]);
+
+		const VectorRegister4Float DistSquared = VectorMultiplyAdd(DZ, DZ, VectorMultiplyAdd(DY, DY, VectorMultiply(DX, DX)));
+		const VectorRegister4Float Dot = VectorMultiplyAdd(DZ, ForwardZ, VectorMultiplyAdd(DY, ForwardY, VectorMultiply(DX, ForwardX)));
+
+		const VectorRegister4Float InRange = VectorCompareLE(DistSquared, RangeSquared);
+		const VectorRegister4Float InCone = VectorCompareGE(VectorMultiply(Dot, VectorAbs(Dot)), VectorMultiply(ConeCosSquared, DistSquared));
+		const uint32 Mask = VectorMaskBits(VectorBitwiseAnd(InRange, InCone));
+
+		if (Mask != 0)
+		{
+			const int32 Lanes = FMath::Min(4, Count - Index);
+			for (int32 Lane = 0; Lane < Lanes; Lane++)
+			{
+				if (Mask & (1u << Lane))
+				{
+					InConeOut[Index + Lane] = true;
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+
+// A batch of points to run a vision cone / range test against, four at a time
+// The points are kept as separate X, Y and Z arrays, padded out to a multiple of 4, so the test is a straight run of
+// vector loads. Used by the perception system (candidate targets for one perceiver) and by the perceiver's
+// visibility fallback (a row of cells at a time).
+// Points are stored relative to the cone's origin (subtracted in double precision as they're added), so the single
+// precision test only loses accuracy with distance from the perceiver, not from the world origin.
+
+struct FGAConeTestBatch
+{
+	FGAConeTestBatch() : Origin(FVector::ZeroVector), Count(0) {}
+
+	// Empty the batch, for a cone whose apex is at OriginIn
+	void Reset(const FVector& OriginIn);
+
+	void Add(const FVector& Point);
+
+	int32 Num() const { return Count; }
+
+	// Set bit i of InConeOut (resized to Num()) if point i is no further than Range from the origin and within the cone about
+	// Forward (unit length) whose half angle has cosine ConeCos.
+	// The cone test is the unnormalized Dot(Forward, D) * |Dot(Forward, D)| >= ConeCos * |ConeCos| * |D|^2, so there's no
+	// square root or divide per point
+	void Test(const FVector& Forward, float ConeCos, float Range, TBitArray<>& InConeOut) const;
+
+protected:
+	FVector Origin;
+	TArray<float> X;
+	TArray<float> Y;
+	TArray<float> Z;
+	int32 Count;
+};
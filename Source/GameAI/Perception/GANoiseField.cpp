@@ -0,0 +1,171 @@
+#include "GANoiseField.h"
+#include "GameAI/Grid/GAGridActor.h"
+
+
+void FGANoiseField::Build(const AGAGridActor* Grid, const FCellRef& SourceCellIn, float MaxDistanceIn)
+{
+	SourceCell = SourceCellIn;
+	MaxDistance = FMath::Max(MaxDistanceIn, 0.0f);
+
+	// Nothing can be further away (in cells) than the distance itself
+	const int32 Reach = FMath::CeilToInt32(MaxDistance / FMath::Max(Grid->CellScale, 1.0f));
+	Box = FGridBox(FMath::Max(SourceCell.X - Reach, 0), FMath::Min(SourceCell.X + Reach, Grid->XCount - 1),
+		FMath::Max(SourceCell.Y - Reach, 0), FMath::Min(SourceCell.Y + Reach, Grid->YCount - 1));
+
+	const int32 Width = Box.GetWidth();
+	const int32 Height = Box.GetHeight();
+	Distances.Reset();
+	Distances.Init(UE_MAX_FLT, Width * Height);
+
+	// Traversability of the box, read from the grid once rather than per relaxation
+	TBitArray<> Traversable(false, Width * Height);
+	for (int32 Y = 0; Y < Height; Y++)
+	{
+		for (int32 X = 0; X < Width; X++)
+		{
+			if (EnumHasAllFlags(Grid->GetCellData(FCellRef(Box.MinX + X, Box.MinY + Y)), ECellData::CellDataTraversable))
+			{
+				Traversable[Y * Width + X] = true;
+			}
+		}
+	}
+
+	struct FHeapNode
+	{
+		int32 Index;
+		float Cost;
+
+		bool operator<(const FHeapNode& Other) const
+		{
+			return Cost < Other.Cost;
+		}
+	};
+
+	const float OrthogonalCost = Grid->CellScale;
+	const float DiagonalCost = Grid->CellScale * UE_SQRT_2;
+	const int32 Offsets[8][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 }, { 1, 1 }, { -1, 1 }, { 1, -1 }, { -1, -1 } };
+
+	// The source itself is heard even if the noise was made somewhere the grid doesn't consider traversable
+	const int32 SourceIndex = (SourceCell.Y - Box.MinY) * Width + (SourceCell.X - Box.MinX);
+	Distances[SourceIndex] = 0.0f;
+
+	TArray<FHeapNode> OpenSet;
+	OpenSet.HeapPush({ SourceIndex, 0.0f });
+
+	while (OpenSet.Num() > 0)
+	{
+		FHeapNode Current;
+		OpenSet.HeapPop(Current, EAllowShrinking::No);
+
+		// Stale entry (the cell has been reached more cheaply since it was pushed)
+		if (Current.Cost > Distances[Current.Index])
+		{
+			continue;
+		}
+
+		const int32 CurrentX = Current.Index % Width;
+		const int32 CurrentY = Current.Index / Width;
+
+		for (int32 Direction = 0; Direction < 8; Direction++)
+		{
+			const int32 DX = Offsets[Direction][0];
+			const int32 DY = Offsets[Direction][1];
+			const int32 NeighborX = CurrentX + DX;
+			const int32 NeighborY = CurrentY + DY;
+			if ((NeighborX < 0) || (NeighborX >= Width) || (NeighborY < 0) || (NeighborY >= Height))
+			{
+				continue;
+			}
+
+			const int32 NeighborIndex = NeighborY * Width + NeighborX;
+			if (!Traversable[NeighborIndex])
+			{
+				continue;
+			}
+
+			const bool bDiagonal = (DX != 0) && (DY != 0);
+			if (bDiagonal && !Traversable[CurrentY * Width + NeighborX] && !Traversable[NeighborY * Width + CurrentX])
+			{
+				// Both cells beside the diagonal are blocked: that's a wall corner, not a gap
+				continue;
+			}
+
+			const float NewCost = Current.Cost + (bDiagonal ? DiagonalCost : OrthogonalCost);
+			if ((NewCost <= MaxDistance) && (NewCost < Distances[NeighborIndex]))
+			{
+				Distances[NeighborIndex] = NewCost;
+				OpenSet.HeapPush({ NeighborIndex, NewCost });
+			}
+		}
+	}
+}
+
+
+void FGANoiseFieldCache::Reset()
+{
+	Recency.Empty();
+	Fields.Reset();
+	Grid = nullptr;
+	CellDataVersion = INDEX_NONE;
+}
+
+const FGANoiseField* FGANoiseFieldCache::FindOrBuild(const AGAGridActor* GridIn, const FCellRef& SourceCell, float MaxDistance, int32 MaxFields, int32 BucketCells, float& SourceOffsetOut)
+{
+	SourceOffsetOut = 0.0f;
+
+	if (!GridIn || !GridIn->IsCellRefInBounds(SourceCell))
+	{
+		return nullptr;
+	}
+
+	if ((Grid != GridIn) || (CellDataVersion != GridIn->GetCellDataVersion()))
+	{
+		Reset();
+		Grid = GridIn;
+		CellDataVersion = GridIn->GetCellDataVersion();
+	}
+
+	const int32 BucketSize = FMath::Max(BucketCells, 1);
+	const FIntPoint Bucket(SourceCell.X / BucketSize, SourceCell.Y / BucketSize);
+
+	TUniquePtr<FGANoiseField>* Existing = Fields.Find(Bucket);
+	if (Existing)
+	{
+		FGANoiseField* Field = Existing->Get();
+		Recency.RemoveNode(Field->RecencyNode, false);
+		Recency.AddHead(Field->RecencyNode);
+
+		// Paths are symmetric, so the field's distance to this noise's cell is also how far this noise is from the
+		// field's source. It has to be reachable, and close, for the field to stand in for a flood of our own
+		const float SourceOffset = Field->GetDistance(SourceCell);
+		if ((SourceOffset <= BucketSize * Grid->CellScale) && (Field->MaxDistance >= MaxDistance + SourceOffset))
+		{
+			Hits++;
+			SourceOffsetOut = SourceOffset;
+			return Field;
+		}
+
+		// Too short, or too far from this noise: flood again, from this noise
+		Misses++;
+		Field->Build(Grid, SourceCell, MaxDistance);
+		return Field;
+	}
+
+	Misses++;
+
+	if (Fields.Num() >= FMath::Max(MaxFields, 1))
+	{
+		// Make room
+		TDoubleLinkedList<FGANoiseField*>::TDoubleLinkedListNode* Oldest = Recency.GetTail();
+		const FIntPoint OldestBucket = Oldest->GetValue()->Bucket;
+		Recency.RemoveNode(Oldest);
+		Fields.Remove(OldestBucket);
+	}
+
+	TUniquePtr<FGANoiseField>& Field = Fields.Add(Bucket, MakeUnique<FGANoiseField>());
+	Field->Bucket = Bucket;
+	Field->Build(Grid, SourceCell, MaxDistance);
+	Recency.AddHead(Field.Get());
+	Field->RecencyNode = Recency.GetHead();
+	return Field.Get();
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/List.h"
+#include "GameAI/Grid/GAGridMap.h"
+#include "GameAI/Grid/GAGridActor.h"
+
+
+// How far a noise made in one cell has to travel to reach every cell around it
+// A Dijkstra flood over the grid's traversable cells (8-way, no squeezing diagonally between two blocked cells), cut
+// off at MaxDistance, so sound goes around walls rather than through them. Distances are in world units and are kept
+// for the flood's bounding box, so a listener's distance is a single lookup.
+
+struct FGANoiseField
+{
+	FGANoiseField() : MaxDistance(0.0f), RecencyNode(nullptr) {}
+
+	void Build(const AGAGridActor* Grid, const FCellRef& SourceCell, float MaxDistance);
+
+	// Path distance from the source to Cell, or UE_MAX_FLT if the flood didn't reach it
+	FORCEINLINE float GetDistance(const FCellRef& Cell) const
+	{
+		// (Box is valid whenever the field is built)
+		if ((Cell.X < Box.MinX) || (Cell.X > Box.MaxX) || (Cell.Y < Box.MinY) || (Cell.Y > Box.MaxY))
+		{
+			return UE_MAX_FLT;
+		}
+		return Distances[(Cell.Y - Box.MinY) * Box.GetWidth() + (Cell.X - Box.MinX)];
+	}
+
+	FCellRef SourceCell;
+	float MaxDistance;
+	FGridBox Box;
+	TArray<float> Distances;
+
+	// For the cache: its key, and its place in the cache's recency list
+	FIntPoint Bucket;
+	TDoubleLinkedList<FGANoiseField*>::TDoubleLinkedListNode* RecencyNode;
+};
+
+
+// Noise fields by source bucket (a square of BucketCells x BucketCells cells), so that noises made around the same
+// spot (footsteps on a patrol route, a repeating alarm) share one flood, built from the first of them. A noise then
+// reuses the bucket's field only if it's within a bucket's width of the field's SourceCell along the field's own paths;
+// that path distance is handed back as the offset to add to every distance read from it. A noise that's cut off from
+// the field's source (the other side of a wall, say) or too far round gets the bucket's field flooded again from its
+// own cell.
+// Everything is thrown away when the grid's cells change. A field built for a shorter distance than the one asked for
+// (plus the offset) is rebuilt; a longer one is simply used as is. Past MaxFields, the least recently used field goes
+// (the fields are kept in a recency list, so that's the tail).
+
+struct FGANoiseFieldCache
+{
+	FGANoiseFieldCache() : Grid(nullptr), CellDataVersion(INDEX_NONE), Hits(0), Misses(0) {}
+
+	// SourceOffsetOut: path distance from SourceCell to the field's own source (0 if the field was flooded from it)
+	const FGANoiseField* FindOrBuild(const AGAGridActor* Grid, const FCellRef& SourceCell, float MaxDistance, int32 MaxFields, int32 BucketCells, float& SourceOffsetOut);
+
+	void Reset();
+
+	int32 Num() const { return Fields.Num(); }
+
+	int32 GetHits() const { return Hits; }
+	int32 GetMisses() const { return Misses; }
+
+protected:
+	TMap<FIntPoint, TUniquePtr<FGANoiseField>> Fields;
+
+	// Most recently used first
+	TDoubleLinkedList<FGANoiseField*> Recency;
+
+	const AGAGridActor* Grid;
+	int32 CellDataVersion;
+
+	int32 Hits;
+	int32 Misses;
+};
@@ -0,0 +1,475 @@
+#include "GAOccupancyBank.h"
+#include "GameAI/Grid/GAGridActor.h"
+#include "Math/VectorRegister.h"
+
+
+FGAOccupancyBank::FGAOccupancyBank() : Grid(nullptr), CellDataVersion(INDEX_NONE), Rate(0.0f), Stride(0), RunSteps(0), bBackReady(false)
+{
+}
+
+FGAOccupancyBank::~FGAOccupancyBank()
+{
+	// The task refers back to us
+	Wait();
+}
+
+void FGAOccupancyBank::Reset()
+{
+	Wait();
+
+	Masks.Reset();
+	Grid = nullptr;
+	CellDataVersion = INDEX_NONE;
+	Bounds = FGridBox();
+	Stride = 0;
+	Groups.Empty();
+	BackGroups.Empty();
+	FrontGroups.Empty();
+	bBackReady = false;
+	PendingCommands.Reset();
+}
+
+void FGAOccupancyBank::Wait()
+{
+	Task.Wait();
+}
+
+
+void FGAOccupancyBank::Prepare(const AGAGridActor* GridIn, int32 NumChannels, float RateIn)
+{
+	if (!GridIn)
+	{
+		Reset();
+		return;
+	}
+
+	const int32 NumGroups = FMath::DivideAndRoundUp(FMath::Max(NumChannels, 0), ChannelsPerGroup);
+	const bool bRestart = (Grid != GridIn) || (CellDataVersion != GridIn->GetCellDataVersion()) || (Rate != RateIn);
+	if (!bRestart && (Groups.Num() >= NumGroups))
+	{
+		return;
+	}
+
+	// The worker reads the masks and the groups
+	Wait();
+
+	if (bRestart)
+	{
+		// Start over: the old probabilities were spread over a different set of traversable cells
+		Groups.Reset();
+		BackGroups.Reset();
+		FrontGroups.Reset();
+		bBackReady = false;
+		PendingCommands.Reset();
+		Grid = GridIn;
+		CellDataVersion = GridIn->GetCellDataVersion();
+		Rate = RateIn;
+		Masks.Prepare(Grid, FGridBox(0, Grid->XCount - 1, 0, Grid->YCount - 1), Rate);
+		Bounds = Masks.GetMaskBounds();
+		Stride = Masks.GetStride();
+	}
+
+	const int32 PaddedCount = Masks.GetTraversablePlane().Num();
+	while (Groups.Num() < NumGroups)
+	{
+		FGroup& Group = Groups.AddDefaulted_GetRef();
+		Group.Buffers[0].SetNumZeroed(PaddedCount * ChannelsPerGroup);
+		Group.Buffers[1].SetNumZeroed(PaddedCount * ChannelsPerGroup);
+		for (int32 Lane = 0; Lane < ChannelsPerGroup; Lane++)
+		{
+			Group.MaxValues[Lane] = 0.0f;
+		}
+
+		for (TArray<FGroupView>* Views : { &BackGroups, &FrontGroups })
+		{
+			FGroupView& View = Views->AddDefaulted_GetRef();
+			View.Buffer.SetNumZeroed(PaddedCount * ChannelsPerGroup);
+			for (int32 Lane = 0; Lane < ChannelsPerGroup; Lane++)
+			{
+				View.MaxValues[Lane] = 0.0f;
+			}
+		}
+	}
+}
+
+
+void FGAOccupancyBank::ClearChannel(int32 Channel)
+{
+	if (!FrontGroups.IsValidIndex(Channel / ChannelsPerGroup))
+	{
+		return;
+	}
+
+	ClearViewLane(FrontGroups[Channel / ChannelsPerGroup], Channel % ChannelsPerGroup);
+	PendingCommands.Add({ Channel, FCellRef() });
+}
+
+void FGAOccupancyBank::Observe(int32 Channel, const FCellRef& Cell)
+{
+	if (!Groups.IsValidIndex(Channel / ChannelsPerGroup) || !Bounds.IsValidCell(Cell))
+	{
+		return;
+	}
+
+	// A sighting is reported every frame the target is in view: only the latest of those matters
+	for (int32 Index = PendingCommands.Num() - 1; Index >= 0; Index--)
+	{
+		if (PendingCommands[Index].Channel == Channel)
+		{
+			if (PendingCommands[Index].Cell.IsValid())
+			{
+				PendingCommands[Index].Cell = Cell;
+				return;
+			}
+			break;
+		}
+	}
+
+	PendingCommands.Add({ Channel, Cell });
+}
+
+void FGAOccupancyBank::ClearGroupLane(FGroup& Group, int32 Lane)
+{
+	if (Group.Support.IsValid())
+	{
+		for (TArray<float>& Buffer : Group.Buffers)
+		{
+			for (int32 Y = Group.Support.MinY; Y <= Group.Support.MaxY; Y++)
+			{
+				for (int32 X = Group.Support.MinX; X <= Group.Support.MaxX; X++)
+				{
+					Buffer[GetPaddedIndex(X, Y) * ChannelsPerGroup + Lane] = 0.0f;
+				}
+			}
+		}
+	}
+
+	Group.MaxCells[Lane] = FCellRef();
+	Group.MaxValues[Lane] = 0.0f;
+}
+
+void FGAOccupancyBank::ClearViewLane(FGroupView& View, int32 Lane)
+{
+	if (View.Support.IsValid())
+	{
+		for (int32 Y = View.Support.MinY; Y <= View.Support.MaxY; Y++)
+		{
+			for (int32 X = View.Support.MinX; X <= View.Support.MaxX; X++)
+			{
+				View.Buffer[GetPaddedIndex(X, Y) * ChannelsPerGroup + Lane] = 0.0f;
+			}
+		}
+	}
+
+	View.MaxCells[Lane] = FCellRef();
+	View.MaxValues[Lane] = 0.0f;
+}
+
+
+void FGAOccupancyBank::Launch(int32 Steps, TBitArray<>&& VisibleCells, TBitArray<>&& CullChannels, const FGridLayoutIndexer& CellIndexer)
+{
+	check(!IsBusy());
+
+	if (!IsValid())
+	{
+		return;
+	}
+
+	// The worker isn't touching the groups yet
+	for (const FCommand& Command : PendingCommands)
+	{
+		FGroup& Group = Groups[Command.Channel / ChannelsPerGroup];
+		const int32 Lane = Command.Channel % ChannelsPerGroup;
+		ClearGroupLane(Group, Lane);
+
+		if (Command.Cell.IsValid())
+		{
+			Group.Buffers[Group.Current][GetPaddedIndex(Command.Cell.X, Command.Cell.Y) * ChannelsPerGroup + Lane] = 1.0f;
+			Group.MaxCells[Lane] = Command.Cell;
+			Group.MaxValues[Lane] = 1.0f;
+
+			const FGridBox CellBox(Command.Cell.X, Command.Cell.X, Command.Cell.Y, Command.Cell.Y);
+			Group.Support = Group.Support.IsValid() ? Group.Support.GetUnion(CellBox) : CellBox;
+		}
+	}
+	PendingCommands.Reset();
+
+	RunSteps = Steps;
+	RunVisibleCells = MoveTemp(VisibleCells);
+	RunCullChannels = MoveTemp(CullChannels);
+	RunCellIndexer = CellIndexer;
+
+	Task = UE::Tasks::Launch(UE_SOURCE_LOCATION, [this]()
+	{
+		Run();
+	});
+}
+
+bool FGAOccupancyBank::Publish()
+{
+	if (IsBusy() || !bBackReady)
+	{
+		return false;
+	}
+
+	Swap(FrontGroups, BackGroups);
+	bBackReady = false;
+
+	// Channels cleared since the run was launched are still in its result
+	for (const FCommand& Command : PendingCommands)
+	{
+		if (!Command.Cell.IsValid())
+		{
+			ClearViewLane(FrontGroups[Command.Channel / ChannelsPerGroup], Command.Channel % ChannelsPerGroup);
+		}
+	}
+
+	return true;
+}
+
+
+void FGAOccupancyBank::Run()
+{
+	for (int32 Step = 0; Step < RunSteps; Step++)
+	{
+		for (int32 GroupIndex = 0; GroupIndex < Groups.Num(); GroupIndex++)
+		{
+			StepGroup(Groups[GroupIndex], GroupIndex * ChannelsPerGroup);
+		}
+	}
+
+	// The back buffers hold an older result: copying over both supports picks up the new values and clears the old ones
+	for (int32 GroupIndex = 0; GroupIndex < Groups.Num(); GroupIndex++)
+	{
+		const FGroup& Group = Groups[GroupIndex];
+		FGroupView& View = BackGroups[GroupIndex];
+
+		const FGridBox CopyBox = Group.Support.IsValid() ? (View.Support.IsValid() ? Group.Support.GetUnion(View.Support) : Group.Support) : View.Support;
+		if (CopyBox.IsValid())
+		{
+			const float* Src = Group.Buffers[Group.Current].GetData();
+			float* Dst = View.Buffer.GetData();
+			for (int32 Y = CopyBox.MinY; Y <= CopyBox.MaxY; Y++)
+			{
+				const int32 RowStart = GetPaddedIndex(CopyBox.MinX, Y) * ChannelsPerGroup;
+				FMemory::Memcpy(Dst + RowStart, Src + RowStart, CopyBox.GetWidth() * ChannelsPerGroup * sizeof(float));
+			}
+		}
+
+		View.Support = Group.Support;
+		for (int32 Lane = 0; Lane < ChannelsPerGroup; Lane++)
+		{
+			View.MaxCells[Lane] = Group.MaxCells[Lane];
+			View.MaxValues[Lane] = Group.MaxValues[Lane];
+		}
+	}
+
+	bBackReady = true;
+}
+
+void FGAOccupancyBank::StepGroup(FGroup& Group, int32 FirstChannel)
+{
+	if (!Group.Support.IsValid())
+	{
+		return;
+	}
+
+	float* Src = Group.Buffers[Group.Current].GetData();
+	float* Dst = Group.Buffers[1 - Group.Current].GetData();
+
+	// Cull: zero the visible cells in the culled channels, adding up what each channel lost
+	float CullLanes[ChannelsPerGroup];
+	bool bAnyCull = false;
+	for (int32 Lane = 0; Lane < ChannelsPerGroup; Lane++)
+	{
+		const bool bCull = RunCullChannels.IsValidIndex(FirstChannel + Lane) && RunCullChannels[FirstChannel + Lane];
+		CullLanes[Lane] = bCull ? 1.0f : 0.0f;
+		bAnyCull |= bCull;
+	}
+
+	VectorRegister4Float ScaleVec = VectorOne();
+	if (bAnyCull && (RunVisibleCells.Num() == RunCellIndexer.GetStorageCount()))
+	{
+		const VectorRegister4Float Zero = VectorZero();
+		const VectorRegister4Float CullMask = VectorCompareGT(VectorLoad(CullLanes), Zero);
+		VectorRegister4Float Culled = Zero;
+
+		for (TConstSetBitIterator<> It(RunVisibleCells); It; ++It)
+		{
+			int32 X, Y;
+			RunCellIndexer.ToCoords(It.GetIndex(), X, Y);
+			if (!Group.Support.IsValidCell(FCellRef(X, Y)))
+			{
+				continue;
+			}
+
+			float* Cell = Src + GetPaddedIndex(X, Y) * ChannelsPerGroup;
+			const VectorRegister4Float Value = VectorLoad(Cell);
+			Culled = VectorAdd(Culled, VectorBitwiseAnd(Value, CullMask));
+			VectorStore(VectorSelect(CullMask, Zero, Value), Cell);
+		}
+
+		// Renormalize what's left of each channel. Diffusion is linear, so the scale is folded into the step below
+		// (a channel that lost everything is left empty)
+		float CulledLanes[ChannelsPerGroup];
+		float ScaleLanes[ChannelsPerGroup];
+		VectorStore(Culled, CulledLanes);
+		for (int32 Lane = 0; Lane < ChannelsPerGroup; Lane++)
+		{
+			ScaleLanes[Lane] = (CulledLanes[Lane] < 1.0f) ? 1.0f / (1.0f - CulledLanes[Lane]) : 1.0f;
+		}
+		ScaleVec = VectorLoad(ScaleLanes);
+	}
+
+	// Diffuse over the support plus the ring it can spread into. Dst only holds values from older, smaller supports,
+	// all of which get overwritten
+	const FGridBox Region = Group.Support.GetExpanded(1, Bounds);
+	const int32 Width = Region.GetWidth();
+	const float* T = Masks.GetTraversablePlane().GetData();
+	const float* K = Masks.GetKeepPlane().GetData();
+	const VectorRegister4Float OrthogonalRateVec = VectorSetFloat1(Rate);
+	const VectorRegister4Float DiagonalRateVec = VectorSetFloat1(Rate / UE_SQRT_2);
+	const int32 RowStep = Stride * ChannelsPerGroup;
+
+	for (int32 Lane = 0; Lane < ChannelsPerGroup; Lane++)
+	{
+		Group.MaxCells[Lane] = FCellRef();
+		Group.MaxValues[Lane] = 0.0f;
+	}
+
+	for (int32 Y = Region.MinY; Y <= Region.MaxY; Y++)
+	{
+		const int32 RowStart = GetPaddedIndex(Region.MinX, Y);
+		VectorRegister4Float RowMaxVec = VectorZero();
+
+		for (int32 X = 0; X < Width; X++)
+		{
+			const int32 Index = RowStart + X;
+			const float* Center = Src + Index * ChannelsPerGroup;
+
+			const VectorRegister4Float Orthogonal = VectorAdd(
+				VectorAdd(VectorLoad(Center - ChannelsPerGroup), VectorLoad(Center + ChannelsPerGroup)),
+				VectorAdd(VectorLoad(Center - RowStep), VectorLoad(Center + RowStep)));
+			const VectorRegister4Float Diagonal = VectorAdd(
+				VectorAdd(VectorLoad(Center - RowStep - ChannelsPerGroup), VectorLoad(Center - RowStep + ChannelsPerGroup)),
+				VectorAdd(VectorLoad(Center + RowStep - ChannelsPerGroup), VectorLoad(Center + RowStep + ChannelsPerGroup)));
+
+			VectorRegister4Float Sum = VectorMultiply(VectorSetFloat1(K[Index]), VectorLoad(Center));
+			Sum = VectorMultiplyAdd(Orthogonal, OrthogonalRateVec, Sum);
+			Sum = VectorMultiplyAdd(Diagonal, DiagonalRateVec, Sum);
+			const VectorRegister4Float Result = VectorMultiply(Sum, VectorMultiply(VectorSetFloat1(T[Index]), ScaleVec));
+
+			VectorStore(Result, Dst + Index * ChannelsPerGroup);
+			RowMaxVec = VectorMax(RowMaxVec, Result);
+		}
+
+		// Only the channels this row beats get the row searched for their max cell
+		float RowMax[ChannelsPerGroup];
+		VectorStore(RowMaxVec, RowMax);
+		for (int32 Lane = 0; Lane < ChannelsPerGroup; Lane++)
+		{
+			if (RowMax[Lane] <= Group.MaxValues[Lane])
+			{
+				continue;
+			}
+
+			for (int32 X = 0; X < Width; X++)
+			{
+				if (Dst[(RowStart + X) * ChannelsPerGroup + Lane] == RowMax[Lane])
+				{
+					Group.MaxCells[Lane] = FCellRef(Region.MinX + X, Y);
+					break;
+				}
+			}
+			Group.MaxValues[Lane] = RowMax[Lane];
+		}
+	}
+
+	Group.Support = Region;
+	Group.Current = 1 - Group.Current;
+}
+
+
+bool FGAOccupancyBank::GetMostLikelyCell(int32 Channel, FCellRef& CellOut) const
+{
+	if (!FrontGroups.IsValidIndex(Channel / ChannelsPerGroup))
+	{
+		return false;
+	}
+
+	const FGroupView& Group = FrontGroups[Channel / ChannelsPerGroup];
+	const int32 Lane = Channel % ChannelsPerGroup;
+	if ((Group.MaxValues[Lane] <= 0.0f) || !Group.MaxCells[Lane].IsValid())
+	{
+		return false;
+	}
+
+	CellOut = Group.MaxCells[Lane];
+	return true;
+}
+
+float FGAOccupancyBank::GetSumInBox(int32 Channel, const FGridBox& Box) const
+{
+	if (!FrontGroups.IsValidIndex(Channel / ChannelsPerGroup))
+	{
+		return 0.0f;
+	}
+
+	const FGroupView& Group = FrontGroups[Channel / ChannelsPerGroup];
+	const int32 Lane = Channel % ChannelsPerGroup;
+	if (!Group.Support.IsValid() || !Box.IsValid())
+	{
+		return 0.0f;
+	}
+
+	// Everything outside the support is zero
+	const int32 MinX = FMath::Max(Box.MinX, Group.Support.MinX);
+	const int32 MaxX = FMath::Min(Box.MaxX, Group.Support.MaxX);
+	const int32 MinY = FMath::Max(Box.MinY, Group.Support.MinY);
+	const int32 MaxY = FMath::Min(Box.MaxY, Group.Support.MaxY);
+
+	const float* Buffer = Group.Buffer.GetData();
+	float Sum = 0.0f;
+	for (int32 Y = MinY; Y <= MaxY; Y++)
+	{
+		for (int32 X = MinX; X <= MaxX; X++)
+		{
+			Sum += Buffer[GetPaddedIndex(X, Y) * ChannelsPerGroup + Lane];
+		}
+	}
+	return Sum;
+}
+
+void FGAOccupancyBank::ExportChannel(int32 Channel, FGAGridMap& Map) const
+{
+	if (!Map.IsValid())
+	{
+		return;
+	}
+
+	Map.ResetData(0.0f);
+	if (!FrontGroups.IsValidIndex(Channel / ChannelsPerGroup))
+	{
+		return;
+	}
+
+	const FGroupView& Group = FrontGroups[Channel / ChannelsPerGroup];
+	const int32 Lane = Channel % ChannelsPerGroup;
+	if (!Group.Support.IsValid())
+	{
+		return;
+	}
+
+	const float* Buffer = Group.Buffer.GetData();
+	for (int32 Y = Group.Support.MinY; Y <= Group.Support.MaxY; Y++)
+	{
+		for (int32 X = Group.Support.MinX; X <= Group.Support.MaxX; X++)
+		{
+			if (Map.GridBounds.IsValidCell(FCellRef(X, Y)))
+			{
+				Map.Data[Map.CellRefToIndexUnchecked(X, Y)] = Buffer[GetPaddedIndex(X, Y) * ChannelsPerGroup + Lane];
+			}
+		}
+	}
+	Map.MarkDirty(Group.Support);
+}
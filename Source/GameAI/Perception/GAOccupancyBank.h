@@ -0,0 +1,143 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tasks/Task.h"
+#include "GameAI/Grid/GAGridMap.h"
+#include "GameAI/Grid/GAGridActor.h"
+#include "GameAI/Grid/GAGridDiffusion.h"
+
+
+// The occupancy maps of several targets in one buffer, stepped together (owned by UGAPerceptionSystem, for the
+// targets in GATTM_OccupancyMap mode)
+// Channels are indexed by target slot and packed four to a group. Each group is a single padded buffer with the four
+// channels of a cell side by side, so a cell is one VectorRegister4Float: the cull and the diffusion stencil (same
+// formula and masks as FGAGridDiffuser) then do all four channels with the instructions one map would need.
+// Filling out a group costs next to nothing over its first channel.
+//
+// Each group remembers the box its non-zero cells can be in (only ever grows, like a sighting's probability does),
+// and steps are restricted to it. Every channel shares one diffusion rate.
+//
+// Steps run on a worker task, the same way FGAOccupancySimulation runs a private map: the worker owns the groups while
+// a run is in flight, and copies its result into back buffers at the end of it. Publish() swaps those with the front
+// copies, which is all the queries ever read, so the game thread never waits on the worker. Observations and clears
+// are queued, and only get applied to the groups when the next run is launched.
+//
+// Everything here is called from the game thread, apart from Run().
+
+struct FGAOccupancyBank
+{
+	FGAOccupancyBank();
+	~FGAOccupancyBank();
+
+	// Make room for channels [0, NumChannels). Switching grid, or the grid's cells or the rate changing, empties every
+	// channel. Waits for the run in flight if anything has to change
+	void Prepare(const AGAGridActor* Grid, int32 NumChannels, float Rate);
+
+	// Drop everything (waits for any run in flight)
+	void Reset();
+
+	bool IsValid() const { return Grid != nullptr; }
+
+	// Empties the channel's published map right away (so a reused slot doesn't show its last owner's), and its working
+	// map at the next launch
+	void ClearChannel(int32 Channel);
+
+	// All of the channel's probability goes to Cell, as of the next launch
+	void Observe(int32 Channel, const FCellRef& Cell);
+
+	// Anything queued up for the next launch?
+	bool HasPendingCommands() const { return PendingCommands.Num() > 0; }
+
+	// Is a run in flight?
+	bool IsBusy() const { return !Task.IsCompleted(); }
+
+	// Apply the queued observations and clears, then start Steps steps of every channel on a worker. Must not be busy.
+	// Each step, the channels set in CullChannels lose their probability in VisibleCells (indexed by CellIndexer) and
+	// are renormalized, then everything diffuses. VisibleCells and CullChannels are snapshots the worker keeps
+	void Launch(int32 Steps, TBitArray<>&& VisibleCells, TBitArray<>&& CullChannels, const FGridLayoutIndexer& CellIndexer);
+
+	// If a run has finished since the last call, make its result the one the queries read and return true
+	bool Publish();
+
+	// Block until the run in flight (if any) is done
+	void Wait();
+
+	// The channel's highest cell as of the last published step (or observation)
+	bool GetMostLikelyCell(int32 Channel, FCellRef& CellOut) const;
+
+	// Total of the channel over Box (in grid cells)
+	float GetSumInBox(int32 Channel, const FGridBox& Box) const;
+
+	// Copy the channel into Map, which must be built on the bank's grid
+	void ExportChannel(int32 Channel, FGAGridMap& Map) const;
+
+	static constexpr int32 ChannelsPerGroup = 4;
+
+protected:
+	struct FGroup
+	{
+		// Two padded buffers, ping-ponged between steps. ChannelsPerGroup floats per padded cell
+		TArray<float> Buffers[2];
+		int32 Current = 0;
+
+		FGridBox Support;
+
+		// Per channel: see GetMostLikelyCell
+		FCellRef MaxCells[ChannelsPerGroup];
+		float MaxValues[ChannelsPerGroup];
+	};
+
+	// A finished group, as the queries see it
+	struct FGroupView
+	{
+		TArray<float> Buffer;
+		FGridBox Support;
+		FCellRef MaxCells[ChannelsPerGroup];
+		float MaxValues[ChannelsPerGroup];
+	};
+
+	// Observe (or, with an invalid Cell, clear) a channel
+	struct FCommand
+	{
+		int32 Channel;
+		FCellRef Cell;
+	};
+
+	FORCEINLINE int32 GetPaddedIndex(int32 X, int32 Y) const
+	{
+		return (Y - Bounds.MinY + 1) * Stride + (X - Bounds.MinX + 1);
+	}
+
+	// Worker side
+	void Run();
+	void StepGroup(FGroup& Group, int32 FirstChannel);
+
+	void ClearGroupLane(FGroup& Group, int32 Lane);
+	void ClearViewLane(FGroupView& View, int32 Lane);
+
+	// Owns the baked masks
+	FGAGridDiffuser Masks;
+
+	const AGAGridActor* Grid;
+	int32 CellDataVersion;
+	float Rate;
+	FGridBox Bounds;
+	int32 Stride;
+
+	// Only touched on the game thread while not busy, and only by the worker while busy
+	TArray<FGroup> Groups;
+	int32 RunSteps;
+	TBitArray<> RunVisibleCells;
+	TBitArray<> RunCullChannels;
+	FGridLayoutIndexer RunCellIndexer;
+	TArray<FGroupView> BackGroups;
+	bool bBackReady;
+
+	// What the queries read (game thread only)
+	TArray<FGroupView> FrontGroups;
+
+	// Waiting for the next launch, in the order they came in
+	TArray<FCommand> PendingCommands;
+
+	UE::Tasks::FTask Task;
+};
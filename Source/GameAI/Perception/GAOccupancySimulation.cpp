@@ -0,0 +1,161 @@
+#include "GAOccupancySimulation.h"
+#include "Tasks/Task.h"
+
+
+FGAOccupancySimulation::FGAOccupancySimulation() : Grid(nullptr), bBackMapReady(false), Generation(0)
+{
+}
+
+FGAOccupancySimulation::~FGAOccupancySimulation()
+{
+	// The task refers back to us
+	Wait();
+}
+
+
+void FGAOccupancySimulation::Init(const FGASparseGridMap& Map)
+{
+	Wait();
+
+	WorkingMap = Map;
+	BackMap = Map;
+	bBackMapReady = false;
+	Diffuser.Reset();
+}
+
+void FGAOccupancySimulation::Reset()
+{
+	Wait();
+
+	Grid = nullptr;
+	Input = FGAOccupancySimulationInput();
+	WorkingMap = FGASparseGridMap();
+	BackMap = FGASparseGridMap();
+	bBackMapReady = false;
+	Diffuser.Reset();
+}
+
+void FGAOccupancySimulation::Wait()
+{
+	Task.Wait();
+}
+
+
+void FGAOccupancySimulation::Launch(const AGAGridActor* GridIn, FGAOccupancySimulationInput&& InputIn)
+{
+	check(!IsBusy());
+
+	if (!GridIn || !IsInitialized())
+	{
+		return;
+	}
+
+	Grid = GridIn;
+	Input = MoveTemp(InputIn);
+
+	// The worker isn't touching the map yet, and the masks have to be baked around wherever the probability is
+	// about to be
+	if (Input.bObserved && WorkingMap.GridBounds.IsValidCell(Input.ObservedCell))
+	{
+		WorkingMap.ResetData(0.0f);
+		WorkingMap.SetValue(Input.ObservedCell, 1.0f);
+	}
+
+	// The diffuser reads the grid's cell data when it bakes the masks of the tiles the run can reach, so get that done
+	// here. The run then only uses what's baked (DiffusePrepared), and never looks at the grid while the game thread
+	// may be changing it
+	Diffuser.Prepare(Grid, WorkingMap, Input.DiffusionRate, Input.Steps);
+
+	Task = UE::Tasks::Launch(UE_SOURCE_LOCATION, [this]()
+	{
+		Run();
+	});
+}
+
+bool FGAOccupancySimulation::Publish(FGASparseGridMap& FrontMapInOut, FCellRef& MostLikelyCellOut)
+{
+	if (IsBusy() || !bBackMapReady)
+	{
+		return false;
+	}
+
+	Swap(FrontMapInOut, BackMap);
+	MostLikelyCellOut = BackMostLikelyCell;
+	bBackMapReady = false;
+	Generation++;
+
+	return true;
+}
+
+
+void FGAOccupancySimulation::Run()
+{
+	// (The observation, if any, was applied by Launch)
+	if (Input.bCullVisible)
+	{
+		for (int32 Step = 0; Step < Input.Steps; Step++)
+		{
+			CullVisibleCells(WorkingMap, Input.CellIndexer, Input.VisibleCells);
+			Diffuser.DiffusePrepared(WorkingMap, 1);
+		}
+	}
+	else
+	{
+		Diffuser.DiffusePrepared(WorkingMap, Input.Steps);
+	}
+
+	// Diffusion was the last thing to touch the map, and the diffuser picks up the max cell as it goes. Only a run
+	// without any steps has to go looking for it
+	float MaxValue = -UE_MAX_FLT;
+	FCellRef BestCell;
+	if (Diffuser.GetLastMax(BestCell, MaxValue) || WorkingMap.ArgMax(BestCell, MaxValue))
+	{
+		BackMostLikelyCell = BestCell;
+	}
+	else
+	{
+		BackMostLikelyCell = FCellRef();
+	}
+
+	// (Only the allocated tiles get copied. The back buffer's arrays are reused where they're big enough)
+	BackMap = WorkingMap;
+	bBackMapReady = true;
+}
+
+
+int32 FGAOccupancySimulation::ConsumeFixedSteps(float& PendingTimeInOut, float StepRate, int32 MaxSteps)
+{
+	const float StepTime = 1.0f / FMath::Max(StepRate, 1.0f);
+	const int32 Steps = FMath::FloorToInt32(PendingTimeInOut / StepTime);
+	if (Steps > FMath::Max(MaxSteps, 1))
+	{
+		PendingTimeInOut = 0.0f;
+		return FMath::Max(MaxSteps, 1);
+	}
+
+	PendingTimeInOut -= Steps * StepTime;
+	return Steps;
+}
+
+
+float FGAOccupancySimulation::CullVisibleCells(FGASparseGridMap& Map, const FGridLayoutIndexer& CellIndexer, const TBitArray<>& VisibleCells)
+{
+	float Pculled = 0.0f;
+	Map.ForEachAllocatedCell([&](int32 X, int32 Y, float& Value)
+	{
+		const int32 CellIndex = CellIndexer.ToIndex(X, Y);
+		if (VisibleCells.IsValidIndex(CellIndex) && VisibleCells[CellIndex])
+		{
+			Pculled += Value;
+			Value = 0.0f;
+		}
+	});
+
+	// Avoid dividing by zero
+	if (Pculled < 1.0f)
+	{
+		Map.Scale(1.0f / (1.0f - Pculled));
+	}
+
+	return Pculled;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tasks/Task.h"
+#include "GameAI/Grid/GAGridMap.h"
+#include "GameAI/Grid/GASparseGridMap.h"
+#include "GameAI/Grid/GAGridActor.h"
+#include "GameAI/Grid/GAGridDiffusion.h"
+
+
+// What the game thread hands the occupancy simulation for one run
+struct FGAOccupancySimulationInput
+{
+	// The target was seen this run: start over from this cell (before any steps)
+	bool bObserved = false;
+	FCellRef ObservedCell;
+
+	// The target is hidden: every step clears out (and renormalizes away) the probability in the visible cells
+	bool bCullVisible = false;
+
+	// Snapshot of the perceivers' visibility (see UGAPerceptionSystem::GetFrameVisibility), and how to index it
+	TBitArray<> VisibleCells;
+	FGridLayoutIndexer CellIndexer;
+
+	// Fixed steps to run, and the diffusion rate of each
+	int32 Steps = 0;
+	float DiffusionRate = 0.0f;
+};
+
+
+// A target's occupancy map, stepped on a worker task (see UGATargetComponent::bFixedRateOccupancy)
+//
+// The simulation owns the map it steps (WorkingMap), and only the worker touches it while a run is in flight. At the
+// end of a run the worker copies its result into a back buffer, along with the most likely cell. The game thread
+// picks that up with Publish(), which swaps the back buffer with the map the game thread reads from. The game thread
+// never waits on the worker; it just keeps reading the last published map until the next one is ready.
+//
+// The maps are sparse (FGASparseGridMap), with tiles only where there's probability. Every pass (culling, diffusion,
+// the argmax and the copy into the back buffer) only visits those tiles, so both the memory and the cost of a run
+// follow how far the probability has spread, not the size of the grid.
+//
+// Everything here is called from the game thread, apart from Run().
+
+class FGAOccupancySimulation
+{
+public:
+	FGAOccupancySimulation();
+	~FGAOccupancySimulation();
+
+	// Start over from Map, whose default value must be 0 (waits for any run in flight)
+	void Init(const FGASparseGridMap& Map);
+
+	// Drop everything (waits for any run in flight)
+	void Reset();
+
+	bool IsInitialized() const { return WorkingMap.IsValid(); }
+
+	// Is a run in flight?
+	bool IsBusy() const { return !Task.IsCompleted(); }
+
+	// Start a run on a worker. Must not be busy. The observation (if any) is applied right away
+	void Launch(const AGAGridActor* Grid, FGAOccupancySimulationInput&& InputIn);
+
+	// If a run has finished since the last call, swap its map into FrontMapInOut and return true. Whatever
+	// FrontMapInOut held becomes the next back buffer (so its allocation gets reused).
+	bool Publish(FGASparseGridMap& FrontMapInOut, FCellRef& MostLikelyCellOut);
+
+	// Block until the run in flight (if any) is done
+	void Wait();
+
+	// How many runs have been published
+	uint32 GetGeneration() const { return Generation; }
+
+	// Clear out the probability in the visible cells and renormalize what's left, so that the map still sums to 1
+	// (leaves the map alone if everything was visible). Only the allocated tiles are touched -- the rest are zero.
+	// Returns the probability that was cleared
+	static float CullVisibleCells(FGASparseGridMap& Map, const FGridLayoutIndexer& CellIndexer, const TBitArray<>& VisibleCells);
+
+	// The fixed step accumulator: how many steps of 1 / StepRate seconds PendingTimeInOut holds, which are then taken
+	// out of it. More than MaxSteps means we've fallen behind, and the excess is dropped rather than caught up on
+	static int32 ConsumeFixedSteps(float& PendingTimeInOut, float StepRate, int32 MaxSteps);
+
+protected:
+	// Worker side
+	void Run();
+
+	// Only touched on the game thread while not busy, and only by the worker while busy
+	const AGAGridActor* Grid;
+	FGAOccupancySimulationInput Input;
+	FGASparseGridMap WorkingMap;
+	FGASparseGridDiffuser Diffuser;
+
+	// The finished result, waiting to be published
+	FGASparseGridMap BackMap;
+	FCellRef BackMostLikelyCell;
+	bool bBackMapReady;
+
+	UE::Tasks::FTask Task;
+	uint32 Generation;
+};
@@ -0,0 +1,263 @@
+#include "GAParticleTracker.h"
+#include "GameAI/Grid/GAGridActor.h"
+
+
+FGAParticleTracker::FGAParticleTracker() : Random(FPlatformTime::Cycles())
+{
+}
+
+void FGAParticleTracker::Reset()
+{
+	Positions.Empty();
+	Velocities.Empty();
+	Weights.Empty();
+	ScratchPositions.Empty();
+	ScratchVelocities.Empty();
+	ScratchCellWeights.Empty();
+}
+
+
+FVector2f FGAParticleTracker::RandomHeading(float Speed)
+{
+	const float Angle = Random.FRandRange(0.0f, 2.0f * PI);
+	return FVector2f(FMath::Cos(Angle), FMath::Sin(Angle)) * Speed;
+}
+
+
+void FGAParticleTracker::Observe(const AGAGridActor* Grid, const FVector& Position, const FVector& Velocity, int32 Count, float WanderSpeed)
+{
+	if (!Grid || (Count <= 0))
+	{
+		Reset();
+		return;
+	}
+
+	const FCellRef Cell = Grid->GetCellRef(Position, true);
+	if (!Cell.IsValid())
+	{
+		Reset();
+		return;
+	}
+
+	// Grid space has the same axes as the actor's local space, scaled to cells
+	const FVector LocalVelocity = Grid->GetActorTransform().InverseTransformVector(Velocity);
+	const FVector2f GridVelocity(LocalVelocity.X / Grid->CellScale, LocalVelocity.Y / Grid->CellScale);
+	const float GridWanderSpeed = WanderSpeed / Grid->CellScale;
+
+	Positions.SetNumUninitialized(Count);
+	Velocities.SetNumUninitialized(Count);
+	Weights.SetNumUninitialized(Count);
+
+	for (int32 Index = 0; Index < Count; Index++)
+	{
+		Positions[Index] = FVector2f(Cell.X + Random.FRand(), Cell.Y + Random.FRand());
+		Velocities[Index] = GridVelocity + RandomHeading(GridWanderSpeed * Random.FRand());
+		Weights[Index] = 1.0f / Count;
+	}
+}
+
+
+void FGAParticleTracker::Propagate(const AGAGridActor* Grid, float DeltaTime, float WanderSpeed, float TurnRate)
+{
+	if (!Grid || !IsValid() || (DeltaTime <= 0.0f))
+	{
+		return;
+	}
+
+	const TArray<float>& TraversabilityMask = Grid->GetTraversabilityMask();
+	if (TraversabilityMask.Num() != Grid->GetCellIndexCount())
+	{
+		return;
+	}
+
+	auto IsOnGrid = [&](const FCellRef& Cell)
+	{
+		return (Cell.X >= 0) && (Cell.X < Grid->XCount) && (Cell.Y >= 0) && (Cell.Y < Grid->YCount);
+	};
+
+	auto IsTraversable = [&](const FCellRef& Cell)
+	{
+		return IsOnGrid(Cell) && (TraversabilityMask[Grid->CellRefToIndex(Cell)] != 0.0f);
+	};
+
+	const float GridWanderSpeed = WanderSpeed / Grid->CellScale;
+	const float TurnProbability = FMath::Clamp(TurnRate * DeltaTime, 0.0f, 1.0f);
+
+	for (int32 Index = 0; Index < Positions.Num(); Index++)
+	{
+		FVector2f& Position = Positions[Index];
+		FVector2f& Velocity = Velocities[Index];
+
+		if (Random.FRand() < TurnProbability)
+		{
+			Velocity = RandomHeading(GridWanderSpeed * Random.FRandRange(0.5f, 1.0f));
+		}
+
+		// Move in sub-steps of at most half a cell, so that particles can't tunnel through thin walls
+		const FVector2f Move = Velocity * DeltaTime;
+		const int32 SubSteps = FMath::Max(1, FMath::CeilToInt32(Move.Size() * 2.0f));
+		const FVector2f SubMove = Move / float(SubSteps);
+		for (int32 SubStep = 0; SubStep < SubSteps; SubStep++)
+		{
+			// (A particle that started out in a non-traversable cell is free to walk out of it, but never off the grid)
+			const FVector2f NewPosition = Position + SubMove;
+			const FCellRef NewCell = ToCell(NewPosition);
+			if (!IsOnGrid(NewCell) || (!IsTraversable(NewCell) && IsTraversable(ToCell(Position))))
+			{
+				// Bounce off in some new direction, at the same speed
+				Velocity = RandomHeading(Velocity.Size());
+				break;
+			}
+			Position = NewPosition;
+		}
+	}
+}
+
+
+float FGAParticleTracker::Cull(const AGAGridActor* Grid, const TBitArray<>& VisibleCells)
+{
+	if (!Grid || !IsValid() || (VisibleCells.Num() != Grid->GetCellIndexCount()))
+	{
+		return 0.0f;
+	}
+
+	float Culled = 0.0f;
+	float Remaining = 0.0f;
+	for (int32 Index = 0; Index < Positions.Num(); Index++)
+	{
+		const FCellRef Cell = ToCell(Positions[Index]);
+		if (Grid->IsCellRefInBounds(Cell) && VisibleCells[Grid->CellRefToIndex(Cell)])
+		{
+			Culled += Weights[Index];
+			Weights[Index] = 0.0f;
+		}
+		else
+		{
+			Remaining += Weights[Index];
+		}
+	}
+
+	if (Remaining <= 0.0f)
+	{
+		// Everything was in plain sight, so put the weights back and wait for the particles to move out of view
+		for (float& Weight : Weights)
+		{
+			Weight = 1.0f / Weights.Num();
+		}
+		return Culled;
+	}
+
+	if (Culled > 0.0f)
+	{
+		Resample();
+	}
+
+	return Culled;
+}
+
+
+void FGAParticleTracker::Resample()
+{
+	const int32 Count = Positions.Num();
+
+	float TotalWeight = 0.0f;
+	for (float Weight : Weights)
+	{
+		TotalWeight += Weight;
+	}
+
+	ScratchPositions.Reset(Count);
+	ScratchVelocities.Reset(Count);
+
+	const float Spacing = TotalWeight / Count;
+	float Target = Random.FRand() * Spacing;
+	float Cumulative = 0.0f;
+	int32 Source = 0;
+	for (int32 Index = 0; Index < Count; Index++)
+	{
+		// Skip ahead to the particle whose slice of the cumulative weight holds Target
+		while ((Source < Count - 1) && (Cumulative + Weights[Source] <= Target))
+		{
+			Cumulative += Weights[Source];
+			Source++;
+		}
+
+		ScratchPositions.Add(Positions[Source]);
+		ScratchVelocities.Add(Velocities[Source]);
+		Target += Spacing;
+	}
+
+	Swap(Positions, ScratchPositions);
+	Swap(Velocities, ScratchVelocities);
+	for (float& Weight : Weights)
+	{
+		Weight = 1.0f / Count;
+	}
+}
+
+
+bool FGAParticleTracker::GetMostLikelyCell(FCellRef& CellOut) const
+{
+	if (!IsValid())
+	{
+		return false;
+	}
+
+	// Sort by cell, then add up the weight of each run of particles in the same cell
+	ScratchCellWeights.Reset(Positions.Num());
+	for (int32 Index = 0; Index < Positions.Num(); Index++)
+	{
+		const FCellRef Cell = ToCell(Positions[Index]);
+		ScratchCellWeights.Emplace((int64(Cell.Y) << 32) | uint32(Cell.X), Weights[Index]);
+	}
+	ScratchCellWeights.Sort([](const TPair<int64, float>& A, const TPair<int64, float>& B) { return A.Key < B.Key; });
+
+	int64 BestKey = ScratchCellWeights[0].Key;
+	float BestWeight = -1.0f;
+	for (int32 Index = 0; Index < ScratchCellWeights.Num();)
+	{
+		const int64 Key = ScratchCellWeights[Index].Key;
+		float CellWeight = 0.0f;
+		for (; (Index < ScratchCellWeights.Num()) && (ScratchCellWeights[Index].Key == Key); Index++)
+		{
+			CellWeight += ScratchCellWeights[Index].Value;
+		}
+
+		if (CellWeight > BestWeight)
+		{
+			BestWeight = CellWeight;
+			BestKey = Key;
+		}
+	}
+
+	CellOut = FCellRef(int32(uint32(BestKey & 0xFFFFFFFF)), int32(BestKey >> 32));
+	return true;
+}
+
+
+float FGAParticleTracker::GetWeightInBox(const FGridBox& Box) const
+{
+	float Total = 0.0f;
+	for (int32 Index = 0; Index < Positions.Num(); Index++)
+	{
+		if (Box.IsValidCell(ToCell(Positions[Index])))
+		{
+			Total += Weights[Index];
+		}
+	}
+	return Total;
+}
+
+
+void FGAParticleTracker::Rasterize(FGAGridMap& Map) const
+{
+	for (int32 Index = 0; Index < Positions.Num(); Index++)
+	{
+		const FCellRef Cell = ToCell(Positions[Index]);
+		float Value = 0.0f;
+		if (Map.GetValue(Cell, Value))
+		{
+			Map.SetValue(Cell, Value + Weights[Index]);
+		}
+	}
+}
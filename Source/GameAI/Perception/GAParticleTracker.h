@@ -0,0 +1,75 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameAI/Grid/GAGridMap.h"
+
+class AGAGridActor;
+struct FCellRef;
+
+
+// A particle filter over the grid: the alternative to a target's occupancy map (see UGATargetComponent::TrackerMode)
+// Instead of a probability per cell, the belief about where a hidden target is gets carried by a fixed number of
+// weighted particles, each with a position and a velocity in grid space (i.e. in cells, with cell (X, Y) covering
+// [X, X + 1) x [Y, Y + 1)). Memory and cost depend on the particle count alone, not on the size of the grid.
+//
+// Each step the particles move along their velocities, turning now and then and bouncing off non-traversable cells.
+// The ones standing in cells a perceiver can see get zero weight, and the rest are resampled back up to the full count.
+
+struct FGAParticleTracker
+{
+	FGAParticleTracker();
+
+	// Start over with Count particles in the cell at Position (world space), heading off at roughly Velocity (world
+	// space, per second) plus a random wander of up to WanderSpeed (world units per second)
+	void Observe(const AGAGridActor* Grid, const FVector& Position, const FVector& Velocity, int32 Count, float WanderSpeed);
+
+	// Move the particles on by DeltaTime seconds. Each particle picks a new heading TurnRate times per second on average
+	void Propagate(const AGAGridActor* Grid, float DeltaTime, float WanderSpeed, float TurnRate);
+
+	// Zero the weight of the particles in visible cells (VisibleCells is indexed by AGAGridActor::CellRefToIndex), then
+	// resample. If every particle is visible there's nothing left to go on, so they're left where they are.
+	// Returns the weight that was culled
+	float Cull(const AGAGridActor* Grid, const TBitArray<>& VisibleCells);
+
+	// The cell holding the most weight
+	bool GetMostLikelyCell(FCellRef& CellOut) const;
+
+	// Total weight of the particles in Box (in grid cell coordinates)
+	float GetWeightInBox(const FGridBox& Box) const;
+
+	// Add each particle's weight into its cell of Map
+	void Rasterize(FGAGridMap& Map) const;
+
+	void Reset();
+
+	int32 Num() const { return Positions.Num(); }
+
+	bool IsValid() const { return Positions.Num() > 0; }
+
+protected:
+	// Systematic resampling: Num() draws at evenly spaced points along the cumulative weights, so each particle gets
+	// copied in proportion to its weight. Weights come out uniform
+	void Resample();
+
+	FVector2f RandomHeading(float Speed);
+
+	// Cell of a grid space position
+	static FORCEINLINE FCellRef ToCell(const FVector2f& Position)
+	{
+		return FCellRef(FMath::FloorToInt32(Position.X), FMath::FloorToInt32(Position.Y));
+	}
+
+	// Grid space; velocities are in cells per second. Weights sum to 1
+	TArray<FVector2f> Positions;
+	TArray<FVector2f> Velocities;
+	TArray<float> Weights;
+
+	// Resampling scratch, kept between steps
+	TArray<FVector2f> ScratchPositions;
+	TArray<FVector2f> ScratchVelocities;
+
+	// GetMostLikelyCell scratch: (cell key, weight) per particle
+	mutable TArray<TPair<int64, float>> ScratchCellWeights;
+
+	FRandomStream Random;
+};
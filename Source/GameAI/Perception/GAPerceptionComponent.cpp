@@ -1,7 +1,9 @@
 #include "GAPerceptionComponent.h"
 #include "Kismet/GameplayStatics.h"
 #include "GAPerceptionSystem.h"
+#include "GAConeTestBatch.h"
 #include "GameAI/Grid/GAGridActor.h"
+#include "GameAI/Grid/GAGridVisibility.h"
 
 UGAPerceptionComponent::UGAPerceptionComponent(const FObjectInitializer& ObjectInitializer)
 	: Super(ObjectInitializer)
@@ -12,6 +14,7 @@ UGAPerceptionComponent::UGAPerceptionComponent(const FObjectInitializer& ObjectI
 	// Default vision parameters
 	VisionParameters.VisionAngle = 90.0f;
 	VisionParameters.VisionDistance = 1000.0;
+	RefreshVisionCache();
 }
 
 
@@ -19,10 +22,14 @@ void UGAPerceptionComponent::OnRegister()
 {
 	Super::OnRegister();
 
+	// (VisionParameters may have been loaded or edited since construction)
+	RefreshVisionCache();
+
 	UGAPerceptionSystem* PerceptionSystem = UGAPerceptionSystem::GetPerceptionSystem(this);
 	if (PerceptionSystem)
 	{
 		PerceptionSystem->RegisterPerceptionComponent(this);
+		RegisteredSystem = PerceptionSystem;
 	}
 }
 
@@ -35,6 +42,7 @@ void UGAPerceptionComponent::OnUnregister()
 	{
 		PerceptionSystem->UnregisterPerceptionComponent(this);
 	}
+	RegisteredSystem.Reset();
 }
 
 
@@ -68,17 +76,52 @@ APawn* UGAPerceptionComponent::GetOwnerPawn() const
 UGATargetComponent* UGAPerceptionComponent::GetCurrentTarget() const
 {
 	UGAPerceptionSystem* PerceptionSystem = UGAPerceptionSystem::GetPerceptionSystem(this);
+	if (!PerceptionSystem)
+	{
+		return NULL;
+	}
 
-	if (PerceptionSystem && PerceptionSystem->TargetComponents.Num() > 0)
+	// The known target I'm most aware of. Ties (typically several targets at full awareness) go to the one last known
+	// to be closest
+	const APawn* OwnerPawn = GetOwnerPawn();
+	UGATargetComponent* BestTarget = NULL;
+	float BestAwareness = -1.0f;
+	double BestDistSquared = UE_DOUBLE_BIG_NUMBER;
+
+	for (UGATargetComponent* TargetComponent : PerceptionSystem->TargetComponents)
 	{
-		UGATargetComponent* TargetComponent = PerceptionSystem->TargetComponents[0];
-		if (TargetComponent->IsKnown())
+		if (!TargetComponent || !TargetComponent->IsKnown())
+		{
+			continue;
+		}
+
+		FTargetData TargetData;
+		const float Awareness = GetTargetData(TargetComponent, TargetData) ? TargetData.Awareness : -1.0f;
+		const double DistSquared = OwnerPawn ? FVector::DistSquared(OwnerPawn->GetActorLocation(), TargetComponent->LastKnownState.Position) : 0.0;
+
+		if ((Awareness > BestAwareness) || ((Awareness == BestAwareness) && (DistSquared < BestDistSquared)))
 		{
-			return PerceptionSystem->TargetComponents[0];
+			BestTarget = TargetComponent;
+			BestAwareness = Awareness;
+			BestDistSquared = DistSquared;
 		}
 	}
 
-	return NULL;
+	return BestTarget;
+}
+
+bool UGAPerceptionComponent::HasHeardNoise(float MaxAge) const
+{
+	const UWorld* World = GetWorld();
+	return World && (LastHeardNoise.Time >= 0.0f) && (World->GetTimeSeconds() - LastHeardNoise.Time <= MaxAge);
+}
+
+void UGAPerceptionComponent::OnNoiseHeard(const FGAHeardNoise& Noise)
+{
+	if (!HasHeardNoise(HearingMemory) || (Noise.Loudness >= LastHeardNoise.Loudness))
+	{
+		LastHeardNoise = Noise;
+	}
 }
 
 bool UGAPerceptionComponent::HasTarget() const
@@ -92,11 +135,9 @@ bool UGAPerceptionComponent::GetCurrentTargetState(FTargetCache& TargetStateOut,
 	UGATargetComponent* Target = GetCurrentTarget();
 	if (Target)
 	{
-		const FTargetData* TargetData = TargetMap.Find(Target->TargetGuid);
-		if (TargetData)
+		if (GetTargetData(Target, TargetDataOut))
 		{
 			TargetStateOut = Target->LastKnownState;
-			TargetDataOut = *TargetData;
 			return true;
 		}
 
@@ -113,13 +154,13 @@ void UGAPerceptionComponent::GetAllTargetStates(bool OnlyKnown, TArray<FTargetCa
 		TArray<TObjectPtr<UGATargetComponent>>& TargetComponents = PerceptionSystem->GetAllTargetComponents();
 		for (UGATargetComponent* TargetComponent : TargetComponents)
 		{
-			const FTargetData* TargetData = TargetMap.Find(TargetComponent->TargetGuid);
-			if (TargetData)
+			FTargetData TargetData;
+			if (PerceptionSystem->GetTargetData(this, TargetComponent, TargetData))
 			{
 				if (!OnlyKnown || TargetComponent->IsKnown())
 				{
 					TargetCachesOut.Add(TargetComponent->LastKnownState);
-					TargetDatasOut.Add(*TargetData);
+					TargetDatasOut.Add(TargetData);
 				}
 			}
 		}
@@ -131,128 +172,201 @@ void UGAPerceptionComponent::TickComponent(float DeltaTime, enum ELevelTick Tick
 {
 	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
 
-	UpdateAllTargetData();
+	RefreshVisionCache();
+
+	// Normally the perception system decides which of my targets get updated this frame
+	UGAPerceptionSystem* PerceptionSystem = UGAPerceptionSystem::GetPerceptionSystem(this);
+	if (!PerceptionSystem || !PerceptionSystem->bScheduledPerception)
+	{
+		UpdateAllTargetData();
+	}
+}
+
+
+void UGAPerceptionComponent::RefreshVisionCache()
+{
+	VisionConeCos = FMath::Cos(FMath::DegreesToRadians(VisionParameters.VisionAngle * 0.5f));
 }
 
 
 void UGAPerceptionComponent::UpdateAllTargetData()
 {
+	// Nothing to see from, so leave my awareness as it is
+	const APawn* OwnerPawn = GetOwnerPawn();
+	if (!OwnerPawn)
+	{
+		return;
+	}
+
 	UGAPerceptionSystem* PerceptionSystem = UGAPerceptionSystem::GetPerceptionSystem(this);
 	if (PerceptionSystem)
 	{
-		TArray<TObjectPtr<UGATargetComponent>>& TargetComponents = PerceptionSystem->GetAllTargetComponents();
-		for (UGATargetComponent* TargetComponent : TargetComponents)
+		TArray<UGATargetComponent*> TargetComponents;
+		PerceptionSystem->GatherTargetCandidates(this, TargetComponents);
+
+		// Cone test the lot in one go, then trace to the ones that passed
+		TBitArray<> InCone;
+		PerceptionSystem->TestVisionCones(this, TargetComponents, InCone);
+
+		for (int32 Index = 0; Index < TargetComponents.Num(); Index++)
 		{
-			UpdateTargetData(TargetComponent);
+			UGATargetComponent* TargetComponent = TargetComponents[Index];
+			const bool bHasLOS = InCone[Index] &&
+				TraceTargetLos(TargetComponent, OwnerPawn->GetActorLocation(), TargetComponent->GetOwner()->GetActorLocation());
+			ApplyTargetLos(TargetComponent, bHasLOS);
 		}
 	}
 }
 
 void UGAPerceptionComponent::UpdateTargetData(UGATargetComponent* TargetComponent)
+{
+	// TODO PART 3
+	// 
+	// - Update TargetData->bClearLOS
+	//		Use this.VisionParameters to determine whether the target is within the vision cone or not 
+	//		(and ideally do so before you cast a ray towards it)
+	// - Update TargetData->Awareness
+	//		On ticks when the AI has a clear LOS, the Awareness should grow
+	//		On ticks when the AI does not have a clear LOS, the Awareness should decay
+	//
+	// Awareness should be clamped to the range [0, 1]
+	// You can add parameters to the UGAPerceptionComponent to control the speed at which awareness rises and falls
+
+	// YOUR CODE HERE
+	// Get world and check it's valid
+	UWorld* World = GetWorld();
+	if (!World) return;
+
+	// The cheap tests first, then a blocking trace if the target is in the cone at all.
+	// (The perception system can instead batch these traces up and run them asynchronously, see
+	// UGAPerceptionSystem::bAsyncVisibilityTraces. It goes through the same two halves)
+	FVector TraceStart, TraceEnd;
+	const bool bHasLOS = IsTargetInVisionCone(TargetComponent, TraceStart, TraceEnd) && TraceTargetLos(TargetComponent, TraceStart, TraceEnd);
+
+	ApplyTargetLos(TargetComponent, bHasLOS);
+}
+
+
+bool UGAPerceptionComponent::TraceTargetLos(const UGATargetComponent* TargetComponent, const FVector& TraceStart, const FVector& TraceEnd) const
+{
+	UWorld* World = GetWorld();
+	if (!World)
+	{
+		return false;
+	}
+
+	bool bHasLOS = false;
+	UGAPerceptionSystem* PerceptionSystem = RegisteredSystem.Get();
+	if (PerceptionSystem && (PerceptionSystem->FindCachedLos(this, TargetComponent, TraceStart, TraceEnd, bHasLOS) ||
+		PerceptionSystem->FindSquadLos(this, TargetComponent, TraceStart, TraceEnd, bHasLOS)))
+	{
+		return bHasLOS;
+	}
+
+	FHitResult HitResult;
+	bHasLOS = !World->LineTraceSingleByChannel(HitResult, TraceStart, TraceEnd, ECC_Visibility, GetLosQueryParams(TargetComponent));
+	if (PerceptionSystem)
+	{
+		PerceptionSystem->StoreLos(this, TargetComponent, TraceStart, TraceEnd, World->GetTimeSeconds(), bHasLOS);
+	}
+	return bHasLOS;
+}
+
+
+bool UGAPerceptionComponent::IsTargetInVisionCone(const UGATargetComponent* TargetComponent, FVector& TraceStartOut, FVector& TraceEndOut) const
 {
 	// REMEMBER: the UGAPerceptionComponent is going to be attached to the controller, not the pawn. So we call this special accessor to 
 	// get the pawn that our controller is controlling
 	APawn* OwnerPawn = GetOwnerPawn();
-	if (OwnerPawn == NULL)
+	if (!OwnerPawn || !TargetComponent || !TargetComponent->GetOwner())
 	{
-		return;
+		return false;
 	}
 
-	FTargetData *TargetData = TargetMap.Find(TargetComponent->TargetGuid);
-	if (TargetData == NULL)		// If we don't already have a target data for the given target component, add it
+	// Get Locations of AI and target
+	FVector AI_Location = OwnerPawn->GetActorLocation();
+	FVector Target_Location = TargetComponent->GetOwner()->GetActorLocation();
+	FVector ToTarget = (Target_Location - AI_Location);
+
+	// Compute squared distance (avoiding unnecessary sqrt computations)
+	// If the target is outside the vision range, immediately lose LOS
+	float DistSquared = ToTarget.SizeSquared();
+	float VisionDistSquared = VisionParameters.VisionDistance * VisionParameters.VisionDistance;
+	if (DistSquared > VisionDistSquared)
 	{
-		FTargetData NewTargetData;
-		FGuid TargetGuid = TargetComponent->TargetGuid;
-		TargetData = &TargetMap.Add(TargetGuid, NewTargetData);
+		return false;
 	}
 
-	if (TargetData)
+	// Check field of view against the cached cos(angle / 2), without normalizing (same test as TestVisibility)
+	float Dot = FVector::DotProduct(ToTarget, OwnerPawn->GetActorForwardVector());
+	if (Dot * FMath::Abs(Dot) < VisionConeCos * FMath::Abs(VisionConeCos) * DistSquared)
 	{
-		// TODO PART 3
-		// 
-		// - Update TargetData->bClearLOS
-		//		Use this.VisionParameters to determine whether the target is within the vision cone or not 
-		//		(and ideally do so before you cast a ray towards it)
-		// - Update TargetData->Awareness
-		//		On ticks when the AI has a clear LOS, the Awareness should grow
-		//		On ticks when the AI does not have a clear LOS, the Awareness should decay
-		//
-		// Awareness should be clamped to the range [0, 1]
-		// You can add parameters to the UGAPerceptionComponent to control the speed at which awareness rises and falls
-
-		// YOUR CODE HERE
-		// Get world and check it's valid
-		UWorld* World = GetWorld();
-		if (!World) return;
-
-		// Get Locations of AI and target
-		FVector AI_Location = OwnerPawn->GetActorLocation();
-		FVector Target_Location = TargetComponent->GetOwner()->GetActorLocation();
-		FVector ToTarget = (Target_Location - AI_Location);
-		
-		// Compute squared distance (avoiding unnecessary sqrt computations)
-		float DistSquared = ToTarget.SizeSquared();
-		float VisionDistSquared = VisionParameters.VisionDistance * VisionParameters.VisionDistance;
-
-		// If the target is outside the vision range, immediately lose LOS
-		if (DistSquared > VisionDistSquared)
-		{
-			TargetData->bClearLos = false;
-			TargetData->Awareness = FMath::Clamp(TargetData->Awareness - AwarenessDecayRate * World->GetDeltaSeconds(), 0.0f, 1.0f);
-			return;
-		}
+		return false;
+	}
 
-		// Normalize direction vector and check field of view using dot product
-		ToTarget.Normalize();
-		float DotProduct = FVector::DotProduct(ToTarget, OwnerPawn->GetActorForwardVector());
+	TraceStartOut = AI_Location;
+	TraceEndOut = Target_Location;
+	return true;
+}
 
-		// Convert FOV to cos(angle) for efficient comparison
-		float VisionConeCos = FMath::Cos(FMath::DegreesToRadians(VisionParameters.VisionAngle * 0.5f));
-		bool bIsInVisionCone = DotProduct >= VisionConeCos;
 
-		// Perform Line of Sight (LOS) check
-		bool bHasLOS = false;
-		if (bIsInVisionCone)
-		{
-			FHitResult HitResult;
-			FCollisionQueryParams QueryParams;
-			QueryParams.AddIgnoredActor(OwnerPawn); // Ignore AI itself
-			QueryParams.AddIgnoredActor(TargetComponent->GetOwner()); // Ignore the target itself
-
-			bHasLOS = !World->LineTraceSingleByChannel(
-				HitResult,
-				AI_Location,
-				Target_Location,
-				ECC_Visibility,
-				QueryParams
-			);
-		}
+FCollisionQueryParams UGAPerceptionComponent::GetLosQueryParams(const UGATargetComponent* TargetComponent) const
+{
+	FCollisionQueryParams QueryParams;
+	QueryParams.AddIgnoredActor(GetOwnerPawn()); // Ignore AI itself
+	QueryParams.AddIgnoredActor(TargetComponent->GetOwner()); // Ignore the target itself
+	return QueryParams;
+}
 
-		// Update LOS status
-		TargetData->bClearLos = bHasLOS;
 
-		// Awareness Calculation
-		if (bHasLOS)
-		{
-			// Increase awareness if LOS is clear
-			TargetData->Awareness = FMath::Clamp(TargetData->Awareness + AwarenessIncreaseRate * World->GetDeltaSeconds(), 0.0f, 1.0f);
-		}
-		else
-		{
-			// Decrease awareness if LOS is lost
-			TargetData->Awareness = FMath::Clamp(TargetData->Awareness - AwarenessDecayRate * World->GetDeltaSeconds(), 0.0f, 1.0f);
-		}
+void UGAPerceptionComponent::ApplyTargetLos(UGATargetComponent* TargetComponent, bool bHasLOS)
+{
+	UWorld* World = GetWorld();
+	if (!World || !TargetComponent)
+	{
+		return;
+	}
 
-		// Debugging logs (optional)
-		UE_LOG(LogTemp, Warning, TEXT("Target Awareness: %f, LOS: %s, Distance: %f"),
-			TargetData->Awareness, TargetData->bClearLos ? TEXT("TRUE") : TEXT("FALSE"), FMath::Sqrt(DistSquared));
+	UGAPerceptionSystem* PerceptionSystem = RegisteredSystem.Get();
+	if (!PerceptionSystem)
+	{
+		return;
+	}
+
+	FGAAwarenessTable& AwarenessTable = PerceptionSystem->GetAwarenessTable();
+	if (AwarenessTable.IsValidPair(PerceptionSlot, TargetComponent->TargetSlot))
+	{
+		// Integrated over the time since this pair was last updated. That's a frame when every pair is updated every
+		// frame, but the perception system's scheduler can leave a pair for several
+		AwarenessTable.Integrate(AwarenessTable.GetIndex(PerceptionSlot, TargetComponent->TargetSlot), bHasLOS,
+			World->GetTimeSeconds(), World->GetDeltaSeconds(), AwarenessIncreaseRate, AwarenessDecayRate);
 	}
 }
 
 
-const FTargetData* UGAPerceptionComponent::GetTargetData(FGuid TargetGuid) const
+bool UGAPerceptionComponent::GetTargetData(const UGATargetComponent* TargetComponent, FTargetData& TargetDataOut) const
 {
-	return TargetMap.Find(TargetGuid);
+	const UGAPerceptionSystem* PerceptionSystem = RegisteredSystem.Get();
+	return PerceptionSystem && PerceptionSystem->GetTargetData(this, TargetComponent, TargetDataOut);
+}
+
+TMap<FGuid, FTargetData> UGAPerceptionComponent::GetTargetMap() const
+{
+	TMap<FGuid, FTargetData> Result;
+
+	UGAPerceptionSystem* PerceptionSystem = RegisteredSystem.Get();
+	if (PerceptionSystem)
+	{
+		for (UGATargetComponent* TargetComponent : PerceptionSystem->GetAllTargetComponents())
+		{
+			FTargetData TargetData;
+			if (TargetComponent && GetTargetData(TargetComponent, TargetData))
+			{
+				Result.Add(TargetComponent->TargetGuid, TargetData);
+			}
+		}
+	}
+	return Result;
 }
 
 bool UGAPerceptionComponent::TestVisibility(const FCellRef& Cell) const
@@ -263,7 +377,7 @@ bool UGAPerceptionComponent::TestVisibility(const FCellRef& Cell) const
 
 	// Get the Grid Actor through the target component
 	const AGAGridActor* Grid = TargetComponent->GetGridActor();
-	if (!Grid) return false;
+	if (!Grid || !Grid->IsCellRefInBounds(Cell)) return false;
 
 	APawn* OwnerPawn = GetOwnerPawn();
 	if (!OwnerPawn) return false;
@@ -271,29 +385,53 @@ bool UGAPerceptionComponent::TestVisibility(const FCellRef& Cell) const
 	// Get AI position and cell position
 	FVector AIPosition = OwnerPawn->GetActorLocation();
 	FVector CellPosition = Grid->GetCellPosition(Cell);
+	FVector ToCell = CellPosition - AIPosition;
 
-	// Calculate direction to the target cell
-	FVector DirectionToCell = (CellPosition - AIPosition).GetSafeNormal();
-	FVector ForwardVector = OwnerPawn->GetActorForwardVector();
-
-	// Compute dot product to check if the cell is within the vision cone
-	float DotProduct = FVector::DotProduct(ForwardVector, DirectionToCell);
-	float VisionAngleCosine = FMath::Cos(FMath::DegreesToRadians(VisionParameters.VisionAngle * 0.5f));
+	// Ensure the cell is within vision distance (cheapest test first)
+	float DistSquared = ToCell.SizeSquared();
+	if (DistSquared > FMath::Square(VisionParameters.VisionDistance))
+	{
+		return false;
+	}
 
 	// Check if within vision cone
-	if (DotProduct < VisionAngleCosine)
+	// i.e. Dot(Forward, ToCell / |ToCell|) >= cos(angle / 2), without the square root
+	float Dot = FVector::DotProduct(OwnerPawn->GetActorForwardVector(), ToCell);
+	if ((Dot < 0.0f && VisionConeCos >= 0.0f) ||
+		(Dot * FMath::Abs(Dot) < VisionConeCos * FMath::Abs(VisionConeCos) * DistSquared))
 	{
 		return false;
 	}
 
-	// Ensure the cell is within vision distance
-	float DistanceToCell = FVector::Dist(AIPosition, CellPosition);
-	if (DistanceToCell > VisionParameters.VisionDistance)
+	return TestCellOcclusion(Grid, OwnerPawn, Cell);
+}
+
+bool UGAPerceptionComponent::TestCellOcclusion(const AGAGridActor* Grid, const APawn* OwnerPawn, const FCellRef& Cell) const
+{
+	FVector AIPosition = OwnerPawn->GetActorLocation();
+	FVector CellPosition = Grid->GetCellPosition(Cell);
+
+	// Look the cell up in the grid's baked PVS, or walk the grid's occluders between us and the cell
+	if (Grid->bHasOccluderData)
 	{
-		return false;
+		FCellRef AICell = Grid->GetCellRef(AIPosition, true);
+		bool bVisible = (Grid->HasPVS() && (AICell.Distance(Cell) <= Grid->GetPVSRadius())) ?
+			Grid->IsInPVS(AICell, Cell) :
+			FGAGridVisibility::HasLineOfSight(Grid, AICell, Cell);
+
+		if (!bVisible)
+		{
+			return false;
+		}
+
+		if (!bRefineVisibilityWithTrace)
+		{
+			return true;
+		}
 	}
 
 	// Perform a line trace to ensure no obstacles block the vision
+	// (only as a refinement, or for grids that haven't had their occluders baked yet)
 	FHitResult HitResult;
 	FCollisionQueryParams QueryParams;
 	QueryParams.AddIgnoredActor(OwnerPawn);
@@ -306,3 +444,83 @@ bool UGAPerceptionComponent::TestVisibility(const FCellRef& Cell) const
 	return !bHit;
 }
 
+
+bool UGAPerceptionComponent::GetVisionCone(const AGAGridActor* Grid, FGAVisionCone& ConeOut) const
+{
+	APawn* OwnerPawn = GetOwnerPawn();
+	if (!OwnerPawn || !Grid)
+	{
+		return false;
+	}
+
+	FCellRef AICell = Grid->GetCellRef(OwnerPawn->GetActorLocation());
+	if (!AICell.IsValid())
+	{
+		return false;
+	}
+
+	// The grid actor can be rotated, so bring the facing direction into its space
+	FVector LocalForward = Grid->GetActorTransform().InverseTransformVectorNoScale(OwnerPawn->GetActorForwardVector());
+
+	ConeOut.Init(AICell.X, AICell.Y, FVector2f(FVector2D(LocalForward).GetSafeNormal()), VisionParameters.VisionAngle,
+		VisionParameters.VisionDistance / Grid->CellScale, Grid->XCount, Grid->YCount);
+	return true;
+}
+
+bool UGAPerceptionComponent::CanUseGridVisibility(const AGAGridActor* Grid) const
+{
+	return Grid && Grid->bHasOccluderData && !bRefineVisibilityWithTrace;
+}
+
+void UGAPerceptionComponent::ComputeVisibleCells(const AGAGridActor* Grid, TBitArray<>& VisibleInOut) const
+{
+	if (!Grid)
+	{
+		return;
+	}
+
+	FGAVisionCone Cone;
+	bool bHasCone = GetVisionCone(Grid, Cone);
+
+	if (CanUseGridVisibility(Grid))
+	{
+		if (bHasCone)
+		{
+			FGAGridVisibility::ComputeConeVisibility(Grid, Cone, VisibleInOut);
+		}
+		return;
+	}
+
+	const APawn* OwnerPawn = GetOwnerPawn();
+	if (!OwnerPawn)
+	{
+		return;
+	}
+
+	// Slow path: test every cell of the cone's bounding box (or of the whole grid, if we're standing off it).
+	// The range and cone tests run a row at a time, so only the cells that pass get the (expensive) occlusion test
+	const FVector AIPosition = OwnerPawn->GetActorLocation();
+	const FVector Forward = OwnerPawn->GetActorForwardVector();
+	FGridBox Box = bHasCone ? FGridBox(Cone.MinX, Cone.MaxX, Cone.MinY, Cone.MaxY) : FGridBox(0, Grid->XCount - 1, 0, Grid->YCount - 1);
+
+	FGAConeTestBatch RowBatch;
+	TBitArray<> RowInCone;
+	for (int32 Y = Box.MinY; Y <= Box.MaxY; Y++)
+	{
+		RowBatch.Reset(AIPosition);
+		for (int32 X = Box.MinX; X <= Box.MaxX; X++)
+		{
+			RowBatch.Add(Grid->GetCellPosition(FCellRef(X, Y)));
+		}
+
+		RowBatch.Test(Forward, VisionConeCos, VisionParameters.VisionDistance, RowInCone);
+		for (TConstSetBitIterator<> It(RowInCone); It; ++It)
+		{
+			FCellRef Cell(Box.MinX + It.GetIndex(), Y);
+			if (TestCellOcclusion(Grid, OwnerPawn, Cell))
+			{
+				VisibleInOut[Grid->CellRefToIndex(Cell)] = true;
+			}
+		}
+	}
+}
@@ -3,11 +3,14 @@
 #include "CoreMinimal.h"
 #include "Components/ActorComponent.h"
 #include "GATargetComponent.h"
+#include "GameAI/Grid/GAGridVisibility.h"
 #include "GAPerceptionComponent.generated.h"
 
+class UGAPerceptionSystem;
 
 // FTargetData represents the AI's awareness of the target.
 // Basically it stored current LOS info and the awareness gauge.
+// The live values are kept by the perception system (see FGAAwarenessTable); this is a snapshot of one pair's entry.
 // Note that it does NOT store last known position/velocity. That information
 // is stored in the target itself. 
 USTRUCT(BlueprintType)
@@ -15,7 +18,7 @@ struct FTargetData
 {
 	GENERATED_USTRUCT_BODY()
 
-	FTargetData() : bClearLos(false), Awareness(0.0f) {}
+	FTargetData() : bClearLos(false), Awareness(0.0f), LastUpdateTime(-1.0f) {}
 
 	// The last LOS check of this target
 	// Note: even if the LOS is clear, it doesn't mean the AI is aware of the target (yet)!
@@ -25,6 +28,12 @@ struct FTargetData
 	UPROPERTY(BlueprintReadOnly)
 	float Awareness;
 
+	// World time of the last update (negative if there hasn't been one yet)
+	// Pairs aren't necessarily updated every frame (see UGAPerceptionSystem::bScheduledPerception), so awareness is
+	// integrated over the time since this
+	UPROPERTY(BlueprintReadOnly)
+	float LastUpdateTime;
+
 };
 
 
@@ -45,6 +54,35 @@ struct FVisionParameters
 };
 
 
+// A noise the AI heard (see UGAPerceptionSystem::ReportNoise)
+USTRUCT(BlueprintType)
+struct FGAHeardNoise
+{
+	GENERATED_USTRUCT_BODY()
+
+	FGAHeardNoise() : Location(FVector::ZeroVector), Loudness(0.0f), PathDistance(0.0f), Time(-1.0f) {}
+
+	UPROPERTY(BlueprintReadOnly)
+	FVector Location;
+
+	// Whoever made it (may be null)
+	UPROPERTY(BlueprintReadOnly)
+	TObjectPtr<AActor> Instigator;
+
+	// 1 right at the source, falling off to 0 at the edge of its range
+	UPROPERTY(BlueprintReadOnly)
+	float Loudness;
+
+	// How far the sound travelled to get to me, around walls
+	UPROPERTY(BlueprintReadOnly)
+	float PathDistance;
+
+	// World time it was heard (negative if nothing has been heard yet)
+	UPROPERTY(BlueprintReadOnly)
+	float Time;
+};
+
+
 UCLASS(BlueprintType, Blueprintable, meta = (BlueprintSpawnableComponent))
 class UGAPerceptionComponent : public UActorComponent
 {
@@ -84,11 +122,9 @@ class UGAPerceptionComponent : public UActorComponent
 	UPROPERTY(BlueprintReadWrite, EditAnywhere)
 	FVisionParameters VisionParameters;
 
-	// A map from TargetComponent's TargetGuid to target data
-	// This allows each individual perceiving AI to store a little chunk of data for each perceivable target.
-
-	UPROPERTY(BlueprintReadOnly)
-	TMap<FGuid, FTargetData> TargetMap;
+	// My row in the perception system's awareness table, which holds my data for each perceivable target
+	// Assigned when I register with the perception system (INDEX_NONE until then)
+	int32 PerceptionSlot = INDEX_NONE;
 
 	// Speed at which awareness rises when AI has LOS
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Perception")
@@ -98,11 +134,93 @@ class UGAPerceptionComponent : public UActorComponent
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Perception")
 	float AwarenessDecayRate = 0.2f;
 
+	// TestVisibility answers from the grid's baked occluders. If this is set, cells the grid says are visible
+	// also get confirmed with a physics trace (slow -- one trace per visible cell)
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Perception")
+	bool bRefineVisibilityWithTrace = false;
+
+	// Perceivers in the same squad share their LOS results (see UGAPerceptionSystem::bShareSquadLos). None: no squad
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Perception")
+	FName Squad;
+
+	// Hearing ----------
+
+	// Scales the range of every noise I might hear (0: deaf)
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Perception", meta = (ClampMin = "0.0"))
+	float HearingSensitivity = 1.0f;
+
+	// The loudest noise I've heard lately (a louder one replaces it, as does any once it's HearingMemory seconds old)
+	UPROPERTY(BlueprintReadOnly, Category = "Perception")
+	FGAHeardNoise LastHeardNoise;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Perception", meta = (ClampMin = "0.0"))
+	float HearingMemory = 2.0f;
+
+	// Awareness of a noise's instigator (if it's a target) that hearing it at full loudness adds. Hearing alone never
+	// quite gets a target to full awareness: that still takes a sighting
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Perception", meta = (ClampMin = "0.0", ClampMax = "1.0"))
+	float HearingAwarenessGain = 0.5f;
+
+	// Have I heard anything in the last MaxAge seconds?
+	UFUNCTION(BlueprintCallable, BlueprintPure)
+	bool HasHeardNoise(float MaxAge) const;
+
+	// Called by the perception system for each noise that reaches me
+	void OnNoiseHeard(const FGAHeardNoise& Noise);
+
 	void UpdateAllTargetData();
 	void UpdateTargetData(UGATargetComponent* TargetComponent);
 
-	// Return the FTargetData for the given target
-	const FTargetData *GetTargetData(FGuid TargetGuid) const;
+	// The two halves of UpdateTargetData, for callers that run the trace themselves (e.g. asynchronously):
+	// Is the target within my vision distance and cone? If so, a LOS trace should run from TraceStartOut to TraceEndOut
+	bool IsTargetInVisionCone(const UGATargetComponent* TargetComponent, FVector& TraceStartOut, FVector& TraceEndOut) const;
+
+	// Query params for that trace
+	FCollisionQueryParams GetLosQueryParams(const UGATargetComponent* TargetComponent) const;
+
+	// Run that trace right away (unless the perception system has a recent enough result cached). True if it's clear
+	bool TraceTargetLos(const UGATargetComponent* TargetComponent, const FVector& TraceStart, const FVector& TraceEnd) const;
+
+	// Record the LOS result, and integrate awareness over the time since the pair's last update
+	void ApplyTargetLos(UGATargetComponent* TargetComponent, bool bHasLOS);
+
+	// Get my FTargetData for the given target. Returns false if I haven't updated it yet
+	bool GetTargetData(const UGATargetComponent* TargetComponent, FTargetData& TargetDataOut) const;
+
+	// A map from TargetComponent's TargetGuid to my target data, for every target I've updated
+	// (what the TargetMap property used to hold, now built from the perception system's awareness table)
+	UFUNCTION(BlueprintCallable, BlueprintPure)
+	TMap<FGuid, FTargetData> GetTargetMap() const;
 
 	bool TestVisibility(const FCellRef& Cell) const;
+
+	float GetVisionConeCos() const { return VisionConeCos; }
+
+	// Recompute VisionConeCos from VisionParameters
+	void RefreshVisionCache();
+
+	// My vision cone in the grid's cell space. Returns false if I have no pawn, or it's off the grid
+	bool GetVisionCone(const AGAGridActor* Grid, FGAVisionCone& ConeOut) const;
+
+	// Can what I see be worked out from the grid alone (FGAGridVisibility::ComputeConeVisibility on my cone)?
+	// If not, ComputeVisibleCells has to fall back to physics traces
+	bool CanUseGridVisibility(const AGAGridActor* Grid) const;
+
+	// Set the bit (indexed by AGAGridActor::CellRefToIndex) of every cell I can currently see.
+	// VisibleInOut must be Grid->GetCellIndexCount() long; bits that are already set are left alone.
+	// Reads the grid's baked PVS if it reaches far enough, else shadowcasts over the grid's baked occluders,
+	// else falls back to TestVisibility on every cell of the cone's bounding box
+	void ComputeVisibleCells(const AGAGridActor* Grid, TBitArray<>& VisibleInOut) const;
+
+protected:
+	// The system I registered with (and so whose awareness table I write to)
+	TWeakObjectPtr<UGAPerceptionSystem> RegisteredSystem;
+
+	// Cosine of half the vision angle, so the cone test doesn't need any trig
+	// Refreshed on register, every tick, and by the perception system before it reads it, since VisionParameters can
+	// be changed from blueprint at any time
+	float VisionConeCos;
+
+	// The second half of TestVisibility, for a cell that's already known to be in range and in the cone
+	bool TestCellOcclusion(const AGAGridActor* Grid, const APawn* OwnerPawn, const FCellRef& Cell) const;
 };
\ No newline at end of file
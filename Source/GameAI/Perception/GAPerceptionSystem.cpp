@@ -1,36 +1,962 @@
 #include "GAPerceptionSystem.h"
 #include "Kismet/GameplayStatics.h"
 #include "GameFramework/GameModeBase.h"
+#include "Engine/World.h"
+#include "GameAI/Grid/GAGridActor.h"
+#include "GameAI/Grid/GAGridVisibility.h"
+#include "Async/ParallelFor.h"
 
 UGAPerceptionSystem::UGAPerceptionSystem(const FObjectInitializer& ObjectInitializer)
 	: Super(ObjectInitializer)
 {
+	// Ticks to run the perception scheduler
+	PrimaryComponentTick.bCanEverTick = true;
+}
+
+
+void UGAPerceptionSystem::TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	if (bScheduledPerception)
+	{
+		RunPerceptionPhase();
+	}
+
+	UpdateOccupancyBank(DeltaTime);
+}
+
+
+AGAGridActor* UGAPerceptionSystem::GetGridActor() const
+{
+	AGAGridActor* Result = GridActor.Get();
+	if (!Result)
+	{
+		Result = Cast<AGAGridActor>(UGameplayStatics::GetActorOfClass(this, AGAGridActor::StaticClass()));
+		GridActor = Result;
+	}
+	return Result;
+}
+
+
+void UGAPerceptionSystem::ReportNoise(AActor* Instigator, const FVector& Location, float Range)
+{
+	const AGAGridActor* Grid = GetGridActor();
+	const UWorld* World = GetWorld();
+	if (!Grid || !World || (Range <= 0.0f))
+	{
+		return;
+	}
+
+	// Flood as far as the keenest ear needs
+	float MaxSensitivity = 0.0f;
+	for (const UGAPerceptionComponent* PerceptionComponent : PerceptionComponents)
+	{
+		if (PerceptionComponent)
+		{
+			MaxSensitivity = FMath::Max(MaxSensitivity, PerceptionComponent->HearingSensitivity);
+		}
+	}
+
+	// The field may have been flooded from another cell of the bucket, in which case SourceOffset is the path distance
+	// between the two
+	const FCellRef SourceCell = Grid->GetCellRef(Location);
+	float SourceOffset = 0.0f;
+	const FGANoiseField* Field = (MaxSensitivity > 0.0f) ?
+		NoiseFields.FindOrBuild(Grid, SourceCell, Range * MaxSensitivity, NoiseFieldCacheSize, NoiseFieldBucketCells, SourceOffset) : nullptr;
+	if (!Field)
+	{
+		return;
+	}
+
+	UGATargetComponent* TargetComponent = Instigator ? Instigator->FindComponentByClass<UGATargetComponent>() : nullptr;
+	if (TargetComponent && (TargetComponent->TargetSlot == INDEX_NONE))
+	{
+		TargetComponent = nullptr;
+	}
+	bool bHeard = false;
+
+	FGAHeardNoise Noise;
+	Noise.Location = Location;
+	Noise.Instigator = Instigator;
+	Noise.Time = World->GetTimeSeconds();
+
+	for (UGAPerceptionComponent* PerceptionComponent : PerceptionComponents)
+	{
+		const APawn* OwnerPawn = PerceptionComponent ? PerceptionComponent->GetOwnerPawn() : nullptr;
+		if (!OwnerPawn || (OwnerPawn == Instigator) || (PerceptionComponent->HearingSensitivity <= 0.0f))
+		{
+			continue;
+		}
+
+		const FCellRef ListenerCell = Grid->GetCellRef(OwnerPawn->GetActorLocation());
+		if (!ListenerCell.IsValid())
+		{
+			continue;
+		}
+
+		const float HeardRange = Range * PerceptionComponent->HearingSensitivity;
+		const float Distance = Field->GetDistance(ListenerCell) + SourceOffset;
+		if (Distance <= HeardRange)
+		{
+			Noise.PathDistance = Distance;
+			Noise.Loudness = 1.0f - (Distance / HeardRange);
+			PerceptionComponent->OnNoiseHeard(Noise);
+			bHeard = true;
+
+			if (TargetComponent && AwarenessTable.IsValidPair(PerceptionComponent->PerceptionSlot, TargetComponent->TargetSlot))
+			{
+				AwarenessTable.AddAwareness(AwarenessTable.GetIndex(PerceptionComponent->PerceptionSlot, TargetComponent->TargetSlot),
+					PerceptionComponent->HearingAwarenessGain * Noise.Loudness, 1.0f - UE_KINDA_SMALL_NUMBER, Noise.Time);
+			}
+		}
+	}
+
+	// Somebody now has a better idea of where a hidden target is than its tracker does
+	if (bHeard && TargetComponent && (TargetComponent->LastKnownState.State == GATS_Hidden))
+	{
+		if ((TargetComponent->TrackerMode == GATTM_OccupancyMap) && OccupancyBank.IsValid())
+		{
+			OccupancyBank.Observe(TargetComponent->TargetSlot, Grid->GetCellRef(Location, true));
+		}
+		TargetComponent->ObserveNoise(Location);
+	}
+}
+
+
+void UGAPerceptionSystem::UpdateOccupancyBank(float DeltaTime)
+{
+	const AGAGridActor* Grid = nullptr;
+	for (UGATargetComponent* TargetComponent : TargetComponents)
+	{
+		if (TargetComponent && (TargetComponent->TrackerMode == GATTM_OccupancyMap))
+		{
+			Grid = TargetComponent->GetGridActor();
+			if (Grid)
+			{
+				break;
+			}
+		}
+	}
+
+	if (!Grid)
+	{
+		// Nobody's using it
+		if (OccupancyBank.IsValid())
+		{
+			OccupancyBank.Reset();
+		}
+		OccupancyPendingTime = 0.0f;
+		return;
+	}
+
+	// Pick up the last run's result, if it's done. Readers never wait: until then they see the previous one
+	OccupancyBank.Publish();
+	OccupancyBank.Prepare(Grid, NumTargetSlots, OccupancyDiffusionRate);
+
+	// Same rules as a private map: a sighting puts all the probability on the target's cell, and a target that's
+	// known but out of sight loses whatever the perceivers can see with every step. Both then diffuse
+	// (Observations are queued by the bank until the next launch)
+	TBitArray<> CullChannels(false, NumTargetSlots);
+	bool bAnyKnown = false;
+	bool bAnyCull = false;
+	for (UGATargetComponent* TargetComponent : TargetComponents)
+	{
+		if (!TargetComponent || (TargetComponent->TrackerMode != GATTM_OccupancyMap) || (TargetComponent->TargetSlot == INDEX_NONE))
+		{
+			continue;
+		}
+
+		const AActor* Owner = TargetComponent->GetOwner();
+		if (Owner && (GetMaxAwareness(TargetComponent) >= 1.0f))
+		{
+			OccupancyBank.Observe(TargetComponent->TargetSlot, Grid->GetCellRef(Owner->GetActorLocation(), true));
+			bAnyKnown = true;
+		}
+		else if (TargetComponent->IsKnown())
+		{
+			CullChannels[TargetComponent->TargetSlot] = true;
+			bAnyKnown = true;
+			bAnyCull = true;
+		}
+	}
 
+	// Nothing to simulate until someone's been seen
+	if (!bAnyKnown && !OccupancyBank.HasPendingCommands())
+	{
+		OccupancyPendingTime = 0.0f;
+		return;
+	}
+
+	OccupancyPendingTime += DeltaTime;
+	if (OccupancyBank.IsBusy())
+	{
+		return;
+	}
 
+	const int32 Steps = FGAOccupancySimulation::ConsumeFixedSteps(OccupancyPendingTime, OccupancyStepRate, MaxOccupancyStepsPerFrame);
+	if ((Steps == 0) && !OccupancyBank.HasPendingCommands())
+	{
+		return;
+	}
+
+	// Snapshot the perceivers' view now: the worker can't go back to us for it
+	TBitArray<> VisibleCells;
+	if (bAnyCull && (Steps > 0))
+	{
+		VisibleCells = GetFrameVisibility(Grid);
+	}
+	OccupancyBank.Launch(Steps, MoveTemp(VisibleCells), MoveTemp(CullChannels), Grid->GetCellIndexer());
 }
 
 
+float UGAPerceptionSystem::GetPairPriority(const UGAPerceptionComponent* PerceptionComponent, const UGATargetComponent* TargetComponent, float Now) const
+{
+	// A perceiver without a pawn can't update anything, so don't let it eat into the budget
+	// (Reads this frame's perceiver views and target positions rather than the actors, so it's safe on worker threads)
+	const int32 PerceptionSlot = PerceptionComponent->PerceptionSlot;
+	const int32 TargetSlot = TargetComponent->TargetSlot;
+	if (!PerceiverHasView.IsValidIndex(PerceptionSlot) || !PerceiverHasView[PerceptionSlot] ||
+		!TargetSlotHasPosition.IsValidIndex(TargetSlot) || !TargetSlotHasPosition[TargetSlot])
+	{
+		return -1.0f;
+	}
+
+	if (!AwarenessTable.IsValidPair(PerceptionSlot, TargetSlot))
+	{
+		return -1.0f;
+	}
+
+	const int32 Index = AwarenessTable.GetIndex(PerceptionSlot, TargetSlot);
+	if (!AwarenessTable.HasEntry(Index))
+	{
+		return UE_MAX_FLT;
+	}
+
+	float Priority = FMath::Max(Now - AwarenessTable.LastUpdateTime[Index], 0.0f);
+	Priority *= 1.0f + AwarenessPriorityWeight * AwarenessTable.Awareness[Index];
+
+	if (PerceiverRanges[PerceptionSlot] > 0.0f)
+	{
+		const float Distance = FVector::Dist(PerceiverOrigins[PerceptionSlot], TargetSlotPositions[TargetSlot]);
+		const float Closeness = 1.0f - FMath::Clamp(Distance / PerceiverRanges[PerceptionSlot], 0.0f, 1.0f);
+		Priority *= 1.0f + DistancePriorityWeight * Closeness;
+	}
+
+	return Priority;
+}
+
+void UGAPerceptionSystem::RunPerceptionPhase()
+{
+	UWorld* World = GetWorld();
+	if (!World)
+	{
+		return;
+	}
+
+	const float Now = World->GetTimeSeconds();
+
+	// Last frame's traces first, so that the pairs they were for get scored as freshly updated
+	ApplyPendingTraces();
+	IntegrateLosResults();
+
+	// Everything the workers need to know about the actors, read up front on the game thread
+	RefreshTargetPositions();
+	RefreshPerceiverViews();
+
+	const int32 ChunkSize = FMath::Max(PerceiversPerTask, 1);
+	const int32 NumChunks = FMath::DivideAndRoundUp(PerceptionComponents.Num(), ChunkSize);
+	PerceptionChunks.SetNum(NumChunks);
+	ParallelFor(NumChunks, [&](int32 ChunkIndex)
+	{
+		FPerceptionChunk& Chunk = PerceptionChunks[ChunkIndex];
+		Chunk.Pairs.Reset();
+
+		const int32 End = FMath::Min((ChunkIndex + 1) * ChunkSize, PerceptionComponents.Num());
+		for (int32 Index = ChunkIndex * ChunkSize; Index < End; Index++)
+		{
+			if (PerceptionComponents[Index])
+			{
+				ScorePerceiverPairs(PerceptionComponents[Index], Chunk, Now);
+			}
+		}
+	}, GetParallelForFlags());
+
+	// Merged in chunk order, so the outcome doesn't depend on which worker finished first
+	ScheduledPairs.Reset();
+	for (const FPerceptionChunk& Chunk : PerceptionChunks)
+	{
+		ScheduledPairs.Append(Chunk.Pairs);
+	}
+
+	const int32 Budget = (PerceptionPairBudget > 0) ? FMath::Min(PerceptionPairBudget, ScheduledPairs.Num()) : ScheduledPairs.Num();
+	if (Budget < ScheduledPairs.Num())
+	{
+		// Staleness keeps growing for pairs that miss out, so everyone gets a turn eventually
+		ScheduledPairs.Sort([](const FScheduledPair& A, const FScheduledPair& B) { return A.Priority > B.Priority; });
+	}
+
+	for (int32 Index = 0; Index < Budget; Index++)
+	{
+		const FScheduledPair& Pair = ScheduledPairs[Index];
+		UpdatePair(Pair.PerceptionComponent, Pair.TargetComponent, Pair.bInCone);
+	}
+
+	IntegrateLosResults();
+	RefreshTargetMaxAwareness();
+}
+
+void UGAPerceptionSystem::ScorePerceiverPairs(const UGAPerceptionComponent* PerceptionComponent, FPerceptionChunk& Chunk, float Now)
+{
+	GatherTargetCandidates(PerceptionComponent, Chunk.Targets, Chunk.Candidates, Chunk.CandidateBits);
+	TestVisionCones(PerceptionComponent, Chunk.Targets, Chunk.InCone, Chunk.ConeBatch);
+
+	for (int32 Candidate = 0; Candidate < Chunk.Targets.Num(); Candidate++)
+	{
+		UGATargetComponent* TargetComponent = Chunk.Targets[Candidate];
+		const float Priority = (TargetComponent && !IsTraceInFlight(PerceptionComponent, TargetComponent)) ?
+			GetPairPriority(PerceptionComponent, TargetComponent, Now) : -1.0f;
+		if (Priority >= 0.0f)
+		{
+			Chunk.Pairs.Add({ const_cast<UGAPerceptionComponent*>(PerceptionComponent), TargetComponent, Priority, bool(Chunk.InCone[Candidate]) });
+		}
+	}
+}
+
+void UGAPerceptionSystem::AddLosResult(const UGAPerceptionComponent* PerceptionComponent, const UGATargetComponent* TargetComponent, bool bClear)
+{
+	LosResults.Add({ PerceptionComponent, TargetComponent->TargetSlot, bClear });
+}
+
+void UGAPerceptionSystem::IntegrateLosResults()
+{
+	UWorld* World = GetWorld();
+	if (!World || (LosResults.Num() == 0))
+	{
+		LosResults.Reset();
+		return;
+	}
+
+	const float Now = World->GetTimeSeconds();
+	const float DeltaTime = World->GetDeltaSeconds();
+
+	// A pair turns up at most once per batch (it isn't scheduled again while its trace is in flight), so every
+	// result has its entry in the table to itself
+	const int32 ResultsPerTask = 256;
+	const int32 NumChunks = FMath::DivideAndRoundUp(LosResults.Num(), ResultsPerTask);
+	ParallelFor(NumChunks, [&](int32 ChunkIndex)
+	{
+		const int32 End = FMath::Min((ChunkIndex + 1) * ResultsPerTask, LosResults.Num());
+		for (int32 Index = ChunkIndex * ResultsPerTask; Index < End; Index++)
+		{
+			const FLosResult& Result = LosResults[Index];
+			const int32 PerceptionSlot = Result.PerceptionComponent->PerceptionSlot;
+			if (AwarenessTable.IsValidPair(PerceptionSlot, Result.TargetSlot))
+			{
+				AwarenessTable.Integrate(AwarenessTable.GetIndex(PerceptionSlot, Result.TargetSlot), Result.bClear, Now, DeltaTime,
+					Result.PerceptionComponent->AwarenessIncreaseRate, Result.PerceptionComponent->AwarenessDecayRate);
+			}
+		}
+	}, GetParallelForFlags());
+
+	LosResults.Reset();
+}
+
+void UGAPerceptionSystem::RefreshTargetMaxAwareness()
+{
+	TargetSlotMaxAwareness.SetNumZeroed(NumTargetSlots);
+	ParallelFor(NumTargetSlots, [&](int32 TargetSlot)
+	{
+		TargetSlotMaxAwareness[TargetSlot] = AwarenessTable.GetMaxAwareness(TargetSlot);
+	}, GetParallelForFlags());
+	MaxAwarenessFrame = GFrameCounter;
+}
+
+void UGAPerceptionSystem::UpdatePair(UGAPerceptionComponent* PerceptionComponent, UGATargetComponent* TargetComponent, bool bInCone)
+{
+	if (!bInCone)
+	{
+		// No trace needed
+		AddLosResult(PerceptionComponent, TargetComponent, false);
+		return;
+	}
+
+	UWorld* World = GetWorld();
+	FVector TraceStart = PerceptionComponent->GetOwnerPawn()->GetActorLocation();
+	FVector TraceEnd = TargetComponent->GetOwner()->GetActorLocation();
+
+	if (!bAsyncVisibilityTraces)
+	{
+		AddLosResult(PerceptionComponent, TargetComponent, PerceptionComponent->TraceTargetLos(TargetComponent, TraceStart, TraceEnd));
+		return;
+	}
+
+	if (bCompensateTraceLatency)
+	{
+		TraceEnd += TargetComponent->GetOwner()->GetVelocity() * World->GetDeltaSeconds();
+	}
+
+	bool bCachedClear = false;
+	if (FindCachedLos(PerceptionComponent, TargetComponent, TraceStart, TraceEnd, bCachedClear) ||
+		FindSquadLos(PerceptionComponent, TargetComponent, TraceStart, TraceEnd, bCachedClear))
+	{
+		AddLosResult(PerceptionComponent, TargetComponent, bCachedClear);
+		return;
+	}
+
+	if (FPendingTrace* SquadPending = FindSquadPendingTrace(PerceptionComponent, TargetComponent, TraceStart, TraceEnd))
+	{
+		SquadPending->Sharers.Add(PerceptionComponent);
+		SetTraceInFlight(PerceptionComponent, TargetComponent, true);
+		SquadLosShares++;
+		return;
+	}
+
+	FPendingTrace& Pending = PendingTraces.AddDefaulted_GetRef();
+	Pending.PerceptionComponent = PerceptionComponent;
+	Pending.TargetComponent = TargetComponent;
+	Pending.TraceStart = TraceStart;
+	Pending.TraceEnd = TraceEnd;
+	Pending.Time = World->GetTimeSeconds();
+	Pending.Handle = World->AsyncLineTraceByChannel(EAsyncTraceType::Single, TraceStart, TraceEnd, ECC_Visibility,
+		PerceptionComponent->GetLosQueryParams(TargetComponent));
+	SetTraceInFlight(PerceptionComponent, TargetComponent, true);
+}
+
+void UGAPerceptionSystem::ApplyPendingTraces()
+{
+	UWorld* World = GetWorld();
+
+	for (int32 Index = PendingTraces.Num() - 1; Index >= 0; Index--)
+	{
+		FPendingTrace& Pending = PendingTraces[Index];
+		UGAPerceptionComponent* PerceptionComponent = Pending.PerceptionComponent.Get();
+		UGATargetComponent* TargetComponent = Pending.TargetComponent.Get();
+
+		FTraceDatum Datum;
+		if (PerceptionComponent && TargetComponent && World->QueryTraceData(Pending.Handle, Datum))
+		{
+			const bool bClear = FHitResult::GetFirstBlockingHit(Datum.OutHits) == nullptr;
+			StoreLos(PerceptionComponent, TargetComponent, Pending.TraceStart, Pending.TraceEnd, Pending.Time, bClear);
+			AddLosResult(PerceptionComponent, TargetComponent, bClear);
+
+			for (const TWeakObjectPtr<UGAPerceptionComponent>& Sharer : Pending.Sharers)
+			{
+				if (Sharer.IsValid() && (bClear || bShareBlockedLos))
+				{
+					AddLosResult(Sharer.Get(), TargetComponent, bClear);
+				}
+			}
+		}
+		else if (PerceptionComponent && TargetComponent && World->IsTraceHandleValid(Pending.Handle, false))
+		{
+			// Not done yet
+			continue;
+		}
+
+		// Applied, or lost (the pair then just gets scheduled again). A component that's gone had its slot's flags
+		// cleared when it unregistered
+		if (TargetComponent)
+		{
+			if (PerceptionComponent)
+			{
+				SetTraceInFlight(PerceptionComponent, TargetComponent, false);
+			}
+			for (const TWeakObjectPtr<UGAPerceptionComponent>& Sharer : Pending.Sharers)
+			{
+				if (Sharer.IsValid())
+				{
+					SetTraceInFlight(Sharer.Get(), TargetComponent, false);
+				}
+			}
+		}
+		PendingTraces.RemoveAtSwap(Index);
+	}
+}
+
+bool UGAPerceptionSystem::IsTraceInFlight(const UGAPerceptionComponent* PerceptionComponent, const UGATargetComponent* TargetComponent) const
+{
+	return AwarenessTable.IsValidPair(PerceptionComponent->PerceptionSlot, TargetComponent->TargetSlot) &&
+		(AwarenessTable.TraceInFlight[AwarenessTable.GetIndex(PerceptionComponent->PerceptionSlot, TargetComponent->TargetSlot)] != 0);
+}
+
+void UGAPerceptionSystem::SetTraceInFlight(const UGAPerceptionComponent* PerceptionComponent, const UGATargetComponent* TargetComponent, bool bInFlight)
+{
+	if (AwarenessTable.IsValidPair(PerceptionComponent->PerceptionSlot, TargetComponent->TargetSlot))
+	{
+		AwarenessTable.TraceInFlight[AwarenessTable.GetIndex(PerceptionComponent->PerceptionSlot, TargetComponent->TargetSlot)] = bInFlight ? 1 : 0;
+	}
+}
+
+UGAPerceptionSystem::FPendingTrace* UGAPerceptionSystem::FindSquadPendingTrace(const UGAPerceptionComponent* PerceptionComponent, const UGATargetComponent* TargetComponent, const FVector& TraceStart, const FVector& TraceEnd)
+{
+	// (If it comes back blocked and bShareBlockedLos is off, the sharers get nothing, and their pairs are simply
+	// scheduled again)
+	if (!bShareSquadLos || PerceptionComponent->Squad.IsNone())
+	{
+		return nullptr;
+	}
+
+	for (FPendingTrace& Pending : PendingTraces)
+	{
+		const UGAPerceptionComponent* Tracer = Pending.PerceptionComponent.Get();
+		if ((Pending.TargetComponent.Get() == TargetComponent) && Tracer && (Tracer->Squad == PerceptionComponent->Squad) &&
+			(FVector::DistSquared(Pending.TraceStart, TraceStart) <= FMath::Square(SquadShareRadius)) &&
+			(FVector::DistSquared(Pending.TraceEnd, TraceEnd) <= FMath::Square(LosCacheMoveThreshold)))
+		{
+			return &Pending;
+		}
+	}
+	return nullptr;
+}
+
+
+int32 UGAPerceptionSystem::AllocateSlot(TArray<int32>& FreeSlots, int32& NumSlots)
+{
+	return (FreeSlots.Num() > 0) ? FreeSlots.Pop(EAllowShrinking::No) : NumSlots++;
+}
+
 bool UGAPerceptionSystem::RegisterPerceptionComponent(UGAPerceptionComponent* PerceptionComponent)
 {
-	PerceptionComponents.AddUnique(PerceptionComponent);
+	if (!PerceptionComponent || PerceptionComponents.Contains(PerceptionComponent))
+	{
+		return false;
+	}
+
+	PerceptionComponents.Add(PerceptionComponent);
+
+	PerceptionComponent->PerceptionSlot = AllocateSlot(FreePerceptionSlots, NumPerceptionSlots);
+	AwarenessTable.Reserve(NumPerceptionSlots, NumTargetSlots);
+	AwarenessTable.ClearPerceiver(PerceptionComponent->PerceptionSlot);
+
+	PerceiverCandidates.SetNum(NumPerceptionSlots);
+	PerceiverCandidates[PerceptionComponent->PerceptionSlot].Reset();
 	return true;
 }
 
 bool UGAPerceptionSystem::UnregisterPerceptionComponent(UGAPerceptionComponent* PerceptionComponent)
 {
-	return PerceptionComponents.Remove(PerceptionComponent) > 0;
+	if (!PerceptionComponent || (PerceptionComponents.Remove(PerceptionComponent) == 0))
+	{
+		return false;
+	}
+
+	if (PerceptionComponent->PerceptionSlot != INDEX_NONE)
+	{
+		AwarenessTable.ClearPerceiver(PerceptionComponent->PerceptionSlot);
+		FreePerceptionSlots.Add(PerceptionComponent->PerceptionSlot);
+		PerceptionComponent->PerceptionSlot = INDEX_NONE;
+	}
+	return true;
 }
 
 
 bool UGAPerceptionSystem::RegisterTargetComponent(UGATargetComponent* TargetComponent)
 {
-	TargetComponents.AddUnique(TargetComponent);
+	if (!TargetComponent || TargetComponents.Contains(TargetComponent))
+	{
+		return false;
+	}
+
+	TargetComponents.Add(TargetComponent);
+
+	TargetComponent->TargetSlot = AllocateSlot(FreeTargetSlots, NumTargetSlots);
+	AwarenessTable.Reserve(NumPerceptionSlots, NumTargetSlots);
+	AwarenessTable.ClearTarget(TargetComponent->TargetSlot);
+
+	SlotTargetComponents.SetNumZeroed(NumTargetSlots);
+	SlotTargetComponents[TargetComponent->TargetSlot] = TargetComponent;
+	if (TargetSlotMaxAwareness.IsValidIndex(TargetComponent->TargetSlot))
+	{
+		TargetSlotMaxAwareness[TargetComponent->TargetSlot] = 0.0f;
+	}
+
+	// Put it in the hash now, rather than have it missed until next frame
+	if (TargetComponent->GetOwner())
+	{
+		TargetHash.Update(TargetComponent->TargetSlot, TargetComponent->GetOwner()->GetActorLocation());
+	}
+
+	// (a reused slot may still have its last owner's channel in it)
+	OccupancyBank.ClearChannel(TargetComponent->TargetSlot);
 	return true;
 }
 
 bool UGAPerceptionSystem::UnregisterTargetComponent(UGATargetComponent* TargetComponent)
 {
-	return TargetComponents.Remove(TargetComponent) > 0;
+	if (!TargetComponent || (TargetComponents.Remove(TargetComponent) == 0))
+	{
+		return false;
+	}
+
+	if (TargetComponent->TargetSlot != INDEX_NONE)
+	{
+		AwarenessTable.ClearTarget(TargetComponent->TargetSlot);
+		TargetHash.Remove(TargetComponent->TargetSlot);
+		OccupancyBank.ClearChannel(TargetComponent->TargetSlot);
+		for (TPair<FName, TArray<FSquadLos>>& Pair : SquadLos)
+		{
+			if (Pair.Value.IsValidIndex(TargetComponent->TargetSlot))
+			{
+				Pair.Value[TargetComponent->TargetSlot] = FSquadLos();
+			}
+		}
+		SlotTargetComponents[TargetComponent->TargetSlot] = nullptr;
+		FreeTargetSlots.Add(TargetComponent->TargetSlot);
+		TargetComponent->TargetSlot = INDEX_NONE;
+	}
+	return true;
+}
+
+
+bool UGAPerceptionSystem::GetTargetData(const UGAPerceptionComponent* PerceptionComponent, const UGATargetComponent* TargetComponent, FTargetData& TargetDataOut) const
+{
+	if (!PerceptionComponent || !TargetComponent || !AwarenessTable.IsValidPair(PerceptionComponent->PerceptionSlot, TargetComponent->TargetSlot))
+	{
+		return false;
+	}
+
+	const int32 Index = AwarenessTable.GetIndex(PerceptionComponent->PerceptionSlot, TargetComponent->TargetSlot);
+	if (!AwarenessTable.HasEntry(Index))
+	{
+		return false;
+	}
+
+	TargetDataOut.bClearLos = AwarenessTable.ClearLos[Index] != 0;
+	TargetDataOut.Awareness = AwarenessTable.Awareness[Index];
+	TargetDataOut.LastUpdateTime = AwarenessTable.LastUpdateTime[Index];
+	return true;
+}
+
+float UGAPerceptionSystem::GetMaxAwareness(const UGATargetComponent* TargetComponent) const
+{
+	if (!TargetComponent)
+	{
+		return 0.0f;
+	}
+
+	// This frame's perception phase may already have reduced every column
+	if ((MaxAwarenessFrame == GFrameCounter) && TargetSlotMaxAwareness.IsValidIndex(TargetComponent->TargetSlot))
+	{
+		return TargetSlotMaxAwareness[TargetComponent->TargetSlot];
+	}
+	return AwarenessTable.GetMaxAwareness(TargetComponent->TargetSlot);
+}
+
+
+void UGAPerceptionSystem::ResetLosCacheStats()
+{
+	LosCacheHits = 0;
+	LosCacheMisses = 0;
+	SquadLosShares = 0;
+}
+
+bool UGAPerceptionSystem::FindCachedLos(const UGAPerceptionComponent* PerceptionComponent, const UGATargetComponent* TargetComponent, const FVector& TraceStart, const FVector& TraceEnd, bool& bClearOut)
+{
+	UWorld* World = GetWorld();
+	if (!bCacheLos || !World || !AwarenessTable.IsValidPair(PerceptionComponent->PerceptionSlot, TargetComponent->TargetSlot))
+	{
+		return false;
+	}
+
+	const int32 Index = AwarenessTable.GetIndex(PerceptionComponent->PerceptionSlot, TargetComponent->TargetSlot);
+	if (AwarenessTable.FindCachedLos(Index, TraceStart, TraceEnd, World->GetTimeSeconds(), LosCacheMoveThreshold, LosCacheMaxAge, bClearOut))
+	{
+		LosCacheHits++;
+		return true;
+	}
+
+	LosCacheMisses++;
+	return false;
+}
+
+void UGAPerceptionSystem::StoreLos(const UGAPerceptionComponent* PerceptionComponent, const UGATargetComponent* TargetComponent, const FVector& TraceStart, const FVector& TraceEnd, float Time, bool bClear)
+{
+	if (AwarenessTable.IsValidPair(PerceptionComponent->PerceptionSlot, TargetComponent->TargetSlot))
+	{
+		AwarenessTable.StoreLos(AwarenessTable.GetIndex(PerceptionComponent->PerceptionSlot, TargetComponent->TargetSlot), TraceStart, TraceEnd, Time, bClear);
+	}
+
+	if (!PerceptionComponent->Squad.IsNone() && (TargetComponent->TargetSlot != INDEX_NONE))
+	{
+		TArray<FSquadLos>& Entries = SquadLos.FindOrAdd(PerceptionComponent->Squad);
+		if (Entries.Num() <= TargetComponent->TargetSlot)
+		{
+			Entries.SetNum(TargetComponent->TargetSlot + 1);
+		}
+
+		FSquadLos& Entry = Entries[TargetComponent->TargetSlot];
+		if (Time >= Entry.Time)
+		{
+			Entry.TraceStart = TraceStart;
+			Entry.TraceEnd = TraceEnd;
+			Entry.Time = Time;
+			Entry.bClear = bClear;
+		}
+	}
+}
+
+bool UGAPerceptionSystem::FindSquadLos(const UGAPerceptionComponent* PerceptionComponent, const UGATargetComponent* TargetComponent, const FVector& TraceStart, const FVector& TraceEnd, bool& bClearOut)
+{
+	UWorld* World = GetWorld();
+	if (!bShareSquadLos || !World || PerceptionComponent->Squad.IsNone() || (TargetComponent->TargetSlot == INDEX_NONE))
+	{
+		return false;
+	}
+
+	const TArray<FSquadLos>* Entries = SquadLos.Find(PerceptionComponent->Squad);
+	if (!Entries || !Entries->IsValidIndex(TargetComponent->TargetSlot))
+	{
+		return false;
+	}
+
+	const FSquadLos& Entry = (*Entries)[TargetComponent->TargetSlot];
+	if ((Entry.Time < 0.0f) || (World->GetTimeSeconds() - Entry.Time > SquadShareLatency) || (!Entry.bClear && !bShareBlockedLos))
+	{
+		return false;
+	}
+
+	if ((FVector::DistSquared(Entry.TraceStart, TraceStart) > FMath::Square(SquadShareRadius)) ||
+		(FVector::DistSquared(Entry.TraceEnd, TraceEnd) > FMath::Square(LosCacheMoveThreshold)))
+	{
+		return false;
+	}
+
+	bClearOut = Entry.bClear;
+	SquadLosShares++;
+	return true;
+}
+
+
+void UGAPerceptionSystem::RefreshTargetPositions()
+{
+	if (TargetPositionsFrame == GFrameCounter)
+	{
+		return;
+	}
+	TargetPositionsFrame = GFrameCounter;
+
+	TargetSlotPositions.SetNumZeroed(NumTargetSlots);
+	TargetSlotHasPosition.Init(false, NumTargetSlots);
+
+	// (Resizing empties the hash, and everything gets put straight back below)
+	TargetHash.SetCellSize(BroadPhaseCellSize);
+	for (UGATargetComponent* TargetComponent : TargetComponents)
+	{
+		const AActor* TargetOwner = TargetComponent ? TargetComponent->GetOwner() : nullptr;
+		if (TargetOwner && (TargetComponent->TargetSlot != INDEX_NONE))
+		{
+			const FVector Position = TargetOwner->GetActorLocation();
+			TargetSlotPositions[TargetComponent->TargetSlot] = Position;
+			TargetSlotHasPosition[TargetComponent->TargetSlot] = true;
+			TargetHash.Update(TargetComponent->TargetSlot, Position);
+		}
+	}
+}
+
+void UGAPerceptionSystem::RefreshPerceiverViews()
+{
+	if (PerceiverViewsFrame == GFrameCounter)
+	{
+		return;
+	}
+	PerceiverViewsFrame = GFrameCounter;
+
+	PerceiverOrigins.SetNumZeroed(NumPerceptionSlots);
+	PerceiverForwards.SetNumZeroed(NumPerceptionSlots);
+	PerceiverConeCos.SetNumZeroed(NumPerceptionSlots);
+	PerceiverRanges.SetNumZeroed(NumPerceptionSlots);
+	PerceiverHasView.Init(false, NumPerceptionSlots);
+
+	for (UGAPerceptionComponent* PerceptionComponent : PerceptionComponents)
+	{
+		const APawn* OwnerPawn = PerceptionComponent ? PerceptionComponent->GetOwnerPawn() : nullptr;
+		if (OwnerPawn && (PerceptionComponent->PerceptionSlot != INDEX_NONE))
+		{
+			const int32 Slot = PerceptionComponent->PerceptionSlot;
+			PerceiverOrigins[Slot] = OwnerPawn->GetActorLocation();
+			PerceiverForwards[Slot] = OwnerPawn->GetActorForwardVector();
+			// (Perceivers only refresh this when they tick, which may not have happened yet this frame)
+			PerceptionComponent->RefreshVisionCache();
+			PerceiverConeCos[Slot] = PerceptionComponent->GetVisionConeCos();
+			PerceiverRanges[Slot] = PerceptionComponent->VisionParameters.VisionDistance;
+			PerceiverHasView[Slot] = true;
+		}
+	}
+}
+
+void UGAPerceptionSystem::GatherTargetCandidates(const UGAPerceptionComponent* PerceptionComponent, TArray<UGATargetComponent*>& TargetsOut)
+{
+	GatherTargetCandidates(PerceptionComponent, TargetsOut, ScratchCandidates, ScratchCandidateBits);
+}
+
+void UGAPerceptionSystem::GatherTargetCandidates(const UGAPerceptionComponent* PerceptionComponent, TArray<UGATargetComponent*>& TargetsOut, TArray<int32>& ScratchCandidatesIn, TBitArray<>& ScratchCandidateBitsIn)
+{
+	TargetsOut.Reset();
+
+	RefreshTargetPositions();
+	RefreshPerceiverViews();
+
+	const int32 PerceptionSlot = PerceptionComponent ? PerceptionComponent->PerceptionSlot : INDEX_NONE;
+	if (!bBroadPhase || !PerceiverCandidates.IsValidIndex(PerceptionSlot) || !PerceiverHasView.IsValidIndex(PerceptionSlot) || !PerceiverHasView[PerceptionSlot])
+	{
+		TargetsOut.Append(TargetComponents);
+		return;
+	}
+
+	TArray<int32>& Candidates = PerceiverCandidates[PerceptionSlot];
+	Swap(Candidates, ScratchCandidatesIn);
+	Candidates.Reset();
+	TargetHash.Query(PerceiverOrigins[PerceptionSlot], PerceiverRanges[PerceptionSlot], Candidates);
+
+	if (ScratchCandidateBitsIn.Num() < NumTargetSlots)
+	{
+		ScratchCandidateBitsIn.Init(false, NumTargetSlots);
+	}
+	for (int32 TargetSlot : Candidates)
+	{
+		ScratchCandidateBitsIn[TargetSlot] = true;
+	}
+
+	// Anything that's just left the perceiver's range can only lose LOS, but it still needs updating for that to happen
+	for (int32 TargetSlot : ScratchCandidatesIn)
+	{
+		if (!AwarenessTable.IsValidPair(PerceptionSlot, TargetSlot) || ScratchCandidateBitsIn[TargetSlot])
+		{
+			continue;
+		}
+
+		const int32 Index = AwarenessTable.GetIndex(PerceptionSlot, TargetSlot);
+		if ((AwarenessTable.Awareness[Index] > 0.0f) || AwarenessTable.ClearLos[Index])
+		{
+			Candidates.Add(TargetSlot);
+			ScratchCandidateBitsIn[TargetSlot] = true;
+		}
+	}
+
+	// Leave the bits clear for the next call
+	for (int32 TargetSlot : Candidates)
+	{
+		ScratchCandidateBitsIn[TargetSlot] = false;
+	}
+
+	for (int32 TargetSlot : Candidates)
+	{
+		if (SlotTargetComponents.IsValidIndex(TargetSlot) && SlotTargetComponents[TargetSlot])
+		{
+			TargetsOut.Add(SlotTargetComponents[TargetSlot]);
+		}
+	}
+}
+
+void UGAPerceptionSystem::TestVisionCones(const UGAPerceptionComponent* PerceptionComponent, const TArray<UGATargetComponent*>& Targets, TBitArray<>& InConeOut)
+{
+	TestVisionCones(PerceptionComponent, Targets, InConeOut, ScratchConeBatch);
+}
+
+void UGAPerceptionSystem::TestVisionCones(const UGAPerceptionComponent* PerceptionComponent, const TArray<UGATargetComponent*>& Targets, TBitArray<>& InConeOut, FGAConeTestBatch& ConeBatch)
+{
+	RefreshTargetPositions();
+	RefreshPerceiverViews();
+
+	const int32 PerceptionSlot = PerceptionComponent ? PerceptionComponent->PerceptionSlot : INDEX_NONE;
+	if (!PerceiverHasView.IsValidIndex(PerceptionSlot) || !PerceiverHasView[PerceptionSlot])
+	{
+		InConeOut.Init(false, Targets.Num());
+		return;
+	}
+
+	auto HasPosition = [&](const UGATargetComponent* TargetComponent)
+	{
+		return TargetComponent && TargetSlotHasPosition.IsValidIndex(TargetComponent->TargetSlot) && TargetSlotHasPosition[TargetComponent->TargetSlot];
+	};
+
+	ConeBatch.Reset(PerceiverOrigins[PerceptionSlot]);
+	for (const UGATargetComponent* TargetComponent : Targets)
+	{
+		ConeBatch.Add(HasPosition(TargetComponent) ? TargetSlotPositions[TargetComponent->TargetSlot] : FVector::ZeroVector);
+	}
+
+	ConeBatch.Test(PerceiverForwards[PerceptionSlot], PerceiverConeCos[PerceptionSlot], PerceiverRanges[PerceptionSlot], InConeOut);
+
+	for (int32 Index = 0; Index < Targets.Num(); Index++)
+	{
+		if (!HasPosition(Targets[Index]))
+		{
+			InConeOut[Index] = false;
+		}
+	}
+}
+
+
+const TBitArray<>& UGAPerceptionSystem::GetFrameVisibility(const AGAGridActor* Grid)
+{
+	if ((FrameVisibilityFrame != GFrameCounter) || (FrameVisibilityGrid.Get() != Grid))
+	{
+		RefreshFrameVisibility(Grid);
+		FrameVisibilityFrame = GFrameCounter;
+		FrameVisibilityGrid = Grid;
+	}
+
+	return FrameVisibleCells;
+}
+
+void UGAPerceptionSystem::RefreshFrameVisibility(const AGAGridActor* Grid)
+{
+	if (!Grid)
+	{
+		FrameVisibleCells.Empty();
+		return;
+	}
+
+	FrameVisibleCells.Init(false, Grid->GetCellIndexCount());
+
+	// Grab everyone's cone here on the game thread. Perceivers that need physics traces are done right away
+	TArray<FGAVisionCone, TInlineAllocator<16>> Cones;
+	for (UGAPerceptionComponent* PerceptionComponent : PerceptionComponents)
+	{
+		if (!PerceptionComponent)
+		{
+			continue;
+		}
+
+		if (PerceptionComponent->CanUseGridVisibility(Grid))
+		{
+			FGAVisionCone Cone;
+			if (PerceptionComponent->GetVisionCone(Grid, Cone))
+			{
+				Cones.Add(Cone);
+			}
+		}
+		else
+		{
+			PerceptionComponent->ComputeVisibleCells(Grid, FrameVisibleCells);
+		}
+	}
+
+	if (bParallelVisibility && (Cones.Num() > 1))
+	{
+		// One bitset per cone, so the workers never write to the same words, then OR them together
+		PerceiverVisibleCells.SetNum(Cones.Num());
+		ParallelFor(Cones.Num(), [&](int32 Index)
+		{
+			TBitArray<>& Visible = PerceiverVisibleCells[Index];
+			Visible.Init(false, FrameVisibleCells.Num());
+			FGAGridVisibility::ComputeConeVisibility(Grid, Cones[Index], Visible);
+		});
+
+		for (const TBitArray<>& Visible : PerceiverVisibleCells)
+		{
+			FrameVisibleCells.CombineWithBitwiseOR(Visible, EBitwiseOperatorFlags::MaintainSize);
+		}
+	}
+	else
+	{
+		for (const FGAVisionCone& Cone : Cones)
+		{
+			FGAGridVisibility::ComputeConeVisibility(Grid, Cone, FrameVisibleCells);
+		}
+	}
 }
 
 
@@ -2,8 +2,15 @@
 
 #include "CoreMinimal.h"
 #include "Components/ActorComponent.h"
+#include "WorldCollision.h"
+#include "Async/ParallelFor.h"
 #include "GAPerceptionComponent.h"
 #include "GATargetComponent.h"
+#include "GAAwarenessTable.h"
+#include "GASpatialHash.h"
+#include "GAConeTestBatch.h"
+#include "GAOccupancyBank.h"
+#include "GANoiseField.h"
 #include "GAPerceptionSystem.generated.h"
 
 
@@ -32,4 +39,364 @@ class UGAPerceptionSystem : public UActorComponent
 
 	static UGAPerceptionSystem* GetPerceptionSystem(const UObject* WorldContextObject);
 
+	virtual void TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+
+	// Awareness ----------
+
+	// Every registered perceiver's awareness of every registered target, indexed by their PerceptionSlot / TargetSlot
+	FGAAwarenessTable& GetAwarenessTable() { return AwarenessTable; }
+	const FGAAwarenessTable& GetAwarenessTable() const { return AwarenessTable; }
+
+	// Snapshot of one pair's entry. Returns false if the pair hasn't been updated yet
+	bool GetTargetData(const UGAPerceptionComponent* PerceptionComponent, const UGATargetComponent* TargetComponent, FTargetData& TargetDataOut) const;
+
+	// Highest awareness any perceiver has of the target
+	float GetMaxAwareness(const UGATargetComponent* TargetComponent) const;
+
+
+	// LOS cache ----------
+
+	// Reuse a pair's last LOS trace while neither end has moved more than LosCacheMoveThreshold since, for up to
+	// LosCacheMaxAge seconds
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Perception")
+	bool bCacheLos = true;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Perception", meta = (EditCondition = "bCacheLos", ClampMin = "0.0"))
+	float LosCacheMoveThreshold = 20.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Perception", meta = (EditCondition = "bCacheLos", ClampMin = "0.0"))
+	float LosCacheMaxAge = 0.5f;
+
+	// Lookups that were answered from the cache / that needed a trace, since the last ResetLosCacheStats
+	UPROPERTY(BlueprintReadOnly, VisibleAnywhere, Category = "Perception")
+	int32 LosCacheHits = 0;
+
+	UPROPERTY(BlueprintReadOnly, VisibleAnywhere, Category = "Perception")
+	int32 LosCacheMisses = 0;
+
+	UFUNCTION(BlueprintCallable)
+	void ResetLosCacheStats();
+
+	// Look up the pair's cached LOS between these endpoints. Counts a hit or a miss
+	bool FindCachedLos(const UGAPerceptionComponent* PerceptionComponent, const UGATargetComponent* TargetComponent, const FVector& TraceStart, const FVector& TraceEnd, bool& bClearOut);
+
+	// Remember the result of a trace made at Time (and post it to the perceiver's squad)
+	void StoreLos(const UGAPerceptionComponent* PerceptionComponent, const UGATargetComponent* TargetComponent, const FVector& TraceStart, const FVector& TraceEnd, float Time, bool bClear);
+
+
+	// Squads ----------
+
+	// Let perceivers answer a LOS check with a squadmate's result for the same target, so that a squad that's
+	// bunched up makes one trace per target rather than one each. A result is only taken from a squadmate whose
+	// eye was within SquadShareRadius of mine, at most SquadShareLatency seconds ago, with the target no more than
+	// LosCacheMoveThreshold from where it was traced to. With async traces, a squadmate's trace still in flight is
+	// shared the same way
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Perception")
+	bool bShareSquadLos = true;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Perception", meta = (EditCondition = "bShareSquadLos", ClampMin = "0.0"))
+	float SquadShareLatency = 0.25f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Perception", meta = (EditCondition = "bShareSquadLos", ClampMin = "0.0"))
+	float SquadShareRadius = 300.0f;
+
+	// Also trust squadmates' blocked results. A blocked trace from a few steps away is the less reliable of the two
+	// (the corner in the way may not be in mine), so by default only sightings are shared
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Perception", meta = (EditCondition = "bShareSquadLos"))
+	bool bShareBlockedLos = false;
+
+	// LOS checks answered by a squadmate's result, since the last ResetLosCacheStats
+	UPROPERTY(BlueprintReadOnly, VisibleAnywhere, Category = "Perception")
+	int32 SquadLosShares = 0;
+
+	// Look up a squadmate's result usable for this check. Counts a share
+	bool FindSquadLos(const UGAPerceptionComponent* PerceptionComponent, const UGATargetComponent* TargetComponent, const FVector& TraceStart, const FVector& TraceEnd, bool& bClearOut);
+
+
+	// Broad phase ----------
+
+	// Only consider the targets within a perceiver's vision distance (plus any it's still aware of), found through a
+	// spatial hash of the targets, rather than every target for every perceiver
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Perception")
+	bool bBroadPhase = true;
+
+	// Size of the spatial hash's cells. Around the typical vision distance is a good start
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Perception", meta = (EditCondition = "bBroadPhase", ClampMin = "1.0"))
+	float BroadPhaseCellSize = 1000.0f;
+
+	// The targets the perceiver needs to update this frame (every target, without the broad phase)
+	void GatherTargetCandidates(const UGAPerceptionComponent* PerceptionComponent, TArray<UGATargetComponent*>& TargetsOut);
+
+	// Set bit i of InConeOut if Targets[i] is within the perceiver's vision distance and cone, as of this frame.
+	// Runs over every target at once (see FGAConeTestBatch), so only the survivors need a LOS trace
+	void TestVisionCones(const UGAPerceptionComponent* PerceptionComponent, const TArray<UGATargetComponent*>& Targets, TBitArray<>& InConeOut);
+
+
+	// Scheduling ----------
+
+	// Update perceiver / target pairs from here, up to PerceptionPairBudget of them per frame, instead of having every
+	// perceiver update every target every frame. Pairs are picked by priority (see GetPairPriority), so the ones
+	// that matter most are the least stale
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Perception")
+	bool bScheduledPerception = true;
+
+	// Run the scheduled perception phase's broad phase, cone tests, scoring and awareness integration on worker
+	// threads. Only the traces (and reading the actors' transforms) stay on the game thread
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Perception", meta = (EditCondition = "bScheduledPerception"))
+	bool bParallelPerception = true;
+
+	// Perceivers per worker task
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Perception", meta = (EditCondition = "bParallelPerception", ClampMin = "1"))
+	int32 PerceiversPerTask = 16;
+
+	// Pairs to update per frame (0 or less: all of them)
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Perception", meta = (EditCondition = "bScheduledPerception"))
+	int32 PerceptionPairBudget = 32;
+
+	// How much more often a pair right next to its perceiver is updated than one at the edge of its vision range
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Perception", meta = (EditCondition = "bScheduledPerception", ClampMin = "0.0"))
+	float DistancePriorityWeight = 2.0f;
+
+	// How much more often a fully aware pair is updated than an unaware one
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Perception", meta = (EditCondition = "bScheduledPerception", ClampMin = "0.0"))
+	float AwarenessPriorityWeight = 2.0f;
+
+	// Scheduled pairs that pass the cone test get their LOS trace queued with the physics scene's async traces rather
+	// than run there and then. The traces run off the game thread alongside the rest of the frame, and their results
+	// get applied at the start of the next frame's scheduling. A pair with a trace in flight isn't rescheduled
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Perception", meta = (EditCondition = "bScheduledPerception"))
+	bool bAsyncVisibilityTraces = true;
+
+	// Async results are a frame late. With this, traces aim at where the target will be by the time the result is
+	// applied (its position pushed along its velocity by the last frame time), rather than where it is now
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Perception", meta = (EditCondition = "bAsyncVisibilityTraces"))
+	bool bCompensateTraceLatency = true;
+
+
+	// Shared visibility ----------
+
+	// Every cell currently visible to at least one perceiver, as a bit per cell indexed by AGAGridActor::CellRefToIndex.
+	// What the perceivers see doesn't depend on the target, so this is worked out once per frame (by the first caller)
+	// and shared by every target's occupancy update.
+	const TBitArray<>& GetFrameVisibility(const AGAGridActor* Grid);
+
+	// Work out each perceiver's visibility on worker threads (when it can be done from the grid alone)
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Perception")
+	bool bParallelVisibility = true;
+
+
+	// Occupancy ----------
+
+	// The occupancy maps of every target in GATTM_OccupancyMap mode, one channel per target slot, culled and diffused
+	// together at a fixed rate on a worker. Queries on it see the last published run, and never wait
+	const FGAOccupancyBank& GetOccupancyBank() const { return OccupancyBank; }
+
+	// Diffusion rate for the occupancy maps (see UGATargetComponent::OccupancyDiffusionRate)
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Perception", meta = (ClampMin = "0.0", ClampMax = "0.25"))
+	float OccupancyDiffusionRate = 0.2f;
+
+	// Occupancy steps per second. The maps are stepped independently of the frame rate, like a target's fixed rate
+	// private map (see UGATargetComponent::bFixedRateOccupancy)
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Perception", meta = (ClampMin = "1.0"))
+	float OccupancyStepRate = 30.0f;
+
+	// Most steps a single frame catches up on. If the maps fall further behind than this, the rest are dropped
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Perception", meta = (ClampMin = "1"))
+	int32 MaxOccupancyStepsPerFrame = 4;
+
+
+	// Hearing ----------
+
+	// A noise at Location that carries Range world units (along traversable cells, so around walls). Every perceiver
+	// it reaches (after their HearingSensitivity) hears it right away. If the instigator is a target, each of them
+	// becomes more aware of it (see UGAPerceptionComponent::HearingAwarenessGain), and if it's hidden, its occupancy
+	// starts over from Location.
+	// The flood is cached per NoiseFieldBucketCells square of cells, so noises around the same spot cost one lookup per
+	// perceiver
+	UFUNCTION(BlueprintCallable)
+	void ReportNoise(AActor* Instigator, const FVector& Location, float Range);
+
+	// Noise fields to keep around
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Perception", meta = (ClampMin = "1"))
+	int32 NoiseFieldCacheSize = 64;
+
+	// Noises within a square this many cells across share a noise field, as long as they're within this many cells of
+	// its source along a path (which is added to every distance, to make up for it). Bigger means more sharing
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Perception", meta = (ClampMin = "1"))
+	int32 NoiseFieldBucketCells = 4;
+
+protected:
+	FGAAwarenessTable AwarenessTable;
+
+	// Slots given back by unregistered components, to be handed out again before the table grows
+	TArray<int32> FreePerceptionSlots;
+	TArray<int32> FreeTargetSlots;
+	int32 NumPerceptionSlots = 0;
+	int32 NumTargetSlots = 0;
+
+	static int32 AllocateSlot(TArray<int32>& FreeSlots, int32& NumSlots);
+
+	// Registered targets by slot (null for free slots)
+	TArray<UGATargetComponent*> SlotTargetComponents;
+
+	// Per target slot: GetMaxAwareness as of the end of the last perception phase (in MaxAwarenessFrame)
+	TArray<float> TargetSlotMaxAwareness;
+	uint64 MaxAwarenessFrame = MAX_uint64;
+
+	void RefreshTargetMaxAwareness();
+
+	// The public versions, with the scratch passed in so that worker threads can each bring their own
+	void GatherTargetCandidates(const UGAPerceptionComponent* PerceptionComponent, TArray<UGATargetComponent*>& TargetsOut, TArray<int32>& ScratchCandidatesIn, TBitArray<>& ScratchCandidateBitsIn);
+	void TestVisionCones(const UGAPerceptionComponent* PerceptionComponent, const TArray<UGATargetComponent*>& Targets, TBitArray<>& InConeOut, FGAConeTestBatch& ConeBatch);
+
+	// Record where the targets are now, and move them in the hash to match (once per frame, by the first caller)
+	void RefreshTargetPositions();
+
+	FGASpatialHash TargetHash;
+	uint64 TargetPositionsFrame = MAX_uint64;
+
+	// Per target slot
+	TArray<FVector> TargetSlotPositions;
+	TBitArray<> TargetSlotHasPosition;
+
+	// Per perception slot, also refreshed once per frame: each perceiver's eye position, facing, cosine of half its
+	// vision angle and vision distance (only meaningful where PerceiverHasView is set)
+	void RefreshPerceiverViews();
+
+	TArray<FVector> PerceiverOrigins;
+	TArray<FVector> PerceiverForwards;
+	TArray<float> PerceiverConeCos;
+	TArray<float> PerceiverRanges;
+	TBitArray<> PerceiverHasView;
+	uint64 PerceiverViewsFrame = MAX_uint64;
+
+	FGAConeTestBatch ScratchConeBatch;
+
+	// Per perception slot: the target slots it was last given, so targets that leave its range keep getting updated
+	// until their awareness has decayed
+	TArray<TArray<int32>> PerceiverCandidates;
+	TArray<int32> ScratchCandidates;
+
+	// A bit per target slot, set for the slots already in the candidate list being gathered (all clear in between)
+	TBitArray<> ScratchCandidateBits;
+
+	// One frame's perception: apply last frame's traces, score every candidate pair, and update the
+	// PerceptionPairBudget highest priority ones
+	void RunPerceptionPhase();
+
+	EParallelForFlags GetParallelForFlags() const { return bParallelPerception ? EParallelForFlags::None : EParallelForFlags::ForceSingleThread; }
+
+	// Time since the pair's last update, scaled up by how close and how aware the perceiver is.
+	// Pairs that have never been updated come first. Negative for pairs that can't be updated at all
+	float GetPairPriority(const UGAPerceptionComponent* PerceptionComponent, const UGATargetComponent* TargetComponent, float Now) const;
+
+	struct FScheduledPair
+	{
+		UGAPerceptionComponent* PerceptionComponent;
+		UGATargetComponent* TargetComponent;
+		float Priority;
+		bool bInCone;
+	};
+
+	// Scheduling scratch, kept between frames
+	TArray<FScheduledPair> ScheduledPairs;
+
+	// A chunk of perceivers' worth of the parallel part of the phase: its own scratch, and the pairs it scored
+	struct FPerceptionChunk
+	{
+		TArray<FScheduledPair> Pairs;
+		TArray<UGATargetComponent*> Targets;
+		TArray<int32> Candidates;
+		TBitArray<> CandidateBits;
+		TBitArray<> InCone;
+		FGAConeTestBatch ConeBatch;
+	};
+
+	TArray<FPerceptionChunk> PerceptionChunks;
+
+	// Gather, cone test and score one perceiver's pairs into the chunk
+	void ScorePerceiverPairs(const UGAPerceptionComponent* PerceptionComponent, FPerceptionChunk& Chunk, float Now);
+
+	// LOS results waiting to be integrated into the awareness table
+	struct FLosResult
+	{
+		const UGAPerceptionComponent* PerceptionComponent;
+		int32 TargetSlot;
+		bool bClear;
+	};
+
+	TArray<FLosResult> LosResults;
+
+	void AddLosResult(const UGAPerceptionComponent* PerceptionComponent, const UGATargetComponent* TargetComponent, bool bClear);
+
+	// Integrate (and empty) LosResults
+	void IntegrateLosResults();
+
+	// Update one pair, either right away or by queuing its trace (only pairs that passed the cone test get one)
+	void UpdatePair(UGAPerceptionComponent* PerceptionComponent, UGATargetComponent* TargetComponent, bool bInCone);
+
+	// Apply the results of last frame's async traces
+	void ApplyPendingTraces();
+
+	// The pair's flag in the awareness table's TraceInFlight. Only ever set or cleared on the game thread, so the
+	// scoring workers can read it
+	bool IsTraceInFlight(const UGAPerceptionComponent* PerceptionComponent, const UGATargetComponent* TargetComponent) const;
+	void SetTraceInFlight(const UGAPerceptionComponent* PerceptionComponent, const UGATargetComponent* TargetComponent, bool bInFlight);
+
+	struct FPendingTrace
+	{
+		TWeakObjectPtr<UGAPerceptionComponent> PerceptionComponent;
+		TWeakObjectPtr<UGATargetComponent> TargetComponent;
+		FTraceHandle Handle;
+
+		// Squadmates waiting on this trace instead of making their own
+		TArray<TWeakObjectPtr<UGAPerceptionComponent>, TInlineAllocator<4>> Sharers;
+
+		// For the LOS cache
+		FVector TraceStart;
+		FVector TraceEnd;
+		float Time;
+	};
+
+	TArray<FPendingTrace> PendingTraces;
+
+	// A squadmate's trace to the target that's still in flight and that this perceiver can share (see bShareSquadLos)
+	FPendingTrace* FindSquadPendingTrace(const UGAPerceptionComponent* PerceptionComponent, const UGATargetComponent* TargetComponent, const FVector& TraceStart, const FVector& TraceEnd);
+
+	// Each squad's latest LOS result per target slot
+	struct FSquadLos
+	{
+		FVector TraceStart = FVector::ZeroVector;
+		FVector TraceEnd = FVector::ZeroVector;
+		float Time = -1.0f;
+		bool bClear = false;
+	};
+
+	TMap<FName, TArray<FSquadLos>> SquadLos;
+
+	void RefreshFrameVisibility(const AGAGridActor* Grid);
+
+	// The union, and which frame / grid it was built for
+	TBitArray<> FrameVisibleCells;
+	uint64 FrameVisibilityFrame = MAX_uint64;
+	TWeakObjectPtr<const AGAGridActor> FrameVisibilityGrid;
+
+	// Per perceiver scratch for the parallel path, kept around between frames
+	TArray<TBitArray<>> PerceiverVisibleCells;
+
+	// Publish the bank's last run, observe the occupancy map targets in sight, then launch the steps that are due
+	void UpdateOccupancyBank(float DeltaTime);
+
+	FGAOccupancyBank OccupancyBank;
+
+	// Time not yet simulated
+	float OccupancyPendingTime = 0.0f;
+
+	FGANoiseFieldCache NoiseFields;
+
+	// Cached pointer to the grid actor
+	AGAGridActor* GetGridActor() const;
+
+	mutable TWeakObjectPtr<AGAGridActor> GridActor;
 };
\ No newline at end of file
@@ -0,0 +1,119 @@
+#include "GASpatialHash.h"
+
+
+void FGASpatialHash::SetCellSize(float NewCellSize)
+{
+	NewCellSize = FMath::Max(NewCellSize, 1.0f);
+	if (NewCellSize != CellSize)
+	{
+		CellSize = NewCellSize;
+		Reset();
+	}
+}
+
+void FGASpatialHash::Reset()
+{
+	Buckets.Reset();
+	ItemPositions.Reset();
+	ItemCells.Reset();
+	ItemValid.Reset();
+}
+
+
+void FGASpatialHash::Update(int32 Item, const FVector& Position)
+{
+	check(Item >= 0);
+
+	if (Item >= ItemValid.Num())
+	{
+		ItemPositions.SetNumZeroed(Item + 1);
+		ItemCells.SetNumZeroed(Item + 1);
+		ItemValid.Add(false, Item + 1 - ItemValid.Num());
+	}
+
+	const FIntPoint Cell = ToCell(Position);
+	ItemPositions[Item] = Position;
+
+	if (ItemValid[Item])
+	{
+		if (ItemCells[Item] == Cell)
+		{
+			return;
+		}
+
+		TArray<int32>* OldBucket = Buckets.Find(ItemCells[Item]);
+		if (OldBucket)
+		{
+			OldBucket->RemoveSingleSwap(Item, EAllowShrinking::No);
+		}
+	}
+
+	Buckets.FindOrAdd(Cell).Add(Item);
+	ItemCells[Item] = Cell;
+	ItemValid[Item] = true;
+}
+
+void FGASpatialHash::Remove(int32 Item)
+{
+	if (!ItemValid.IsValidIndex(Item) || !ItemValid[Item])
+	{
+		return;
+	}
+
+	TArray<int32>* Bucket = Buckets.Find(ItemCells[Item]);
+	if (Bucket)
+	{
+		Bucket->RemoveSingleSwap(Item, EAllowShrinking::No);
+	}
+	ItemValid[Item] = false;
+}
+
+
+void FGASpatialHash::Query(const FVector& Center, float Radius, TArray<int32>& ItemsOut) const
+{
+	if (Radius < 0.0f)
+	{
+		return;
+	}
+
+	const float RadiusSquared = Radius * Radius;
+	auto AddBucket = [&](const TArray<int32>& Bucket)
+	{
+		for (int32 Item : Bucket)
+		{
+			if (FVector::DistSquared(ItemPositions[Item], Center) <= RadiusSquared)
+			{
+				ItemsOut.Add(Item);
+			}
+		}
+	};
+
+	const FIntPoint MinCell = ToCell(Center - FVector(Radius, Radius, 0.0f));
+	const FIntPoint MaxCell = ToCell(Center + FVector(Radius, Radius, 0.0f));
+	const int64 CellCount = int64(MaxCell.X - MinCell.X + 1) * int64(MaxCell.Y - MinCell.Y + 1);
+
+	if (CellCount > Buckets.Num())
+	{
+		// A radius this big relative to the cells would visit mostly empty ones, so go through the buckets instead
+		for (const TPair<FIntPoint, TArray<int32>>& Pair : Buckets)
+		{
+			if ((Pair.Key.X >= MinCell.X) && (Pair.Key.X <= MaxCell.X) && (Pair.Key.Y >= MinCell.Y) && (Pair.Key.Y <= MaxCell.Y))
+			{
+				AddBucket(Pair.Value);
+			}
+		}
+		return;
+	}
+
+	for (int32 Y = MinCell.Y; Y <= MaxCell.Y; Y++)
+	{
+		for (int32 X = MinCell.X; X <= MaxCell.X; X++)
+		{
+			const TArray<int32>* Bucket = Buckets.Find(FIntPoint(X, Y));
+			if (Bucket)
+			{
+				AddBucket(*Bucket);
+			}
+		}
+	}
+}
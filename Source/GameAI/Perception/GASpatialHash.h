@@ -0,0 +1,43 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+
+// A uniform spatial hash over the XY plane, for the perception system's broad phase
+// Items are small integer ids (the perception system uses target slots) which each sit in the bucket of the square
+// cell holding their last known position. Moving an item only touches the buckets when it crosses into another cell.
+// Queries are against the positions as of the last Update.
+
+struct FGASpatialHash
+{
+	FGASpatialHash() : CellSize(1000.0f) {}
+
+	// Changing the cell size empties the hash
+	void SetCellSize(float NewCellSize);
+	float GetCellSize() const { return CellSize; }
+
+	// Add the item, or move it to its new position
+	void Update(int32 Item, const FVector& Position);
+
+	void Remove(int32 Item);
+
+	void Reset();
+
+	// Append every item within Radius (3D distance) of Center to ItemsOut
+	void Query(const FVector& Center, float Radius, TArray<int32>& ItemsOut) const;
+
+protected:
+	FORCEINLINE FIntPoint ToCell(const FVector& Position) const
+	{
+		return FIntPoint(FMath::FloorToInt32(Position.X / CellSize), FMath::FloorToInt32(Position.Y / CellSize));
+	}
+
+	float CellSize;
+
+	TMap<FIntPoint, TArray<int32>> Buckets;
+
+	// Per item (indexed by item id)
+	TArray<FVector> ItemPositions;
+	TArray<FIntPoint> ItemCells;
+	TBitArray<> ItemValid;
+};
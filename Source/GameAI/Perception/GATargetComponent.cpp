@@ -45,6 +45,48 @@ AGAGridActor* UGATargetComponent::GetGridActor() const
 }
 
 
+float UGATargetComponent::GetOccupancyInRadius(const FVector& Position, int32 RadiusCells) const
+{
+	const AGAGridActor* Grid = GetGridActor();
+	if (!Grid)
+	{
+		return 0.0f;
+	}
+
+	if (TrackerMode == GATTM_Particles)
+	{
+		FCellRef Cell = Grid->GetCellRef(Position, true);
+		return Cell.IsValid() ? ParticleTracker.GetWeightInBox(FGAGridMapIntegral::GetRadiusBox(Cell.X, Cell.Y, FMath::Max(RadiusCells, 0))) : 0.0f;
+	}
+
+	if (TrackerMode == GATTM_OccupancyMap)
+	{
+		const UGAPerceptionSystem* PerceptionSystem = UGAPerceptionSystem::GetPerceptionSystem(this);
+		FCellRef Cell = Grid->GetCellRef(Position, true);
+		return (PerceptionSystem && Cell.IsValid()) ? PerceptionSystem->GetOccupancyBank().GetSumInBox(TargetSlot, FGAGridMapIntegral::GetRadiusBox(Cell.X, Cell.Y, FMath::Max(RadiusCells, 0))) : 0.0f;
+	}
+
+	if (!OccupancyMap.IsValid())
+	{
+		return 0.0f;
+	}
+
+	if (bOccupancyIntegralDirty)
+	{
+		OccupancyIntegral.Build(OccupancyMap);
+		bOccupancyIntegralDirty = false;
+	}
+
+	FCellRef Cell = Grid->GetCellRef(Position, true);
+	if (!Cell.IsValid())
+	{
+		return 0.0f;
+	}
+
+	return float(OccupancyIntegral.GetBoxSum(FGAGridMapIntegral::GetRadiusBox(Cell.X, Cell.Y, FMath::Max(RadiusCells, 0))));
+}
+
+
 void UGATargetComponent::OnRegister()
 {
 	Super::OnRegister();
@@ -55,17 +97,30 @@ void UGATargetComponent::OnRegister()
 		PerceptionSystem->RegisterTargetComponent(this);
 	}
 
+	// Only a private map needs one of its own (grid sized)
 	const AGAGridActor* Grid = GetGridActor();
-	if (Grid)
+	if (Grid && (TrackerMode == GATTM_PrivateOccupancyMap))
 	{
-		OccupancyMap = FGAGridMap(Grid, 0.0f);
+		InitOccupancyMap(Grid);
 	}
 }
 
+void UGATargetComponent::InitOccupancyMap(const AGAGridActor* Grid)
+{
+	// Starts out with no tiles at all
+	OccupancyMap = FGASparseGridMap(Grid, 0.0f);
+
+	OccupancyMaxCell = FCellRef();
+	OccupancySimulation.Init(OccupancyMap);
+}
+
 void UGATargetComponent::OnUnregister()
 {
 	Super::OnUnregister();
 
+	// Don't leave a run going after we're gone
+	OccupancySimulation.Reset();
+
 	UGAPerceptionSystem* PerceptionSystem = UGAPerceptionSystem::GetPerceptionSystem(this);
 	if (PerceptionSystem)
 	{
@@ -85,16 +140,7 @@ void UGATargetComponent::TickComponent(float DeltaTime, enum ELevelTick TickType
 	UGAPerceptionSystem* PerceptionSystem = UGAPerceptionSystem::GetPerceptionSystem(this);
 	if (PerceptionSystem)
 	{
-		TArray<TObjectPtr<UGAPerceptionComponent>> &PerceptionComponents = PerceptionSystem->GetAllPerceptionComponents();
-		for (UGAPerceptionComponent* PerceptionComponent : PerceptionComponents)
-		{
-			const FTargetData* TargetData = PerceptionComponent->GetTargetData(TargetGuid);
-			if (TargetData && (TargetData->Awareness >= 1.0f))
-			{
-				isImmediate = true;
-				break;
-			}
-		}
+		isImmediate = PerceptionSystem->GetMaxAwareness(this) >= 1.0f;
 	}
 
 	if (isImmediate)
@@ -106,29 +152,98 @@ void UGATargetComponent::TickComponent(float DeltaTime, enum ELevelTick TickType
 		LastKnownState.Set(Owner->GetActorLocation(), Owner->GetVelocity());
 
 		// Tell the omap to clear out and put all the probability in the observed location
-		OccupancyMapSetPosition(LastKnownState.Position);
+		if (TrackerMode == GATTM_Particles)
+		{
+			ParticleTracker.Observe(GetGridActor(), LastKnownState.Position, LastKnownState.Velocity, ParticleCount, ParticleWanderSpeed);
+		}
+		else if (TrackerMode == GATTM_OccupancyMap)
+		{
+			// (the perception system has already done it, in this frame's bank update)
+		}
+		else if (bFixedRateOccupancy)
+		{
+			// (the simulation picks this up with its next run)
+			AGAGridActor* Grid = GetGridActor();
+			OccupancyObservedCell = Grid ? Grid->GetCellRef(LastKnownState.Position, true) : FCellRef();
+			bOccupancyObservationPending = OccupancyObservedCell.IsValid();
+		}
+		else
+		{
+			OccupancyMapSetPosition(LastKnownState.Position);
+		}
 	}
 	else if (IsKnown())
 	{
 		LastKnownState.State = GATS_Hidden;
 	}
 
-	if (LastKnownState.State == GATS_Hidden)
+	if (TrackerMode == GATTM_Particles)
+	{
+		ParticleTrackerTick(DeltaTime);
+	}
+	else if (TrackerMode == GATTM_OccupancyMap)
+	{
+		SharedOccupancyTick();
+	}
+	else if (bFixedRateOccupancy)
 	{
-		OccupancyMapUpdate();
+		OccupancySimulationTick(DeltaTime);
 	}
+	else
+	{
+		// The simulation's copy of the map is going stale
+		if (OccupancySimulation.IsInitialized())
+		{
+			OccupancySimulation.Reset();
+		}
 
-	// As long as I'm known, whether I'm immediate or not, diffuse the probability in the omap
+		AGAGridActor* Grid = GetGridActor();
+		if (Grid && !OccupancyMap.IsValid())
+		{
+			InitOccupancyMap(Grid);
+		}
 
-	if (IsKnown())
-	{
-		OccupancyMapDiffuse();
+		if (LastKnownState.State == GATS_Hidden)
+		{
+			OccupancyMapUpdate();
+		}
+
+		// As long as I'm known, whether I'm immediate or not, diffuse the probability in the omap
+
+		if (IsKnown())
+		{
+			OccupancyMapDiffuse();
+		}
 	}
 
 	if (bDebugOccupancyMap)
 	{
 		AGAGridActor* Grid = GetGridActor();
-		Grid->DebugGridMap = OccupancyMap;
+		if (TrackerMode == GATTM_Particles)
+		{
+			// Show where the particles are
+			if (Grid->DebugGridMap.IsIndexCompatible(Grid))
+			{
+				Grid->DebugGridMap.ResetData(0.0f);
+			}
+			else
+			{
+				Grid->DebugGridMap = FGAGridMap(Grid, 0.0f);
+			}
+			ParticleTracker.Rasterize(Grid->DebugGridMap);
+		}
+		else if ((TrackerMode == GATTM_OccupancyMap) && PerceptionSystem)
+		{
+			if (!Grid->DebugGridMap.IsIndexCompatible(Grid))
+			{
+				Grid->DebugGridMap = FGAGridMap(Grid, 0.0f);
+			}
+			PerceptionSystem->GetOccupancyBank().ExportChannel(TargetSlot, Grid->DebugGridMap);
+		}
+		else
+		{
+			OccupancyMap.Densify(Grid->DebugGridMap);
+		}
 		GridActor->RefreshDebugTexture();
 		GridActor->DebugMeshComponent->SetVisibility(true);
 	}
@@ -137,6 +252,9 @@ void UGATargetComponent::TickComponent(float DeltaTime, enum ELevelTick TickType
 
 void UGATargetComponent::OccupancyMapSetPosition(const FVector& Position)
 {
+	// Any density queries need to see the new map
+	bOccupancyIntegralDirty = true;
+
 	// TODO PART 4
 
 	// We've been observed to be in a given position
@@ -146,109 +264,101 @@ void UGATargetComponent::OccupancyMapSetPosition(const FVector& Position)
 	AGAGridActor* Grid = GetGridActor();
 	if (!Grid) return;
 
-	// Clear the entire occupancy map
+	// Clear the occupancy map (this just drops its tiles)
 	OccupancyMap.ResetData(0.0f);
+	OccupancyMaxCell = FCellRef();
 
 	// Convert position to the closest grid cell
 	FCellRef TargetCell = Grid->GetCellRef(Position, true);
-	if (TargetCell.IsValid())
+	if (TargetCell.IsValid() && OccupancyMap.SetValue(TargetCell, 1.0f))
 	{
 		// Set probability at the observed position to 100%
-		OccupancyMap.SetValue(TargetCell, 1.0f);
+		OccupancyMaxCell = TargetCell;
 	}
 
 }
 
 
+void UGATargetComponent::ObserveNoise(const FVector& Position)
+{
+	if (LastKnownState.State != GATS_Hidden)
+	{
+		return;
+	}
+
+	AGAGridActor* Grid = GetGridActor();
+	if (!Grid)
+	{
+		return;
+	}
+
+	LastKnownState.Position = Position;
+
+	// Where I'm headed isn't something a noise gives away
+	if (TrackerMode == GATTM_Particles)
+	{
+		ParticleTracker.Observe(Grid, Position, FVector::ZeroVector, ParticleCount, ParticleWanderSpeed);
+	}
+	else if (TrackerMode == GATTM_PrivateOccupancyMap)
+	{
+		if (bFixedRateOccupancy)
+		{
+			OccupancyObservedCell = Grid->GetCellRef(Position, true);
+			bOccupancyObservationPending = OccupancyObservedCell.IsValid();
+		}
+		else
+		{
+			OccupancyMapSetPosition(Position);
+		}
+	}
+}
+
+
 void UGATargetComponent::OccupancyMapUpdate()
 {
+	bOccupancyIntegralDirty = true;
+
 	const AGAGridActor* Grid = GetGridActor();
-	if (Grid)
+	if (Grid && OccupancyMap.IsValid())
 	{
-		FGAGridMap VisibilityMap(Grid, 0.0f);
-
 		// TODO PART 4
 
 		// STEP 1: Build a visibility map, based on the perception components of the AIs in the world
 		// The visibility map is a simple map where each cell is either 0 (not currently visible to ANY perceiver) or 1 (currently visible to one or more perceivers).
-		// 
-
+		// Here it's a bitset indexed like the grid's own cell data. It doesn't depend on the target, so the perception
+		// system builds it once per frame and every target shares it
 		UGAPerceptionSystem* PerceptionSystem = UGAPerceptionSystem::GetPerceptionSystem(this);
-		if (PerceptionSystem)
-		{
-			TArray<TObjectPtr<UGAPerceptionComponent>>& PerceptionComponents = PerceptionSystem->GetAllPerceptionComponents();
-			for (UGAPerceptionComponent* PerceptionComponent : PerceptionComponents)
-			{
-				// Find visible cells for this perceiver.
-				// Reminder: Use the PerceptionComponent.VisionParameters when determining whether a cell is visible or not (in addition to a line trace).
-				// Suggestion: you might find it useful to add a UGAPerceptionComponent::TestVisibility method to the perception component.
-				for (int X = 0; X < Grid->XCount; X++)
-				{
-					for (int Y = 0; Y < Grid->YCount; Y++)
-					{
-						FCellRef Cell(X, Y);
-						if (PerceptionComponent->TestVisibility(Cell))
-						{
-							VisibilityMap.SetValue(Cell, 1.0f);
-						}
-					}
-				}
-			}
-		}
+		TBitArray<> NothingVisible;
+		const TBitArray<>& VisibleCells = PerceptionSystem ? PerceptionSystem->GetFrameVisibility(Grid) : NothingVisible;
 
 
 		// STEP 2: Clear out the probability in the visible cells
-		float Pculled = 0.0f;
-		for (int i = 0; i < OccupancyMap.Data.Num(); i++)
-		{
-			if (VisibilityMap.Data[i] > 0)  // If cell is visible
-			{
-				Pculled += OccupancyMap.Data[i];  // Sum up probability of visible cells
-				OccupancyMap.Data[i] = 0.0f;      // Clear visible cells
-			}
-		}
-
 		// STEP 3: Renormalize the OMap, so that it's still a valid probability distribution
-		/*float Sum = 0.0f;
-		for (float Value : OccupancyMap.Data)
-		{
-			Sum += Value;
-		}
+		// (Shared with the fixed rate simulation, which does the same thing on a worker)
+		FGAOccupancySimulation::CullVisibleCells(OccupancyMap, Grid->GetCellIndexer(), VisibleCells);
 
-		if (Sum > 0)
-		{
-			for (float& Value : OccupancyMap.Data)
-			{
-				Value /= Sum;
-			}
-		}*/
-		if (Pculled < 1.0f) // Avoid division by zero
+		// STEP 4: Extract the highest-likelihood cell on the omap and refresh the LastKnownState.
+		// Normally that's just the max the last diffusion pass found. Only if it got culled do we have to ask the map
+		// (which only scans its allocated tiles)
+		if (OccupancyMaxCell.IsValid())
 		{
-			float ScaleFactor = 1.0f / (1.0f - Pculled);
-			for (float& Value : OccupancyMap.Data)
+			const int32 MaxCellIndex = Grid->CellRefToIndex(OccupancyMaxCell);
+			if (VisibleCells.IsValidIndex(MaxCellIndex) && VisibleCells[MaxCellIndex])
 			{
-				Value *= ScaleFactor;
+				OccupancyMaxCell = FCellRef();
 			}
 		}
 
-		// STEP 4: Extract the highest-likelihood cell on the omap and refresh the LastKnownState.
-		float MaxValue = -UE_MAX_FLT;
-		FCellRef BestCell;
-		for (int X = 0; X < Grid->XCount; X++)
+		if (!OccupancyMaxCell.IsValid())
 		{
-			for (int Y = 0; Y < Grid->YCount; Y++)
-			{
-				FCellRef Cell(X, Y);
-				float Value;
-				if (OccupancyMap.GetValue(Cell, Value) && Value > MaxValue)
-				{
-					MaxValue = Value;
-					BestCell = Cell;
-				}
-			}
+			float MaxValue = -UE_MAX_FLT;
+			OccupancyMap.ArgMax(OccupancyMaxCell, MaxValue);
 		}
 
-		LastKnownState.Position = Grid->GetCellPosition(BestCell);
+		if (OccupancyMaxCell.IsValid())
+		{
+			LastKnownState.Position = Grid->GetCellPosition(OccupancyMaxCell);
+		}
 
 	}
 
@@ -257,88 +367,150 @@ void UGATargetComponent::OccupancyMapUpdate()
 
 void UGATargetComponent::OccupancyMapDiffuse()
 {
+	bOccupancyIntegralDirty = true;
+
 	// TODO PART 4
 	// Diffuse the probability in the OMAP
 
 	const AGAGridActor* Grid = GetGridActor();
 	if (!Grid) return;
 
-	// Create a temporary buffer for new probability values
-	FGAGridMap DiffusedMap(Grid, 0.0f);
+	// Every traversable cell hands OccupancyDiffusionRate of its probability to each traversable neighbor
+	// (divided by sqrt(2) for the diagonals) and keeps the rest. Probability on non-traversable cells is dropped.
+	// The diffuser keeps its scratch buffers and per-cell neighbor masks from tick to tick
+	// Only the allocated tiles (and the ring of tiles they spread into) are touched
+	OccupancyDiffuser.Diffuse(Grid, OccupancyMap, OccupancyDiffusionRate, 1);
+
+	float MaxValue = -UE_MAX_FLT;
+	if (!OccupancyDiffuser.GetLastMax(OccupancyMaxCell, MaxValue))
+	{
+		OccupancyMaxCell = FCellRef();
+	}
+}
+
+
+void UGATargetComponent::OccupancySimulationTick(float DeltaTime)
+{
+	const AGAGridActor* Grid = GetGridActor();
+	if (!Grid)
+	{
+		return;
+	}
 
-	// Diffusion factor 
-	const float DiffusionRate = 0.2f;  //  in the pseudocode
+	if (!OccupancyMap.IsValid())
+	{
+		InitOccupancyMap(Grid);
+	}
+	else if (!OccupancySimulation.IsInitialized())
+	{
+		OccupancySimulation.Init(OccupancyMap);
+	}
 
-	// Iterate through all cells in the occupancy map
-	for (int X = 0; X < Grid->XCount; X++)
+	// Pick up the last run's result, if it's done. Readers never wait: until then they see the previous map
+	FCellRef MostLikelyCell;
+	if (OccupancySimulation.Publish(OccupancyMap, MostLikelyCell))
 	{
-		for (int Y = 0; Y < Grid->YCount; Y++)
+		bOccupancyIntegralDirty = true;
+		OccupancyMaxCell = MostLikelyCell;
+
+		if ((LastKnownState.State == GATS_Hidden) && MostLikelyCell.IsValid())
 		{
-			FCellRef Cell(X, Y);
-			float CurrentValue;
+			LastKnownState.Position = Grid->GetCellPosition(MostLikelyCell);
+		}
+	}
 
-			// Skip non-traversable cells
-			if (!EnumHasAllFlags(Grid->GetCellData(Cell), ECellData::CellDataTraversable))
-			{
-				continue;
-			}
+	// Nothing to simulate until I've been seen
+	if (!IsKnown())
+	{
+		OccupancyPendingTime = 0.0f;
+		return;
+	}
 
-			// Get current probability value
-			if (!OccupancyMap.GetValue(Cell, CurrentValue))
-			{
-				continue; // Skip if value retrieval failed
-			}
+	OccupancyPendingTime += DeltaTime;
+	if (OccupancySimulation.IsBusy())
+	{
+		return;
+	}
 
-			float RemainingProbability = CurrentValue; // pLEFT
-
-			// Define the 8 neighboring cells
-			TArray<FCellRef> Neighbors = {
-				FCellRef(X + 1, Y),     // Right
-				FCellRef(X - 1, Y),     // Left
-				FCellRef(X, Y + 1),     // Up
-				FCellRef(X, Y - 1),     // Down
-				FCellRef(X + 1, Y + 1), // Top-Right (Diagonal)
-				FCellRef(X - 1, Y + 1), // Top-Left (Diagonal)
-				FCellRef(X + 1, Y - 1), // Bottom-Right (Diagonal)
-				FCellRef(X - 1, Y - 1)  // Bottom-Left (Diagonal)
-			};
-
-			// Distribute probability to neighbors
-			for (const FCellRef& Neighbor : Neighbors)
-			{
-				// Skip out-of-bounds or non-traversable cells early
-				if (!Grid->IsCellRefInBounds(Neighbor) ||
-					!EnumHasAllFlags(Grid->GetCellData(Neighbor), ECellData::CellDataTraversable))
-				{
-					continue;
-				}
-
-				float DiffuseAmount = DiffusionRate * CurrentValue;
-
-				// Reduce diffusion for diagonal neighbors (1 / sqrt(2))
-				if (Neighbor.X != X && Neighbor.Y != Y)
-				{
-					DiffuseAmount /= FMath::Sqrt(2.0f);
-				}
-
-				float NeighborValue = 0.0f;
-				if (DiffusedMap.GetValue(Neighbor, NeighborValue))
-				{
-					DiffusedMap.SetValue(Neighbor, NeighborValue + DiffuseAmount);
-				}
-
-				RemainingProbability -= DiffuseAmount;
-			}
+	const int32 Steps = FGAOccupancySimulation::ConsumeFixedSteps(OccupancyPendingTime, OccupancyStepRate, MaxOccupancyStepsPerRun);
+	if ((Steps == 0) && !bOccupancyObservationPending)
+	{
+		return;
+	}
 
-			// Store the remaining probability in the original cell
-			float CellValue = 0.0f;
-			if (DiffusedMap.GetValue(Cell, CellValue))
-			{
-				DiffusedMap.SetValue(Cell, CellValue + RemainingProbability);
-			}
+	FGAOccupancySimulationInput Input;
+	Input.bObserved = bOccupancyObservationPending;
+	Input.ObservedCell = OccupancyObservedCell;
+	Input.Steps = Steps;
+	Input.DiffusionRate = OccupancyDiffusionRate;
+
+	if (LastKnownState.State == GATS_Hidden)
+	{
+		// Snapshot the perceivers' view now: the worker can't go back to the perception system for it
+		UGAPerceptionSystem* PerceptionSystem = UGAPerceptionSystem::GetPerceptionSystem(this);
+		if (PerceptionSystem)
+		{
+			Input.bCullVisible = true;
+			Input.VisibleCells = PerceptionSystem->GetFrameVisibility(Grid);
+			Input.CellIndexer = Grid->GetCellIndexer();
 		}
 	}
 
-	// Copy the buffer back to the occupancy map
-	OccupancyMap = DiffusedMap;
+	bOccupancyObservationPending = false;
+	OccupancySimulation.Launch(Grid, MoveTemp(Input));
+}
+
+
+void UGATargetComponent::SharedOccupancyTick()
+{
+	// The omap machinery isn't needed in this mode
+	if (OccupancySimulation.IsInitialized())
+	{
+		OccupancySimulation.Reset();
+	}
+
+	const AGAGridActor* Grid = GetGridActor();
+	const UGAPerceptionSystem* PerceptionSystem = UGAPerceptionSystem::GetPerceptionSystem(this);
+	if (!Grid || !PerceptionSystem || (LastKnownState.State != GATS_Hidden))
+	{
+		return;
+	}
+
+	FCellRef BestCell;
+	if (PerceptionSystem->GetOccupancyBank().GetMostLikelyCell(TargetSlot, BestCell) && Grid->IsCellRefInBounds(BestCell))
+	{
+		LastKnownState.Position = Grid->GetCellPosition(BestCell);
+	}
+}
+
+void UGATargetComponent::ParticleTrackerTick(float DeltaTime)
+{
+	const AGAGridActor* Grid = GetGridActor();
+	if (!Grid || !IsKnown())
+	{
+		return;
+	}
+
+	// The omap machinery isn't needed in this mode
+	if (OccupancySimulation.IsInitialized())
+	{
+		OccupancySimulation.Reset();
+	}
+
+	ParticleTracker.Propagate(Grid, DeltaTime, ParticleWanderSpeed, ParticleTurnRate);
+
+	if (LastKnownState.State == GATS_Hidden)
+	{
+		UGAPerceptionSystem* PerceptionSystem = UGAPerceptionSystem::GetPerceptionSystem(this);
+		if (PerceptionSystem)
+		{
+			ParticleTracker.Cull(Grid, PerceptionSystem->GetFrameVisibility(Grid));
+		}
+
+		FCellRef BestCell;
+		if (ParticleTracker.GetMostLikelyCell(BestCell) && Grid->IsCellRefInBounds(BestCell))
+		{
+			LastKnownState.Position = Grid->GetCellPosition(BestCell);
+		}
+	}
 }
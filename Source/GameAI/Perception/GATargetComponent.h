@@ -3,6 +3,11 @@
 #include "CoreMinimal.h"
 #include "Components/ActorComponent.h"
 #include "GameAI/Grid/GAGridMap.h"
+#include "GameAI/Grid/GASparseGridMap.h"
+#include "GameAI/Grid/GAGridMapIntegral.h"
+#include "GameAI/Grid/GAGridDiffusion.h"
+#include "GAOccupancySimulation.h"
+#include "GAParticleTracker.h"
 #include "GATargetComponent.generated.h"
 
 
@@ -17,6 +22,16 @@ enum ETargetState
 };
 
 
+// How a target keeps track of where it might be while hidden
+UENUM(BlueprintType)
+enum ETargetTrackerMode
+{
+	GATTM_OccupancyMap	UMETA(DisplayName = "Occupancy Map"),	// a probability for every cell of the grid, in a channel of the perception system's FGAOccupancyBank
+	GATTM_Particles		UMETA(DisplayName = "Particles"),		// a fixed number of weighted particles (see FGAParticleTracker)
+	GATTM_PrivateOccupancyMap	UMETA(DisplayName = "Private Occupancy Map"),	// an occupancy map of the target's own (OccupancyMap)
+};
+
+
 // Cached information about a target
 USTRUCT(BlueprintType)
 struct FTargetCache
@@ -53,18 +68,59 @@ class UGATargetComponent : public UActorComponent
 	UPROPERTY(BlueprintReadOnly)
 	FGuid TargetGuid;
 
+	// My column in the perception system's awareness table (INDEX_NONE until I register with the perception system)
+	int32 TargetSlot = INDEX_NONE;
+
 	// Last known state of the target
 	UPROPERTY(BlueprintReadOnly)
 	FTargetCache LastKnownState;
 	
-	// Occupancy Map
+	// Tracker mode. Occupancy maps are stepped by the perception system, every target's together, which costs far less
+	// than a map each once there are several targets (but they all share its diffusion and step rates). A private map
+	// is only worth it for a target that needs its own rates. Particles cost memory and time in proportion to
+	// ParticleCount rather than to the size of the grid, so they're the better fit for very large maps. All modes drive
+	// LastKnownState the same way
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	TEnumAsByte<ETargetTrackerMode> TrackerMode = GATTM_OccupancyMap;
 
-	UPROPERTY(BlueprintReadOnly)
-	FGAGridMap OccupancyMap;
+	// Private Occupancy Map
+
+	// Sparse: only the tiles the probability has spread into are allocated (use Densify() for a full grid copy)
+	FGASparseGridMap OccupancyMap;
 
 	UPROPERTY(BlueprintReadOnly)
 	bool bDebugOccupancyMap = true;
 
+	// Fraction of a cell's probability that spreads to each of its (orthogonal) neighbors per diffusion step
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	float OccupancyDiffusionRate = 0.2f;
+
+	// Step the occupancy map at a fixed rate on a worker task, instead of once per frame on the game thread.
+	// The map (and LastKnownState) then change whenever a run of steps finishes, independently of the frame rate
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	bool bFixedRateOccupancy = true;
+
+	// Occupancy steps per second, when bFixedRateOccupancy
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, meta = (ClampMin = "1.0"))
+	float OccupancyStepRate = 30.0f;
+
+	// Most steps a single run catches up on. If the simulation falls further behind than this, the rest are dropped
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, meta = (ClampMin = "1"))
+	int32 MaxOccupancyStepsPerRun = 4;
+
+	// Particles
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, meta = (ClampMin = "1"))
+	int32 ParticleCount = 1024;
+
+	// How fast a hidden target is assumed to wander about (on top of its last known velocity), in world units per second
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, meta = (ClampMin = "0.0"))
+	float ParticleWanderSpeed = 300.0f;
+
+	// How often a particle picks a new heading, per second
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, meta = (ClampMin = "0.0"))
+	float ParticleTurnRate = 0.5f;
+
 
 	// Cached pointer to the grid actor
 	UPROPERTY()
@@ -82,6 +138,11 @@ class UGATargetComponent : public UActorComponent
 	UFUNCTION(BlueprintCallable)
 	AGAGridActor *GetGridActor() const;
 
+	// Total occupancy probability within RadiusCells cells (a square neighborhood) of the given position
+	// (in particle mode, the weight of the particles there)
+	UFUNCTION(BlueprintCallable)
+	float GetOccupancyInRadius(const FVector& Position, int32 RadiusCells) const;
+
 	// Return TRUE if at least ONE AI has reach Awareness == 1 for this target
 	bool IsKnown() const
 	{
@@ -99,7 +160,46 @@ class UGATargetComponent : public UActorComponent
 	virtual void TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
 
 	void OccupancyMapSetPosition(const FVector &Position);
+
+	// I was heard at Position while hidden: start my private map or particles over from there (the perception system
+	// does the same to an occupancy map in its bank)
+	void ObserveNoise(const FVector& Position);
+
 	void OccupancyMapUpdate();
 	void OccupancyMapDiffuse();
 
+protected:
+	// Summed-area table of the occupancy map, rebuilt on demand by the first density query after the map changes
+	mutable FGAGridMapIntegral OccupancyIntegral;
+	mutable bool bOccupancyIntegralDirty = true;
+
+	// Highest cell of OccupancyMap as of the last diffusion (or sighting), if it's still known. Culling only lowers
+	// cells and rescales the rest, so it stays the highest unless it gets culled itself
+	FCellRef OccupancyMaxCell;
+
+	FGASparseGridDiffuser OccupancyDiffuser;
+
+	// Build the (empty) occupancy map over the grid
+	void InitOccupancyMap(const AGAGridActor* Grid);
+
+	// Fixed rate mode: publish any finished run, then launch the next one if it's due
+	void OccupancySimulationTick(float DeltaTime);
+
+	// Particle mode: move the particles on, cull the visible ones and refresh LastKnownState
+	void ParticleTrackerTick(float DeltaTime);
+
+	// Occupancy map mode: refresh LastKnownState from the bank (which the perception system has already stepped)
+	void SharedOccupancyTick();
+
+	FGAParticleTracker ParticleTracker;
+
+	FGAOccupancySimulation OccupancySimulation;
+
+	// Time not yet simulated
+	float OccupancyPendingTime = 0.0f;
+
+	// Last place I was seen since the last run was launched
+	bool bOccupancyObservationPending = false;
+	FCellRef OccupancyObservedCell;
+
 };
\ No newline at end of file
@@ -10,6 +10,7 @@
 #include "EnhancedInputComponent.h"
 #include "EnhancedInputSubsystems.h"
 #include "InputActionValue.h"
+#include "GameAI/Perception/GAPerceptionSystem.h"
 
 DEFINE_LOG_CATEGORY(LogTemplatePlayer);
 
@@ -18,6 +19,9 @@ DEFINE_LOG_CATEGORY(LogTemplatePlayer);
 
 AGAPlayerCharacter::AGAPlayerCharacter()
 {
+	// Ticks to make footstep noises
+	PrimaryActorTick.bCanEverTick = true;
+
 	// Set size for collision capsule
 	GetCapsuleComponent()->InitCapsuleSize(42.f, 96.0f);
 		
@@ -69,6 +73,31 @@ void AGAPlayerCharacter::BeginPlay()
 	}
 }
 
+void AGAPlayerCharacter::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	const UCharacterMovementComponent* Movement = GetCharacterMovement();
+	if ((FootstepNoiseRange <= 0.0f) || (FootstepStride <= 0.0f) || !Movement->IsMovingOnGround())
+	{
+		return;
+	}
+
+	const float Speed = GetVelocity().Size2D();
+	FootstepDistance += Speed * DeltaSeconds;
+	if (FootstepDistance < FootstepStride)
+	{
+		return;
+	}
+	FootstepDistance = FMath::Fmod(FootstepDistance, FootstepStride);
+
+	if (UGAPerceptionSystem* PerceptionSystem = UGAPerceptionSystem::GetPerceptionSystem(this))
+	{
+		const float SpeedFraction = FMath::Clamp(Speed / FMath::Max(Movement->MaxWalkSpeed, 1.0f), 0.0f, 1.0f);
+		PerceptionSystem->ReportNoise(this, GetActorLocation(), FootstepNoiseRange * SpeedFraction);
+	}
+}
+
 //////////////////////////////////////////////////////////////////////////
 // Input
 
@@ -47,6 +47,16 @@ class AGAPlayerCharacter : public ACharacter
 public:
 	AGAPlayerCharacter();
 	
+	virtual void Tick(float DeltaSeconds) override;
+
+	/** Distance walked per footstep */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Noise)
+	float FootstepStride = 150.0f;
+
+	/** How far a footstep at full walking speed can be heard (slower steps are quieter). 0 for silent footsteps */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Noise)
+	float FootstepNoiseRange = 1200.0f;
+
 
 protected:
 
@@ -64,6 +74,9 @@ protected:
 	// To add mapping context
 	virtual void BeginPlay();
 
+	// Walked since the last footstep
+	float FootstepDistance = 0.0f;
+
 public:
 	/** Returns CameraBoom subobject **/
 	FORCEINLINE class USpringArmComponent* GetCameraBoom() const { return CameraBoom; }
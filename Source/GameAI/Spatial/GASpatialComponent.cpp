@@ -1,6 +1,7 @@
 #include "GASpatialComponent.h"
 #include "GameAI/Pathfinding/GAPathComponent.h"
 #include "GameAI/Grid/GAGridMap.h"
+#include "GameAI/Grid/GAGridMapIntegral.h"
 #include "Kismet/GameplayStatics.h"
 #include "Math/MathFwd.h"
 #include "GASpatialFunction.h"
@@ -183,28 +184,19 @@ bool UGASpatialComponent::ChoosePosition(bool PathfindToPosition, bool Debug)
 		}
 
 		// Step 3: pick the best cell in GridMap
+		// Only traversable cells are candidates, so mask the rest out of a scratch copy (GridMap itself
+		// is still wanted for debugging below) and take a bulk argmax.
+		// Note: the last row and column of the box are never evaluated, so they are excluded here too
 		FCellRef BestCell = FCellRef::Invalid;
 		float BestValue = -FLT_MAX;
-		
-		for (int32 Y = GridMap.GridBounds.MinY; Y < GridMap.GridBounds.MaxY; Y++)
-		{
-			for (int32 X = GridMap.GridBounds.MinX; X < GridMap.GridBounds.MaxX; X++)
-			{
-				FCellRef CellRef(X, Y);
-				float CellValue = 0.0f;
 
-				// Check if the cell is traversable and has a valid value
-				if (EnumHasAllFlags(Grid->GetCellData(CellRef), ECellData::CellDataTraversable) &&
-					GridMap.GetValue(CellRef, CellValue))
-				{
-					// Select the highest scoring cell
-					if (CellValue > BestValue)
-					{
-						BestValue = CellValue;
-						BestCell = CellRef;
-					}
-				}
-			}
+		FGAGridMap Candidates = GridMap;
+		Candidates.SelectTraversable(Grid, -FLT_MAX);
+
+		FGridBox EvaluatedBox(GridBox.MinX, GridBox.MaxX - 1, GridBox.MinY, GridBox.MaxY - 1);
+		if (!Candidates.ArgMax(EvaluatedBox, BestCell, BestValue) || (BestValue == -FLT_MAX))
+		{
+			BestCell = FCellRef::Invalid;
 		}
 
 		// Let's pretend for now we succeeded.
@@ -267,6 +259,26 @@ void UGASpatialComponent::EvaluateLayer(const FFunctionLayer& Layer, FGAGridMap
 
 	if (!OwnerPawn || !Grid || !World) return;
 
+	// Nothing to combine, so don't bother evaluating
+	if ((Layer.Op != SO_Add) && (Layer.Op != SO_Multiply)) return;
+
+	// The layer is evaluated into its own buffer and then combined into GridMap in one bulk pass.
+	// Cells we don't evaluate hold the identity of the combine op, so they come out unchanged.
+	FGAGridMap LayerMap(Grid, GridMap.GridBounds, (Layer.Op == SO_Multiply) ? 1.0f : 0.0f);
+
+	// Blur reads the accumulated buffer as it stands before this layer. Snapshot it once into a summed-area
+	// table, after which the average over any neighborhood is a constant time lookup
+	FGAGridMapIntegral BlurIntegral;
+	if (Layer.Input == SI_Blur)
+	{
+		BlurIntegral.Build(GridMap);
+	}
+
+	// Line of sight can come straight out of the grid's baked PVS (visibility is symmetric, so the target's PVS
+	// tells us which cells can see the target). Cells beyond the baked radius still need a trace
+	FCellRef TargetCell = Grid->GetCellRef(TargetLocation);
+	bool bUsePVS = (Layer.Input == SI_LOS) && Grid->HasPVS() && TargetCell.IsValid();
+
 	for (int32 Y = GridMap.GridBounds.MinY; Y < GridMap.GridBounds.MaxY; Y++)
 	{
 		for (int32 X = GridMap.GridBounds.MinX; X < GridMap.GridBounds.MaxX; X++)
@@ -317,6 +329,12 @@ void UGASpatialComponent::EvaluateLayer(const FFunctionLayer& Layer, FGAGridMap
 
 					case SI_LOS:
 					{
+						if (bUsePVS && (CellRef.Distance(TargetCell) <= Grid->GetPVSRadius()))
+						{
+							Value = Grid->IsInPVS(TargetCell, CellRef) ? 1.0f : 0.0f;
+							break;
+						}
+
 						// **Perform Line Trace for LOS Check**
 						FHitResult HitResult;
 						FCollisionQueryParams Params;
@@ -340,25 +358,12 @@ void UGASpatialComponent::EvaluateLayer(const FFunctionLayer& Layer, FGAGridMap
 					}
 					case SI_Blur:
 					{
-						float TotalValue = 0.0f;
-						int Count = 0;
-
-						for (int dY = -1; dY <= 1; dY++)
+						// Average over the neighborhood, ignoring any part of it that falls off the map
+						FGridBox Neighborhood = FGAGridMapIntegral::GetRadiusBox(CellRef.X, CellRef.Y, FMath::Max(Layer.BlurRadius, 0));
+						if (!BlurIntegral.GetBoxMean(Neighborhood, Value))
 						{
-							for (int dX = -1; dX <= 1; dX++)
-							{
-								FCellRef NeighborRef(CellRef.X + dX, CellRef.Y + dY);
-								float NeighborValue = 0.0f;
-
-								if (GridMap.GetValue(NeighborRef, NeighborValue)) // Get neighbor's value
-								{
-									TotalValue += NeighborValue;
-									Count++;
-								}
-							}
+							Value = 0.0f;
 						}
-
-						Value = (Count > 0) ? (TotalValue / Count) : 0.0f;
 						break;
 					}
 
@@ -372,27 +377,8 @@ void UGASpatialComponent::EvaluateLayer(const FFunctionLayer& Layer, FGAGridMap
 				// float ModifiedValue = Layer.ResponseCurve.GetRichCurveConst()->Eval(Value, 0.0f);
 				float ModifiedValue = Layer.ResponseCurve.GetRichCurveConst()->Eval(Value, 0.0f);
 
-				// Then add it's influence to the grid map, combining with the current value using one of the two operators
-				//	SO_None				UMETA(DisplayName = "None"),
-				//	SO_Add				UMETA(DisplayName = "Add"),			// add this layer to the accumulated buffer
-				//	SO_Multiply			UMETA(DisplayName = "Multiply")		// multiply this layer into the accumulated buffer
-
-				//GridMap.SetValue(CellRef, CombinedValue);
-
-				float ExistingValue = 0.0f;
-				GridMap.GetValue(CellRef, ExistingValue);
-
-				switch (Layer.Op)
-				{
-					case SO_Add:
-						GridMap.SetValue(CellRef, ExistingValue + ModifiedValue);
-						break;
-					case SO_Multiply:
-						GridMap.SetValue(CellRef, ExistingValue * ModifiedValue);
-						break;
-					default:
-						break;
-				}
+				// Its influence gets combined into the grid map below, once the whole layer is evaluated
+				LayerMap.SetValue(CellRef, ModifiedValue);
 
 				// HERE ARE SOME ADDITIONAL HINTS
 
@@ -415,4 +401,21 @@ void UGASpatialComponent::EvaluateLayer(const FFunctionLayer& Layer, FGAGridMap
 			}
 		}
 	}
+
+	// Then add it's influence to the grid map, combining with the current value using one of the two operators
+	//	SO_None				UMETA(DisplayName = "None"),
+	//	SO_Add				UMETA(DisplayName = "Add"),			// add this layer to the accumulated buffer
+	//	SO_Multiply			UMETA(DisplayName = "Multiply")		// multiply this layer into the accumulated buffer
+
+	switch (Layer.Op)
+	{
+		case SO_Add:
+			GridMap.Add(LayerMap);
+			break;
+		case SO_Multiply:
+			GridMap.Multiply(LayerMap);
+			break;
+		default:
+			break;
+	}
 }
\ No newline at end of file
@@ -39,7 +39,7 @@ struct FFunctionLayer
 {
 	GENERATED_USTRUCT_BODY()
 
-	FFunctionLayer() : Input(SI_None), Op(SO_None) {}
+	FFunctionLayer() : Input(SI_None), Op(SO_None), BlurRadius(1) {}
 
 	UPROPERTY(BlueprintReadOnly, EditAnywhere)
 	TEnumAsByte<ESpatialInput> Input;
@@ -50,6 +50,10 @@ struct FFunctionLayer
 	UPROPERTY(BlueprintReadOnly, EditAnywhere)
 	TEnumAsByte<ESpatialOp> Op;
 
+	// SI_Blur only: the blur averages the (2 * BlurRadius + 1)^2 cells around each cell. Any radius costs the same
+	UPROPERTY(BlueprintReadOnly, EditAnywhere, meta = (ClampMin = "0"))
+	int32 BlurRadius;
+
 };
 
 